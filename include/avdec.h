@@ -264,6 +264,18 @@ bgav_options_t * bgav_get_options(bgav_t * bgav);
 #define BGAV_OPT_DUMP_HEADERS "dump-headers"   // int, 0..1
 
 #define BGAV_OPT_SAMPLE_ACCURATE "sample-accurate"   // int, 0..1
+#define BGAV_OPT_VIDEO_THREADS "video-threads"   // int, 1..
+#define BGAV_OPT_SI_READAHEAD "si-readahead"   // int, bytes, 0 = off
+#define BGAV_OPT_UDP_BUFFER "udp-buffer"   // int, bytes
+#define BGAV_OPT_RTP_JITTER "rtp-jitter"   // int, milliseconds
+#define BGAV_OPT_SI_WINDOW "si-window"   // int, packets, 0 = off
+#define BGAV_OPT_INDEX_CACHE_THRESHOLD "index-cache-threshold"   // int, milliseconds
+#define BGAV_OPT_INDEX_CACHE_SIZE "index-cache-size"   // int, megabytes, 0 = unlimited
+#define BGAV_OPT_HTTP_CACHE_SIZE "http-cache-size"   // int, megabytes, 0 = off
+#define BGAV_OPT_SUBTITLE_INDEX "subtitle-index"   // int, 0..1
+#define BGAV_OPT_TRACE_FILE "trace-file"   // String
+#define BGAV_OPT_IMAGE_SEQUENCE_TIMESCALE "image-sequence-timescale"   // int
+#define BGAV_OPT_IMAGE_SEQUENCE_FRAME_DURATION "image-sequence-frame-duration"   // int
 #define BGAV_OPT_DEFAULT_SUBTITLE_ENCODING "subtile-encoding"   // String
   
   // #define BGAV_OPT_READ_TIMEOUT "conntimeout"
@@ -309,6 +321,155 @@ void bgav_options_set_read_timeout(bgav_options_t * opt, int timeout);
 BGAV_PUBLIC
 void bgav_options_set_sample_accurate(bgav_options_t*opt, int enable);
 
+/** \ingroup options
+ *  \brief Set the number of video decoding threads
+ *  \param opt Option container
+ *  \param threads Number of threads (default 1)
+ *
+ *  For intra-only codecs (e.g. PNG or uncompressed YUV variants),
+ *  frames are decoded in parallel by this many threads.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_video_threads(bgav_options_t*opt, int threads);
+
+/** \ingroup options
+ *  \brief Set the read ahead size for non-interleaved files
+ *  \param opt Option container
+ *  \param bytes Total number of bytes to buffer (default 8 MB, 0 disables)
+ *
+ *  For non-interleaved files with an index, packets of each stream
+ *  are read in large sequential chunks. The memory is divided among
+ *  the active streams.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_si_readahead(bgav_options_t*opt, int bytes);
+
+/** \ingroup options
+ *  \brief Set the socket receive buffer size for UDP and RTP
+ *  \param opt Option container
+ *  \param bytes Buffer size (default 4 MB)
+ *
+ *  Used for udp:// and rtp:// inputs. For RTP sessions received by
+ *  libavformat (sdp:// and rtsp://), it's passed as buffer_size.
+ *  The kernel might limit the size (see net.core.rmem_max).
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_udp_buffer(bgav_options_t*opt, int bytes);
+
+/** \ingroup options
+ *  \brief Set the jitter buffer depth for RTP streams
+ *  \param opt Option container
+ *  \param ms Milliseconds (default 200)
+ *
+ *  Missing packets are waited for at most this long before they are
+ *  considered lost. Larger values help on networks with much reordering,
+ *  but increase the latency. Used only for RTP sessions (sdp://).
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_rtp_jitter(bgav_options_t*opt, int ms);
+
+/** \ingroup options
+ *  \brief Set the window size for the packet index of very long files
+ *  \param opt Option container
+ *  \param packets Packets per window (default 65536, 0 disables)
+ *
+ *  For files with many more packets than this, the packet index is
+ *  created piecewise from the tables in the file header. This keeps the
+ *  memory usage bounded, but sample accurate seeking is not available
+ *  then. Currently supported for Quicktime only.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_si_window(bgav_options_t*opt, int packets);
+
+/** \ingroup options
+ *  \brief Set the minimum build time of cached packet indices
+ *  \param opt Option container
+ *  \param ms Milliseconds (default 2000)
+ *
+ *  Packet indices, which are built by parsing the whole file, are saved
+ *  in the cache directory if building them took longer than this.
+ *  Indices are always saved if another process waited for them,
+ *  either before or while they were built.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_index_cache_threshold(bgav_options_t*opt, int ms);
+
+/** \ingroup options
+ *  \brief Set the maximum size of the packet index cache
+ *  \param opt Option container
+ *  \param mb Megabytes (default 1024, 0 means unlimited)
+ *
+ *  If the cache grows larger than this, the least recently used indices
+ *  are removed.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_index_cache_size(bgav_options_t*opt, int mb);
+
+/** \ingroup options
+ *  \brief Set the size of the http block cache
+ *  \param opt Option container
+ *  \param mb Megabytes (default 16, 0 switches the cache off)
+ *
+ *  Seekable http resources of known size are read in blocks
+ *  using range requests. Seeking to a cached block doesn't access
+ *  the network.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_http_cache_size(bgav_options_t*opt, int mb);
+
+/** \ingroup options
+ *  \brief Index text subtitle files when opening them
+ *  \param opt Option container
+ *  \param enable 1 to index subtitle files at open time, 0 else (default)
+ *
+ *  Seeking in subtitle files uses an index of the cues. By default it's
+ *  built while the file is read, so seeking behind the
+ *  furthest position read so far parses the skipped cues once. Enable
+ *  this if you want to seek to arbitrary positions right after opening.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_subtitle_index(bgav_options_t*opt, int enable);
+
+/** \ingroup options
+ *  \brief Write a trace of the decoding pipeline
+ *  \param opt Option container
+ *  \param filename File to write or NULL to disable tracing (default)
+ *
+ *  The trace records the time spent in input reads, demuxing, parsing,
+ *  decoding, seeking and index building. It is written in the Chrome
+ *  trace event format (load it in chrome://tracing or Perfetto) when
+ *  the decoder is closed. Tracing must be enabled at compile time with
+ *  --enable-trace, otherwise this option is ignored.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_trace_file(bgav_options_t*opt, const char * filename);
+
+/** \ingroup options
+ *  \brief Set the framerate of image sequences
+ *  \param opt Option container
+ *  \param timescale Timescale (default 25)
+ *  \param frame_duration Duration of one image in timescale units (default 1)
+ *
+ *  Locations like shot_%05d.png (or shot_%d.png) are opened as
+ *  a video stream made of the numbered PNG, TIFF or JPEG images in that
+ *  directory. Images are decoded ahead in parallel if the decoder
+ *  supports it and \ref bgav_options_set_video_threads is larger than 1.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_image_sequence_rate(bgav_options_t*opt,
+                                          int timescale, int frame_duration);
+
 /** \ingroup options
  *  \brief Set dynamic range control
  *  \param opt Option container
@@ -640,6 +801,48 @@ const char * bgav_get_disc_name(bgav_t * bgav);
 BGAV_PUBLIC
 int bgav_open(bgav_t * bgav, const char * location);
 
+/** \ingroup opening
+ *  \brief Open a file or URL for reading the metadata only
+ *  \param bgav A decoder instance
+ *  \param location The URL or path to open
+ *  \returns 1 if the location was successfully openend, 0 else.
+ *
+ *  This reads only as much as needed for getting the metadata,
+ *  the duration and the stream formats. It's meant for media
+ *  library scanners. Packet indices are not built, durations are
+ *  taken from the container headers if possible (and might be
+ *  approximate), and embedded cover images in ID3V2 tags are not
+ *  loaded. Instead, their position in the file is stored in the
+ *  track metadata (see \ref BGAV_META_COVER_OFFSET).
+ *
+ *  A decoder opened this way cannot be started. Use \ref bgav_open
+ *  for decoding.
+ */
+
+BGAV_PUBLIC
+int bgav_open_scan(bgav_t * bgav, const char * location);
+
+/** \ingroup opening
+ *  \brief Byte offset of a cover image, which was not loaded (long)
+ *
+ *  Set by \ref bgav_open_scan along with \ref BGAV_META_COVER_SIZE
+ *  and \ref BGAV_META_COVER_MIMETYPE
+ */
+
+#define BGAV_META_COVER_OFFSET   "BGAVCoverOffset"
+
+/** \ingroup opening
+ *  \brief Size in bytes of a cover image, which was not loaded (int)
+ */
+
+#define BGAV_META_COVER_SIZE     "BGAVCoverSize"
+
+/** \ingroup opening
+ *  \brief Mimetype of a cover image, which was not loaded (string)
+ */
+
+#define BGAV_META_COVER_MIMETYPE "BGAVCoverMimetype"
+
 /** \ingroup opening
  *  \brief Open a VCD device
  *  \param bgav A decoder instance
@@ -1646,6 +1849,35 @@ const char * bgav_get_subtitle_info(bgav_t * bgav, int stream);
 BGAV_PUBLIC
 int bgav_can_pause(bgav_t * bgav);
 
+/** \ingroup stream_info
+ *  \brief Reception statistics of RTP streams
+ *
+ *  The values are calculated as described in RFC 3550 (appendix A).
+ */
+
+typedef struct
+  {
+  int64_t packets_received; /*!< Received packets including duplicates */
+  int64_t packets_expected; /*!< Packets expected from the sequence numbers */
+  int64_t packets_lost;     /*!< Expected minus received, negative if there are duplicates */
+  uint32_t highest_seq;     /*!< Extended highest sequence number */
+  gavl_time_t jitter;       /*!< Interarrival jitter */
+  } bgav_rtp_stats_t;
+
+/** \ingroup stream_info
+ *  \brief Get the reception statistics of an RTP stream
+ *  \param bgav A decoder instance
+ *  \param stats Returns the statistics
+ *  \returns 1 if the input receives RTP packets, 0 else
+ *
+ *  Currently RTP is handled for MPEG-2 transport streams received
+ *  from rtp:// and udp:// locations. The statistics can be queried
+ *  from another thread than the one decoding.
+ */
+
+BGAV_PUBLIC
+int bgav_get_rtp_stats(bgav_t * bgav, bgav_rtp_stats_t * stats);
+
 /***************************************************
  * Decoding functions
  ***************************************************/
@@ -2238,6 +2470,167 @@ int bgav_set_stream_action_all(bgav_t * bgav, int idx, bgav_stream_action_t acti
  */
   
 
+/** \defgroup edldec EDL playback
+ *
+ *  Plays back an EDL (e.g. from \ref bgav_get_edl) as a continuous
+ *  timeline. Each segment is decoded by a separate \ref bgav_t, which
+ *  is opened and positioned in the background while the previous
+ *  segment is played. Gaps between segments are filled with silence
+ *  (audio) or skipped (video).
+ *
+ *  @{
+ */
+
+/** \brief Forward declaration for an EDL decoder
+ *
+ * You don't want to know, what's inside here
+ */
+
+typedef struct bgav_edl_dec_s bgav_edl_dec_t;
+
+/** \brief Create an EDL decoder
+ *  \param edl An EDL
+ *  \param opt Options for the segment decoders or NULL
+ *  \returns A newly allocated EDL decoder
+ *
+ *  The EDL and the options are copied. Segments are always decoded
+ *  with sample accuracy enabled.
+ */
+
+BGAV_PUBLIC
+bgav_edl_dec_t * bgav_edl_dec_create(const gavl_dictionary_t * edl,
+                                     const bgav_options_t * opt);
+
+/** \brief Get the number of tracks
+ *  \param dec An EDL decoder
+ *  \returns The number of tracks in the EDL
+ */
+
+BGAV_PUBLIC
+int bgav_edl_dec_num_tracks(bgav_edl_dec_t * dec);
+
+/** \brief Select a track
+ *  \param dec An EDL decoder
+ *  \param track Track index starting with 0
+ *  \returns 1 on success, 0 if a stream could not be initialized
+ *
+ *  This opens the first segment of each stream and starts preloading
+ *  the second one. All streams are decoded.
+ */
+
+BGAV_PUBLIC
+int bgav_edl_dec_select_track(bgav_edl_dec_t * dec, int track);
+
+/** \brief Get an audio source
+ *  \param dec An EDL decoder
+ *  \param stream Audio stream index starting with 0
+ *  \returns The audio source or NULL
+ */
+
+BGAV_PUBLIC gavl_audio_source_t *
+bgav_edl_dec_get_audio_source(bgav_edl_dec_t * dec, int stream);
+
+/** \brief Get a video source
+ *  \param dec An EDL decoder
+ *  \param stream Video stream index starting with 0
+ *  \returns The video source or NULL
+ */
+
+BGAV_PUBLIC gavl_video_source_t *
+bgav_edl_dec_get_video_source(bgav_edl_dec_t * dec, int stream);
+
+/** \brief Seek to a time in the EDL timeline
+ *  \param dec An EDL decoder
+ *  \param time Time to seek to
+ *  \param scale Timescale of time
+ *
+ *  Audio is positioned sample accurately, video frames before
+ *  the seek time are skipped.
+ */
+
+BGAV_PUBLIC
+void bgav_edl_dec_seek(bgav_edl_dec_t * dec, int64_t * time, int scale);
+
+/** \brief Destroy an EDL decoder
+ *  \param dec An EDL decoder
+ */
+
+BGAV_PUBLIC
+void bgav_edl_dec_destroy(bgav_edl_dec_t * dec);
+
+/**
+ *  @}
+ */
+
+/** \defgroup scan Batch scanning of media files
+ *
+ *  Reads the media infos of many files like \ref bgav_open_scan
+ *  followed by \ref bgav_get_media_info. The files are distributed among
+ *  a number of worker threads. Each worker has one decoder instance,
+ *  which is reused for all its files, so the options are copied and the
+ *  codecs are initialized only once. At most one file per worker is open
+ *  at the same time.
+ *
+ *  @{
+ */
+
+/** \brief Forward declaration for a batch scanner
+ *
+ * You don't want to know, what's inside here
+ */
+
+typedef struct bgav_scan_s bgav_scan_t;
+
+/** \brief Callback for the scan results
+ *  \param data The data passed to \ref bgav_scan_create
+ *  \param location The location as passed to \ref bgav_scan_files
+ *  \param media_info Media info (see \ref bgav_get_media_info) or NULL if the file could not be opened
+ *
+ *  Calls are serialized, but they can happen from any of the
+ *  worker threads. The media info is only valid during the
+ *  callback.
+ */
+
+typedef void (*bgav_scan_callback)(void * data, const char * location,
+                                   const gavl_dictionary_t * media_info);
+
+/** \brief Create a batch scanner
+ *  \param opt Options for the decoders or NULL
+ *  \param num_threads Number of worker threads (0 means number of CPUs)
+ *  \param cb Callback for the results
+ *  \param cb_data Data for the callback
+ *  \returns A newly allocated batch scanner
+ */
+
+BGAV_PUBLIC
+bgav_scan_t * bgav_scan_create(const bgav_options_t * opt, int num_threads,
+                               bgav_scan_callback cb, void * cb_data);
+
+/** \brief Scan files
+ *  \param s A batch scanner
+ *  \param locations Paths or URLs
+ *  \param num Number of locations
+ *  \returns The number of locations, which could be opened
+ *
+ *  Blocks until all locations are scanned. The callback is called once
+ *  for each location, not necessarily in the order of the array.
+ *  The function can be called multiple times for the same scanner.
+ */
+
+BGAV_PUBLIC
+int bgav_scan_files(bgav_scan_t * s, const char * const * locations, int num);
+
+/** \brief Destroy a batch scanner
+ *  \param s A batch scanner
+ */
+
+BGAV_PUBLIC
+void bgav_scan_destroy(bgav_scan_t * s);
+
+/**
+ *  @}
+ */
+
 /***************************************************
  * Debugging functions
  ***************************************************/
@@ -69,6 +69,8 @@ typedef struct bgav_track_s bgav_track_t;
 
 typedef struct bgav_timecode_table_s bgav_timecode_table_t;
 
+typedef struct bgav_video_threads_s bgav_video_threads_t;
+
 #include <id3.h>
 #include <yml.h>
 #include <packettimer.h>
@@ -84,6 +86,13 @@ struct bgav_audio_decoder_s
   gavl_source_status_t (*decode_frame)(bgav_stream_t*);
   void (*close)(bgav_stream_t*);
   void (*resync)(bgav_stream_t*);
+
+  /*
+   *  Skip samples at the beginning of the next packet without
+   *  decoding them (optional). Return 0 if they must be decoded.
+   */
+  int (*skip)(bgav_stream_t*, int num_samples);
+  
   bgav_audio_decoder_t * next;
   };
 
@@ -113,6 +122,16 @@ struct bgav_video_decoder_s
      decoders which are not synchronous
      (not one packet in, one frame out) */
   int (*skipto)(bgav_stream_t*, int64_t dest);
+
+  /*
+   *  Optional, for intra-only codecs: Create private decoder instances,
+   *  which decode one packet into a frame without touching the stream.
+   *  If present, frames can be decoded in parallel (see videothreads.c).
+   */
+  
+  void * (*worker_create)(bgav_stream_t*);
+  int (*worker_decode)(void * worker, bgav_packet_t * p, gavl_video_frame_t * frame);
+  void (*worker_destroy)(void * worker);
   
   bgav_video_decoder_t * next;
   };
@@ -243,8 +262,11 @@ typedef struct
   gavl_video_source_t * vsrc;
   gavl_video_source_t * vsrc_priv;
 
-  gavl_packet_index_t * frame_table;
+  gavl_frame_table_t * frame_table;
   int skip_mode;
+
+  /* Frame parallel decoding */
+  bgav_video_threads_t * threads;
   } bgav_stream_video_t;
   
 struct bgav_stream_s
@@ -304,6 +326,11 @@ struct bgav_stream_s
   int first_index_pos;
   int last_index_pos;
   int index_position;
+
+  /* Read ahead cache for non-interleaved superindex playback.
+     Holds a contiguous byte range of the file starting at si_cache_start */
+  gavl_buffer_t si_cache;
+  int64_t si_cache_start;
   
   /* Where to get data */
   bgav_demuxer_context_t * demuxer;
@@ -500,6 +527,12 @@ int bgav_stream_skipto(bgav_stream_t * s, int64_t * time, int scale);
 
 #define TRACK_HAS_COMPRESSION (1<<2)
 
+typedef struct
+  {
+  int64_t position;
+  gavl_time_t time;
+  } bgav_seek_point_t;
+
 struct bgav_track_s
   {
   // char * name;
@@ -527,7 +560,15 @@ struct bgav_track_s
   */
   int64_t data_start;
   int64_t data_end; // Can be set by the demuxer to the end of the packet data section
+
+  /*
+   *  Resync points (byte position -> time) found during iterative seeking,
+   *  sorted by position. Used to refine the interpolation of later seeks
+   */
   
+  bgav_seek_point_t * seek_points;
+  int num_seek_points;
+  int seek_points_alloc;
   };
 
 /* track.c */
@@ -799,6 +840,9 @@ struct bgav_input_s
   /* Non-Blocking API */
   int (*can_read)(bgav_input_context_t*, int timeout);
   int  (*read_nonblock)(bgav_input_context_t*, uint8_t * buffer, int len);
+
+  /* Reception statistics for RTP inputs */
+  int (*get_rtp_stats)(bgav_input_context_t*, bgav_rtp_stats_t * stats);
   };
 
 // #define BGAV_INPUT_DO_BUFFER      (1<<0)
@@ -921,6 +965,13 @@ int bgav_input_read_double_64_le(bgav_input_context_t * ctx, double * ret);
 
 int bgav_input_get_data(bgav_input_context_t*, uint8_t*,int);
 
+/* Read arrays of num integers */
+
+int bgav_input_read_array_32_be(bgav_input_context_t*, uint32_t*, int num);
+int bgav_input_read_array_32_le(bgav_input_context_t*, uint32_t*, int num);
+int bgav_input_read_array_64_be(bgav_input_context_t*, uint64_t*, int num);
+int bgav_input_read_array_64_le(bgav_input_context_t*, uint64_t*, int num);
+
 int bgav_input_get_8(bgav_input_context_t*,uint8_t*);
 int bgav_input_get_16_le(bgav_input_context_t*,uint16_t*);
 int bgav_input_get_24_le(bgav_input_context_t*,uint32_t*);
@@ -1036,6 +1087,49 @@ void bgav_packet_index_seek(gavl_packet_index_t * idx,
 
 void bgav_packet_index_set_durations(gavl_packet_index_t * idx, bgav_stream_t * s);
 
+/* indexfile.c */
+
+/* Compact on-disk format, the index must be sorted by position */
+
+int bgav_packet_index_save_compact(const gavl_packet_index_t * idx,
+                                   const char * filename);
+
+/* Returns NULL if the file is in another format */
+
+gavl_packet_index_t * bgav_packet_index_load_compact(const char * filename);
+
+/* Lookups in a compact index file without loading it */
+
+typedef struct bgav_packet_index_file_s bgav_packet_index_file_t;
+
+typedef struct
+  {
+  int64_t position;
+  int64_t pts;
+  int64_t duration;
+  uint32_t size;
+  int flags;
+  } bgav_packet_index_file_entry_t;
+
+bgav_packet_index_file_t * bgav_packet_index_file_open(const char * filename);
+void bgav_packet_index_file_close(bgav_packet_index_file_t * f);
+
+/*
+ *  Find the entry of a stream with the largest pts (position) not after
+ *  the given one. Only one block is decoded.
+ *  Returns the index of the entry within the stream or -1.
+ *  The pts lookup fails for streams, where the blocks don't start
+ *  with increasing pts.
+ */
+
+int bgav_packet_index_file_find_pts(bgav_packet_index_file_t * f,
+                                    int stream_id, int64_t pts,
+                                    bgav_packet_index_file_entry_t * ret);
+
+int bgav_packet_index_file_find_position(bgav_packet_index_file_t * f,
+                                         int stream_id, int64_t position,
+                                         bgav_packet_index_file_entry_t * ret);
+
 
 void gavl_packet_index_set_coding_types(gavl_packet_index_t * idx,
                                       bgav_stream_t * s);
@@ -1107,6 +1201,21 @@ struct bgav_demuxer_s
      after seeking with the fileindex */
   
   void (*resync)(bgav_demuxer_context_t*, bgav_stream_t * s);
+
+  /*
+   *  For demuxers with a windowed superindex (BGAV_DEMUXER_SI_WINDOW):
+   *  Load the part of the index around time. GAVL_TIME_UNDEFINED means
+   *  the start of the file.
+   */
+  
+  void (*load_si_window)(bgav_demuxer_context_t*, int64_t time, int scale);
+
+  /*
+   *  For demuxers, which build a sparse seek index only when it's
+   *  needed: Called before each seek as long as ctx->si is NULL.
+   */
+  
+  void (*load_si)(bgav_demuxer_context_t*);
   };
 
 /* Demuxer flags */
@@ -1131,6 +1240,13 @@ struct bgav_demuxer_s
 #define BGAV_DEMUXER_SAMPLE_ACCURATE        (1<<16)
 #define BGAV_DEMUXER_LIVE                   (1<<17)
 
+/* Superindex covers only a part of the file */
+#define BGAV_DEMUXER_SI_WINDOW              (1<<18)
+
+/* Use iterative seeking although the demuxer has a seek() method
+   (e.g. because the file has no index) */
+#define BGAV_DEMUXER_SEEK_ITERATIVE         (1<<19)
+
 #define INDEX_MODE_NONE   0 /* Default: No sample accuracy */
 /* Packets have precise timestamps and durations and are adjacent in the file */
 #define INDEX_MODE_SIMPLE 1
@@ -1186,7 +1302,9 @@ bgav_demuxer_create(bgav_t * b,
                     const bgav_demuxer_t * demuxer,
                     bgav_input_context_t * input);
 
-const bgav_demuxer_t * bgav_demuxer_probe(bgav_input_context_t * input);
+/* hint: Demuxer to try first (or NULL) */
+const bgav_demuxer_t * bgav_demuxer_probe(bgav_input_context_t * input,
+                                          const bgav_demuxer_t * hint);
 
 void bgav_demuxer_create_buffers(bgav_demuxer_context_t * demuxer);
 void bgav_demuxer_destroy(bgav_demuxer_context_t * demuxer);
@@ -1202,6 +1320,36 @@ void bgav_demuxer_parse_track(bgav_demuxer_context_t * ctx);
 
 int bgav_demuxer_get_duration(bgav_demuxer_context_t * ctx);
 
+/* Load the superindex window around time if the index is windowed */
+void bgav_demuxer_load_si_window(bgav_demuxer_context_t * ctx,
+                                 int64_t time, int scale);
+
+/*
+ *  Must be called by demuxers after they changed the window in ctx->si.
+ *  Sets missing packet durations within the window. The last packet of
+ *  a stream in a window needs a duration from the demuxer unless the
+ *  window is at the end of the file.
+ */
+
+void bgav_demuxer_si_window_changed(bgav_demuxer_context_t * ctx);
+
+/* Build the seek index if the demuxer does this on demand */
+void bgav_demuxer_load_si(bgav_demuxer_context_t * ctx);
+
+/*
+ *  Fixed stride files (raw video, DV, PCM): Frame N starts at
+ *  data_start + N * stride, so we need neither an index nor iterative
+ *  seeking.
+ */
+
+/* Number of complete frames or -1 if the file size is unknown */
+int64_t bgav_demuxer_stride_frames(bgav_demuxer_context_t * ctx, int64_t stride);
+
+/* Seek to the frame containing time and return its index */
+int64_t bgav_demuxer_stride_seek(bgav_demuxer_context_t * ctx, int64_t stride,
+                                 int64_t frame_duration, int timescale,
+                                 int64_t time, int scale);
+
 void bgav_demuxer_set_clock_time(bgav_demuxer_context_t * ctx,
                                  int64_t pts, int scale, gavl_time_t clock_time);
 
@@ -1260,6 +1408,12 @@ int bgav_is_redirector(bgav_t * bgav);
 /* Decoder was only opened to build an index */
 #define BGAV_FLAG_BUILD_INDEX      (1<<4)
 
+/* Decoder was only opened to read metadata (see bgav_open_scan()) */
+#define BGAV_FLAG_SCAN             (1<<5)
+
+/* Decoder started the pipeline trace or tried to (see trace.c) */
+#define BGAV_FLAG_TRACE            (1<<6)
+
 struct bgav_s
   {
   char * location;
@@ -1280,12 +1434,16 @@ struct bgav_s
   int flags;
 
   gavl_dictionary_t state;
+
+  /* Demuxer of the previous location, kept by bgav_reset() */
+  const bgav_demuxer_t * last_demuxer;
   };
 
 /* bgav.c */
 
 void bgav_stop(bgav_t * b);
 int bgav_init(bgav_t * b);
+void bgav_reset(bgav_t * b);
 
 void bgav_metadata_changed(bgav_t * b,
                            const gavl_dictionary_t * new_metadata);
@@ -1297,6 +1455,11 @@ void bgav_seek_window_changed(bgav_t * b,
 
 int bgav_ensure_index(bgav_t * b);
 
+/* Remember a position, where a resync yields the given time.
+   Demuxers with own seek functions can use this too */
+
+void bgav_seek_map_add(bgav_track_t * t, int64_t position, gavl_time_t time);
+
 void bgav_send_state(bgav_t * b);
 
 /* Bytestream utilities */
@@ -1376,6 +1539,34 @@ int bgav_read_data_fd(const bgav_options_t * opt, int fd,
 
 uint32_t * bgav_get_vobsub_palette(const char * str);
 
+/* Immutable hash table mapping fourccs (or other 32 bit keys) to
+   the indices of the entries they were added with */
+
+typedef struct
+  {
+  uint32_t key;
+  int first;
+  int num;
+  } bgav_fourcc_slot_t;
+
+typedef struct
+  {
+  bgav_fourcc_slot_t * slots;
+  uint32_t mask;
+  int * indices;
+  } bgav_fourcc_table_t;
+
+void bgav_fourcc_table_init(bgav_fourcc_table_t * t,
+                            const uint32_t * keys, int num_keys);
+
+/* Returns the indices for key in insertion order or NULL */
+const int * bgav_fourcc_table_get(const bgav_fourcc_table_t * t,
+                                  uint32_t key, int * num);
+
+void bgav_fourcc_table_free(bgav_fourcc_table_t * t);
+
+uint32_t bgav_string_hash(const char * str);
+
 
 /* tcp.c */
 
@@ -1466,6 +1657,21 @@ int bgav_video_ensure_frame_table(bgav_t * b, int stream);
 /* Check if a packet will be skipped */
 int bgav_video_packet_skip(gavl_packet_t * p, int skip_mode);
 
+/* videothreads.c */
+
+bgav_video_threads_t * bgav_video_threads_create(bgav_stream_t * s, int num_threads);
+void bgav_video_threads_destroy(bgav_video_threads_t * t);
+
+gavl_source_status_t
+bgav_video_threads_read(bgav_video_threads_t * t, gavl_video_frame_t ** frame);
+
+/* Call after seeking */
+void bgav_video_threads_reset(bgav_video_threads_t * t);
+
+/* Skip decoded frames before time. Return 1 and set out_time if a
+   later frame is already queued */
+int bgav_video_threads_skipto(bgav_video_threads_t * t, int64_t time, int64_t * out_time);
+
 /* subtitle.c */
 
 void bgav_subtitle_seek(bgav_demuxer_context_t * ctx, int64_t time, int scale);
@@ -1599,7 +1805,17 @@ int bgav_video_is_divx4(uint32_t fourcc);
 void bgav_ffmpeg_lock(void);
 void bgav_ffmpeg_unlock(void);
 
-gavl_packet_index_t * bgav_get_packet_index(const char * url);
+gavl_packet_index_t * bgav_get_packet_index(const char * url,
+                                            const bgav_options_t * opt);
+
+/* demux_image.c */
+
+/*
+ *  If location is an image sequence pattern like shot_%05d.png,
+ *  return the filename of the first image
+ */
+
+char * bgav_image_sequence_first_file(const char * location);
 
 
 #if __GNUC__ >= 3
@@ -1614,5 +1830,36 @@ gavl_packet_index_t * bgav_get_packet_index(const char * url);
 
 #endif
 
+/* trace.c */
+
+/* Start tracing if requested by the options */
+void bgav_trace_init(bgav_t * b);
+
+/* Write the trace if it was started by b */
+void bgav_trace_close(bgav_t * b);
+
+#ifdef HAVE_TRACE
+
+extern int bgav_trace_active;
+
+void bgav_trace_event(const char * name, char phase);
+
+/* Set and cleared by another thread than the one reading it */
+#define BGAV_TRACE_IS_ACTIVE() \
+  BGAV_UNLIKELY(__atomic_load_n(&bgav_trace_active, __ATOMIC_ACQUIRE))
+
+#define BGAV_TRACE_BEGIN(name) \
+  do { if(BGAV_TRACE_IS_ACTIVE()) bgav_trace_event(name, 'B'); } while(0)
+
+#define BGAV_TRACE_END(name) \
+  do { if(BGAV_TRACE_IS_ACTIVE()) bgav_trace_event(name, 'E'); } while(0)
+
+#else
+
+#define BGAV_TRACE_BEGIN(name) do { } while(0)
+#define BGAV_TRACE_END(name)   do { } while(0)
+
+#endif
+
 #endif // BGAV_AVDEDEC_PRIVATE_H_INCLUDED
 
@@ -0,0 +1,42 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#ifndef BGAV_AVI_H_INCLUDED
+#define BGAV_AVI_H_INCLUDED
+
+/* Legacy AVI index (idx1) */
+
+typedef struct
+  {
+  uint32_t num_entries;
+  struct
+    {
+    uint32_t ckid;
+    uint32_t dwFlags;
+    uint32_t dwChunkOffset;
+    uint32_t dwChunkLength;
+    } * entries;
+  } avi_idx1_t;
+
+/* Reads the chunk including the chunk header */
+int bgav_avi_idx1_read(bgav_input_context_t * input, avi_idx1_t * ret);
+void bgav_avi_idx1_free(avi_idx1_t * idx1);
+
+#endif // BGAV_AVI_H_INCLUDED
@@ -62,6 +62,9 @@ void bgav_ogg_page_skip(bgav_input_context_t * ctx,
 
 int bgav_ogg_probe(bgav_input_context_t * ctx);
 
+/* Skip to the next "OggS" pattern before end_pos (0: No limit) */
+int bgav_ogg_find_page(bgav_input_context_t * ctx, int64_t end_pos);
+
 /* OGM header */
 
 /* Special header for OGM files */
@@ -68,9 +68,16 @@ int bgav_set_audio_stream(bgav_t * b, int stream, bgav_stream_action_t action)
 static gavl_source_status_t get_frame(void * sp, gavl_audio_frame_t ** frame)
   {
   bgav_stream_t * s = sp;
+  gavl_source_status_t st = GAVL_SOURCE_OK;
   
-  if(!(s->flags & STREAM_HAVE_FRAME) &&
-     !s->data.audio.decoder->decode_frame(s))
+  if(!(s->flags & STREAM_HAVE_FRAME))
+    {
+    BGAV_TRACE_BEGIN("decode_audio");
+    st = s->data.audio.decoder->decode_frame(s);
+    BGAV_TRACE_END("decode_audio");
+    }
+  
+  if(!st)
     {
     s->flags |= STREAM_EOF_C;
     return GAVL_SOURCE_EOF;
@@ -384,7 +391,15 @@ int bgav_audio_skipto(bgav_stream_t * s, int64_t * t, int scale)
       s->out_time = p->pts;
       
       if(p->pts < skip_time)
-        gavl_audio_source_skip(s->data.audio.source, skip_time - p->pts);
+        {
+        /* Skip without decoding if the codec can do that */
+        if(s->data.audio.decoder->skip &&
+           !(s->flags & STREAM_HAVE_FRAME) &&
+           s->data.audio.decoder->skip(s, skip_time - p->pts))
+          s->out_time = skip_time;
+        else
+          gavl_audio_source_skip(s->data.audio.source, skip_time - p->pts);
+        }
       break;
       }
     bgav_stream_get_packet_read(s, &p);
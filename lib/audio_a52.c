@@ -180,7 +180,8 @@ static int init_a52(bgav_stream_t * s)
   decode_frame_a52(s);
   priv->need_format = 0;
 
-  s->data.audio.sync_samples = 32 * FRAME_SAMPLES;
+  /* Frames are independent except for the overlap of the last block */
+  s->data.audio.sync_samples = FRAME_SAMPLES;
 
   
   return 1;
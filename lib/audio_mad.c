@@ -86,6 +86,51 @@ static gavl_source_status_t get_data(bgav_stream_t * s)
   return GAVL_SOURCE_OK;
   }
 
+/*
+ *  Frames to decode before the seek target for layer 3: The main
+ *  data can start up to 511 (MPEG-1) or 255 (MPEG-2/2.5) bytes
+ *  before the frame header (bit reservoir) and one more frame is
+ *  needed for the overlap. For VBR we assume the smallest frames.
+ */
+
+static int layer3_sync_frames(const struct mad_header * h,
+                              int samples_per_frame, int vbr)
+  {
+  int reservoir;
+  int payload;
+  int max_frames;
+
+  if(h->flags & (MAD_FLAG_LSF_EXT | MAD_FLAG_MPEG_2_5_EXT))
+    {
+    reservoir = 255;
+    max_frames = 30;
+    }
+  else
+    {
+    reservoir = 511;
+    max_frames = 10;
+    }
+
+  if(vbr || !h->bitrate || !h->samplerate)
+    return max_frames;
+
+  /* Frame size minus header and side info */
+  payload = (h->bitrate / 8) * samples_per_frame / h->samplerate - 4;
+
+  if(h->flags & MAD_FLAG_PROTECTION)
+    payload -= 2;
+
+  if(h->flags & (MAD_FLAG_LSF_EXT | MAD_FLAG_MPEG_2_5_EXT))
+    payload -= (h->mode == MAD_MODE_SINGLE_CHANNEL) ? 9 : 17;
+  else
+    payload -= (h->mode == MAD_MODE_SINGLE_CHANNEL) ? 17 : 32;
+
+  if((payload <= 0) || (1 + (reservoir + payload - 1) / payload > max_frames))
+    return max_frames;
+
+  return 1 + (reservoir + payload - 1) / payload;
+  }
+
 static int get_format(bgav_stream_t * s)
   {
   mad_priv_t * priv;
@@ -123,29 +168,18 @@ static int get_format(bgav_stream_t * s)
   gavl_set_channel_setup(s->data.audio.format);
 
   if(h.flags & MAD_FLAG_MPEG_2_5_EXT)
-    {
-    if(h.layer == 3)
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame * 30;
-    else
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame;
     version_string = "2.5";
-    }
   else if(h.flags & MAD_FLAG_LSF_EXT)
-    {
-    if(h.layer == 3)
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame * 30;
-    else
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame;
     version_string = "2";
-    }
   else
-    {
-    if(h.layer == 3)
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame * 10;
-    else
-      s->data.audio.sync_samples = s->data.audio.format->samples_per_frame;
     version_string = "1";
-    }
+
+  if(h.layer == 3)
+    s->data.audio.sync_samples = s->data.audio.format->samples_per_frame *
+      layer3_sync_frames(&h, s->data.audio.format->samples_per_frame,
+                         s->codec_bitrate == GAVL_BITRATE_VBR);
+  else
+    s->data.audio.sync_samples = s->data.audio.format->samples_per_frame;
   
   gavl_dictionary_set_string_nocopy(s->m, GAVL_META_FORMAT,
                           gavl_sprintf("MPEG-%s layer %d",
@@ -37,6 +37,9 @@
 
 #define MAX_FRAME_SIZE (960*6)
 
+/* Decoder convergence after seeking: 80 ms (RFC 7845, 4.6) */
+#define SEEK_PREROLL   (48*80)
+
 // #define USE_FLOAT
 
 // #define DUMP_PACKETS
@@ -146,7 +149,7 @@ static int init_opus(bgav_stream_t * s)
 #endif
   s->data.audio.format->samples_per_frame = MAX_FRAME_SIZE;
   s->data.audio.format->interleave_mode = GAVL_INTERLEAVE_ALL;
-  s->data.audio.sync_samples = MAX_FRAME_SIZE;
+  s->data.audio.sync_samples = SEEK_PREROLL;
   
   if(s->data.audio.format->channel_locations[0] == GAVL_CHID_NONE)
     bgav_opus_set_channel_setup(&priv->h,
@@ -44,6 +44,9 @@ typedef struct
   uint8_t *       packet_ptr;
 
   int block_align;
+
+  /* Samples are packed across block_align (DVD LPCM) */
+  int no_skip;
   } pcm_t;
 
 /* Decode functions */
@@ -970,6 +973,7 @@ static int init_pcm(bgav_stream_t * s)
             priv->decode_func = decode_s_20_lpcm_mono;
           else
             priv->decode_func = decode_s_20_lpcm;
+          priv->no_skip = 1;
           break;
         case 24:
           s->data.audio.format->sample_format = GAVL_SAMPLE_S32;
@@ -977,6 +981,7 @@ static int init_pcm(bgav_stream_t * s)
             priv->decode_func = decode_s_24_lpcm_mono;
           else
             priv->decode_func = decode_s_24_lpcm;
+          priv->no_skip = 1;
           break;
         default:
           gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN,
@@ -1284,6 +1289,28 @@ static void resync_pcm(bgav_stream_t * s)
 
   }
 
+static int skip_pcm(bgav_stream_t * s, int num_samples)
+  {
+  pcm_t * priv;
+  int bytes;
+  priv = s->decoder_priv;
+
+  if(priv->no_skip)
+    return 0;
+  
+  if(!priv->p && (get_packet(s) != GAVL_SOURCE_OK))
+    return 0;
+
+  bytes = num_samples * priv->block_align;
+
+  if(bytes >= priv->bytes_in_packet)
+    return 0;
+  
+  priv->packet_ptr += bytes;
+  priv->bytes_in_packet -= bytes;
+  return 1;
+  }
+
 static bgav_audio_decoder_t decoder =
   {
     .fourccs = (uint32_t[]){ BGAV_WAVID_2_FOURCC(0x0001),
@@ -1311,6 +1338,7 @@ static bgav_audio_decoder_t decoder =
     .init = init_pcm,
     .close = close_pcm,
     .resync = resync_pcm,
+    .skip = skip_pcm,
     .decode_frame = decode_frame_pcm
   };
 
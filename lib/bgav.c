@@ -63,8 +63,13 @@ create_demuxer(bgav_t * b)
   bgav_demuxer_context_t * ret = NULL;
   const bgav_demuxer_t * demuxer;
   
-  if((demuxer = bgav_demuxer_probe(b->input)))
+  /* Reused decoders of batch scans probe the last format first */
+  if((demuxer = bgav_demuxer_probe(b->input, (b->flags & BGAV_FLAG_SCAN) ?
+                                   b->last_demuxer : NULL)))
+    {
+    b->last_demuxer = demuxer;
     ret = bgav_demuxer_create(b, demuxer, NULL);
+    }
 
   else
     return NULL;
@@ -93,6 +98,8 @@ int bgav_init(bgav_t * ret)
   const bgav_redirector_t * redirector = NULL;
   
   //  bgav_subtitle_reader_context_t * subreader, * subreaders;
+
+  bgav_trace_init(ret);
   
   /*
    *  If the input already has it's track table,
@@ -247,6 +254,7 @@ bgav_t * bgav_create()
 
 int bgav_open(bgav_t * ret, const char * location)
   {
+  bgav_trace_init(ret);
   bgav_codecs_init(&ret->opt);
   ret->input = bgav_input_create(ret, NULL);
   
@@ -278,10 +286,21 @@ int bgav_open(bgav_t * ret, const char * location)
   return 0;
   }
 
-void bgav_close(bgav_t * b)
+int bgav_open_scan(bgav_t * ret, const char * location)
+  {
+  ret->flags |= BGAV_FLAG_SCAN;
+  return bgav_open(ret, location);
+  }
+
+/* Close the location but keep the options (used by scan.c) */
+
+void bgav_reset(bgav_t * b)
   {
   if(b->location)
+    {
     free(b->location);
+    b->location = NULL;
+    }
   
   if(b->flags & BGAV_FLAG_IS_RUNNING)
     {
@@ -289,17 +308,38 @@ void bgav_close(bgav_t * b)
     b->flags &= ~BGAV_FLAG_IS_RUNNING;
     }
   if(b->tt)
+    {
     bgav_track_table_unref(b->tt);
+    b->tt = NULL;
+    }
   
   if(b->demuxer)
+    {
     bgav_demuxer_destroy(b->demuxer);
-
+    b->demuxer = NULL;
+    }
+  
   if(b->input)
+    {
     bgav_input_destroy(b->input);
+    b->input = NULL;
+    }
+  
+  gavl_dictionary_reset(&b->state);
+
+  /* A running trace stays with the decoder */
+  b->flags &= BGAV_FLAG_TRACE;
+  }
+
+void bgav_close(bgav_t * b)
+  {
+  bgav_reset(b);
   
   bgav_options_free(&b->opt);
 
   gavl_dictionary_free(&b->state);
+
+  bgav_trace_close(b);
   
   free(b);
   }
@@ -415,6 +455,7 @@ int bgav_select_track(bgav_t * b, int track)
     {
     if(b->demuxer->si)
       {
+      bgav_demuxer_load_si_window(b->demuxer, GAVL_TIME_UNDEFINED, 0);
       b->demuxer->index_position = 0;
       
       if(b->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
@@ -461,6 +502,7 @@ int bgav_select_track(bgav_t * b, int track)
       {
       if(b->demuxer->si && was_running)
         {
+        bgav_demuxer_load_si_window(b->demuxer, GAVL_TIME_UNDEFINED, 0);
         b->demuxer->index_position = 0;
         if(b->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
           bgav_input_seek(b->input, b->demuxer->si->entries[0].position,
@@ -518,6 +560,12 @@ int bgav_start(bgav_t * b)
   /* Create buffers */
   //  bgav_input_buffer(b->input);
 
+  if(b->flags & BGAV_FLAG_SCAN)
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Cannot start decoder opened with bgav_open_scan");
+    return 0;
+    }
+  
   if(b->demuxer)
     {
     if(!bgav_track_start(b->tt->cur, b->demuxer))
@@ -584,6 +632,14 @@ int bgav_can_pause(bgav_t * bgav)
   return 0;
   }
 
+int bgav_get_rtp_stats(bgav_t * bgav, bgav_rtp_stats_t * stats)
+  {
+  if(bgav->input && bgav->input->input &&
+     bgav->input->input->get_rtp_stats)
+    return bgav->input->input->get_rtp_stats(bgav->input, stats);
+  return 0;
+  }
+
 int bgav_set_stream_action_all(bgav_t * bgav, int idx, bgav_stream_action_t action)
   {
   if(!bgav->tt || !bgav->tt->cur || (idx < 0) || (idx >= bgav->tt->cur->num_streams))
@@ -32,13 +32,26 @@
 
 /* Charset detection. This detects UTF-8 and UTF-16 for now */
 
+#define ASCII_MASK 0x8080808080808080ULL
+
 int bgav_utf8_validate(const uint8_t * str, const uint8_t * end)
   {
+  uint64_t w;
+  
   if(end == NULL)
     end = str + strlen((char*)str);
   
   while(1)
     {
+    /* Fast path: Skip 8 ASCII characters at once */
+    while(end - str >= 8)
+      {
+      memcpy(&w, str, 8);
+      if(w & ASCII_MASK)
+        break;
+      str += 8;
+      }
+    
     if(str == end)
       return 1;
     /* 0xxxxxxx */
@@ -89,15 +102,22 @@ int bgav_utf8_validate(const uint8_t * str, const uint8_t * end)
   return 1;
   }
 
+/* Bytes to validate at once */
+#define DETECT_CHUNK (64*1024)
+
 void bgav_input_detect_charset(bgav_input_context_t * ctx)
   {
-  gavl_buffer_t line_buf;
+  uint8_t * buf;
+  int len;
+  int result;
+  int split;
+  int i;
+  int carry = 0;
+  int valid = 1;
   
   int64_t old_position;
   uint8_t first_bytes[2];
 
-  gavl_buffer_init(&line_buf);
-  
   /* We need byte accurate seeking */
   if(!(ctx->flags & BGAV_INPUT_CAN_SEEK_BYTE) || !ctx->total_bytes || ctx->charset)
     return;
@@ -121,22 +141,48 @@ void bgav_input_detect_charset(bgav_input_context_t * ctx)
     bgav_input_seek(ctx, old_position, SEEK_SET);
     return;
     }
-  else
+
+  /* Validate the whole file in large chunks */
+  buf = malloc(DETECT_CHUNK);
+  
+  while(1)
     {
-    while(bgav_input_read_line(ctx, &line_buf))
+    result = bgav_input_read_data(ctx, buf + carry, DETECT_CHUNK - carry);
+    len = carry + result;
+
+    if(!len)
+      break;
+    
+    split = len;
+    
+    /* Don't split multibyte sequences at the chunk boundary */
+    if(result)
       {
-      if(!bgav_utf8_validate(line_buf.buf, NULL))
-        {
-        bgav_input_seek(ctx, old_position, SEEK_SET);
-        gavl_buffer_free(&line_buf);
-        return;
-        }
+      i = len;
+      while((i > 0) && (len - i < 3) && ((buf[i-1] & 0xc0) == 0x80))
+        i--;
+      if((i > 0) && ((buf[i-1] & 0xc0) == 0xc0))
+        split = i - 1;
       }
-    ctx->charset = gavl_strdup(GAVL_UTF8);
-    bgav_input_seek(ctx, old_position, SEEK_SET);
-    gavl_buffer_free(&line_buf);
-    return;
+    
+    if(!bgav_utf8_validate(buf, buf + split))
+      {
+      valid = 0;
+      break;
+      }
+
+    if(!result)
+      break;
+    
+    carry = len - split;
+    if(carry)
+      memmove(buf, buf + split, carry);
     }
+  
+  free(buf);
+
+  if(valid)
+    ctx->charset = gavl_strdup(GAVL_UTF8);
+  
   bgav_input_seek(ctx, old_position, SEEK_SET);
-  gavl_buffer_free(&line_buf);
   }
@@ -55,6 +55,18 @@ static int codecs_initialized = 0;
 static int num_audio_codecs = 0;
 static int num_video_codecs = 0;
 
+/*
+ *  After initialization, the registry is frozen into hash tables,
+ *  which map each fourcc to the decoders supporting it (in
+ *  registration order). Lookups only read these, so they need no lock.
+ */
+
+static bgav_fourcc_table_t audio_table;
+static bgav_audio_decoder_t ** audio_table_decoders = NULL;
+
+static bgav_fourcc_table_t video_table;
+static bgav_video_decoder_t ** video_table_decoders = NULL;
+
 static pthread_mutex_t codec_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void codecs_lock()
@@ -67,6 +79,94 @@ static void codecs_unlock()
   pthread_mutex_unlock(&codec_mutex);
   }
 
+static int codecs_frozen()
+  {
+  return __atomic_load_n(&codecs_initialized, __ATOMIC_ACQUIRE);
+  }
+
+static void freeze_audio_decoders()
+  {
+  int num = 0;
+  int i;
+  uint32_t * keys;
+  bgav_audio_decoder_t * cur;
+  
+  for(cur = audio_decoders; cur; cur = cur->next)
+    {
+    i = 0;
+    while(cur->fourccs[i])
+      i++;
+    num += i;
+    }
+
+  keys = calloc(num + 1, sizeof(*keys));
+  audio_table_decoders = calloc(num + 1, sizeof(*audio_table_decoders));
+
+  num = 0;
+  for(cur = audio_decoders; cur; cur = cur->next)
+    {
+    i = 0;
+    while(cur->fourccs[i])
+      {
+      keys[num] = cur->fourccs[i];
+      audio_table_decoders[num] = cur;
+      num++;
+      i++;
+      }
+    }
+  bgav_fourcc_table_init(&audio_table, keys, num);
+  free(keys);
+  }
+
+static void freeze_video_decoders()
+  {
+  int num = 0;
+  int i;
+  uint32_t * keys;
+  bgav_video_decoder_t * cur;
+  
+  for(cur = video_decoders; cur; cur = cur->next)
+    {
+    i = 0;
+    while(cur->fourccs[i])
+      i++;
+    num += i;
+    }
+
+  keys = calloc(num + 1, sizeof(*keys));
+  video_table_decoders = calloc(num + 1, sizeof(*video_table_decoders));
+
+  num = 0;
+  for(cur = video_decoders; cur; cur = cur->next)
+    {
+    i = 0;
+    while(cur->fourccs[i])
+      {
+      keys[num] = cur->fourccs[i];
+      video_table_decoders[num] = cur;
+      num++;
+      i++;
+      }
+    }
+  bgav_fourcc_table_init(&video_table, keys, num);
+  free(keys);
+  }
+
+#if defined(__GNUC__) && defined(__ELF__)
+static void __cleanup() __attribute__ ((destructor));
+ 
+static void __cleanup()
+  {
+  bgav_fourcc_table_free(&audio_table);
+  bgav_fourcc_table_free(&video_table);
+  
+  if(audio_table_decoders)
+    free(audio_table_decoders);
+  if(video_table_decoders)
+    free(video_table_decoders);
+  }
+#endif
+
 
 void bgav_codecs_dump()
   {
@@ -103,13 +203,16 @@ void bgav_codecs_dump()
 
 void bgav_codecs_init(bgav_options_t * opt)
   {
+  /* Fast path: Called on each bgav_open() */
+  if(codecs_frozen())
+    return;
+  
   codecs_lock();
   if(codecs_initialized)
     {
     codecs_unlock();
     return;
     }
-  codecs_initialized = 1;
   
 #ifdef HAVE_V4L2
   bgav_init_video_decoders_v4l2();
@@ -176,7 +279,10 @@ void bgav_codecs_init(bgav_options_t * opt)
   bgav_init_video_decoders_rtjpeg();
   bgav_init_video_decoders_dvdsub();
 
-
+  freeze_audio_decoders();
+  freeze_video_decoders();
+  
+  __atomic_store_n(&codecs_initialized, 1, __ATOMIC_RELEASE);
   
   codecs_unlock();
   
@@ -216,65 +322,36 @@ void bgav_video_decoder_register(bgav_video_decoder_t * dec)
 
 bgav_audio_decoder_t * bgav_find_audio_decoder(uint32_t fourcc)
   {
-  bgav_audio_decoder_t * cur;
-  int i;
-  codecs_lock();
-  cur = audio_decoders;
-  //  if(!codecs_initialized)
-  //    bgav_codecs_init();
+  const int * idx;
+  int num;
 
+  if(!codecs_frozen())
+    return NULL;
   
-  while(cur)
-    {
-    i = 0;
-    while(cur->fourccs[i])
-      {
-      if(cur->fourccs[i] == fourcc)
-        {
-        codecs_unlock();
-        return cur;
-        }
-      else
-        i++;
-      }
-    cur = cur->next;
-    }
-  codecs_unlock();
-  return NULL;
+  if(!(idx = bgav_fourcc_table_get(&audio_table, fourcc, &num)))
+    return NULL;
+  
+  return audio_table_decoders[idx[0]];
   }
 
 bgav_video_decoder_t * bgav_find_video_decoder(uint32_t fourcc, const gavl_dictionary_t * stream)
   {
+  const int * idx;
+  int num, i;
   bgav_video_decoder_t * cur;
-  int i;
-  codecs_lock();
-
-  //  if(!codecs_initialized)
-  //    bgav_codecs_init();
   
-  cur = video_decoders;
+  if(!codecs_frozen())
+    return NULL;
+  
+  if(!(idx = bgav_fourcc_table_get(&video_table, fourcc, &num)))
+    return NULL;
 
-  while(cur)
+  for(i = 0; i < num; i++)
     {
-    i = 0;
-    while(cur->fourccs[i])
-      {
-      if(cur->fourccs[i] == fourcc)
-        {
-        if(!cur->probe || !stream || cur->probe(stream))
-          {
-          codecs_unlock();
-          return cur;
-          }
-        else
-          i++;
-        }
-      else
-        i++;
-      }
-    cur = cur->next;
+    cur = video_table_decoders[idx[i]];
+    if(!cur->probe || !stream || cur->probe(stream))
+      return cur;
     }
-  codecs_unlock();
   return NULL;
   }
 
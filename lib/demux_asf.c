@@ -46,11 +46,13 @@ static const bgav_GUID_t guid_data =
   { 0x75b22636, 0x668e, 0x11cf,
     { 0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c } };
 
-#if 0
 static const bgav_GUID_t guid_simple_index = 
   { 0x33000890, 0xe5b1, 0x11cf,
     { 0x89, 0xf4, 0x00, 0xa0, 0xc9, 0x03, 0x49, 0xcb } };
-#endif
+
+static const bgav_GUID_t guid_index = 
+  { 0xd6e229d3, 0x35da, 0x11d1,
+    { 0x90, 0x34, 0x00, 0xa0, 0xc9, 0x03, 0x49, 0xbe } };
 
 /* header ASF objects */
 static const bgav_GUID_t guid_file_properties = 
@@ -326,6 +328,11 @@ typedef struct
     uint32_t bitrate;
     } * stream_bitrates;
   int num_stream_bitrates;
+
+  /* Time -> packet table from the (simple) index object */
+  uint32_t * index_packets;
+  int num_index_entries;
+  int64_t index_interval; /* 100 ns units */
   } asf_t;
 
 static int probe_asf(bgav_input_context_t * input)
@@ -481,6 +488,134 @@ static int read_metadata(bgav_demuxer_context_t * ctx)
   }
 
 
+/* Index objects after the data object */
+
+static int read_simple_index(bgav_demuxer_context_t * ctx, uint64_t size)
+  {
+  int i;
+  uint32_t max_packet_count;
+  uint32_t num_entries;
+  uint16_t packet_count;
+  uint64_t interval;
+  bgav_GUID_t file_id;
+  asf_t * asf = ctx->priv;
+
+  if(!bgav_GUID_read(&file_id, ctx->input) ||
+     !bgav_input_read_64_le(ctx->input, &interval) ||
+     !bgav_input_read_32_le(ctx->input, &max_packet_count) ||
+     !bgav_input_read_32_le(ctx->input, &num_entries) ||
+     !interval || !num_entries)
+    return 0;
+
+  /* Header is 56 bytes, entries are 6 bytes each */
+  if(size < 56)
+    return 0;
+  if(num_entries > (size - 56) / 6)
+    num_entries = (size - 56) / 6;
+  
+  asf->index_packets = malloc(num_entries * sizeof(*asf->index_packets));
+
+  for(i = 0; i < num_entries; i++)
+    {
+    if(!bgav_input_read_32_le(ctx->input, &asf->index_packets[i]) ||
+       !bgav_input_read_16_le(ctx->input, &packet_count))
+      break;
+    }
+  asf->num_index_entries = i;
+  asf->index_interval = interval;
+  return 1;
+  }
+
+static int read_index(bgav_demuxer_context_t * ctx, int64_t end_pos)
+  {
+  int i, j;
+  uint32_t interval;
+  uint16_t num_specifiers;
+  uint32_t num_blocks;
+  uint32_t num_entries;
+  uint32_t offset;
+  uint64_t block_pos;
+  asf_t * asf = ctx->priv;
+
+  if(!bgav_input_read_32_le(ctx->input, &interval) ||
+     !bgav_input_read_16_le(ctx->input, &num_specifiers) ||
+     !bgav_input_read_32_le(ctx->input, &num_blocks) ||
+     !interval || !num_specifiers)
+    return 0;
+
+  /* Stream number and index type: We use the first specifier */
+  bgav_input_skip(ctx->input, 4 * num_specifiers);
+
+  for(i = 0; i < num_blocks; i++)
+    {
+    if(!bgav_input_read_32_le(ctx->input, &num_entries) ||
+       !bgav_input_read_64_le(ctx->input, &block_pos))
+      break;
+    bgav_input_skip(ctx->input, 8 * (num_specifiers - 1));
+
+    /* Don't trust entry counts exceeding the object */
+    if(ctx->input->position >= end_pos)
+      break;
+    if(num_entries > (end_pos - ctx->input->position) / (4 * num_specifiers))
+      num_entries = (end_pos - ctx->input->position) / (4 * num_specifiers);
+    
+    asf->index_packets = realloc(asf->index_packets,
+                                 (asf->num_index_entries + num_entries) *
+                                 sizeof(*asf->index_packets));
+    for(j = 0; j < num_entries; j++)
+      {
+      if(!bgav_input_read_32_le(ctx->input, &offset))
+        break;
+      bgav_input_skip(ctx->input, 4 * (num_specifiers - 1));
+
+      /* Byte offset relative to the first data packet */
+      asf->index_packets[asf->num_index_entries++] =
+        (block_pos + offset) / ctx->packet_size;
+      }
+    if(j < num_entries)
+      break;
+    }
+
+  asf->index_interval = (int64_t)interval * 10000;
+  return !!asf->num_index_entries;
+  }
+
+static void read_indices(bgav_demuxer_context_t * ctx, int64_t pos)
+  {
+  bgav_GUID_t guid;
+  uint64_t size;
+  asf_t * asf = ctx->priv;
+
+  bgav_input_seek(ctx->input, pos, SEEK_SET);
+
+  while(!asf->num_index_entries)
+    {
+    if(!bgav_GUID_read(&guid, ctx->input) ||
+       !bgav_input_read_64_le(ctx->input, &size) ||
+       (size < 24))
+      break;
+
+    if(bgav_GUID_equal(&guid, &guid_simple_index))
+      read_simple_index(ctx, size);
+    else if(bgav_GUID_equal(&guid, &guid_index))
+      read_index(ctx, pos + size);
+
+    pos += size;
+    bgav_input_seek(ctx->input, pos, SEEK_SET);
+    }
+
+  if(asf->num_index_entries)
+    gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Found index with %d entries",
+             asf->num_index_entries);
+  else if(asf->index_packets)
+    {
+    free(asf->index_packets);
+    asf->index_packets = NULL;
+    }
+  
+  bgav_input_seek(ctx->input, ctx->tt->cur->data_start, SEEK_SET);
+  }
+
 static int open_asf(bgav_demuxer_context_t * ctx)
   {
   int64_t chunk_start_pos;
@@ -754,7 +889,16 @@ static int open_asf(bgav_demuxer_context_t * ctx)
     free(buf);
   
   if((ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) && asf->hdr.packets_count)
+    {
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+
+    if(asf->data_size > 50)
+      read_indices(ctx, chunk_start_pos + asf->data_size);
+    
+    /* Bisection with post_seek_resync_asf */
+    if(!asf->num_index_entries)
+      ctx->flags |= BGAV_DEMUXER_SEEK_ITERATIVE;
+    }
   
   bgav_track_set_format(ctx->tt->cur, "ASF", "application/x-mplayer2");
   
@@ -1145,25 +1289,30 @@ static gavl_source_status_t next_packet_asf(bgav_demuxer_context_t * ctx)
   return GAVL_SOURCE_OK;
   }
 
-#if 0
 static void seek_asf(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   {
+  int64_t idx;
   int64_t filepos;
   asf_t * asf = ctx->priv;
-  /* Reset all the streams */
+
+  idx = gavl_time_rescale(scale, 10000000, time) / asf->index_interval;
+
+  if(idx < 0)
+    idx = 0;
+  else if(idx >= asf->num_index_entries)
+    idx = asf->num_index_entries - 1;
+
+  /* Skip entries pointing behind the data object */
+  while((idx >= 0) && (asf->index_packets[idx] >= asf->hdr.packets_count))
+    idx--;
   
-  asf->packets_read =
-    (int64_t)((double)asf->hdr.packets_count *
-              (gavl_time_to_seconds(gavl_time_unscale(scale, time))/
-               gavl_time_to_seconds(gavl_track_get_duration(ctx->tt->cur->info))));
+  asf->packets_read = (idx >= 0) ? asf->index_packets[idx] : 0;
   
   filepos = ctx->tt->cur->data_start +
     ctx->packet_size * asf->packets_read;
   
   bgav_input_seek(ctx->input, filepos, SEEK_SET);
-  
   }
-#endif
 
 static int post_seek_resync_asf(bgav_demuxer_context_t * ctx)
   {
@@ -1193,6 +1342,9 @@ static void close_asf(bgav_demuxer_context_t * ctx)
 
   if(asf->stream_bitrates)
     free(asf->stream_bitrates);
+
+  if(asf->index_packets)
+    free(asf->index_packets);
   
   free(ctx->priv);
   }
@@ -1211,7 +1363,7 @@ const bgav_demuxer_t bgav_demuxer_asf =
     .open             =  open_asf,
     .select_track     =  select_track_asf,
     .next_packet      =  next_packet_asf,
-    //    .seek             =  seek_asf,
+    .seek             =  seek_asf,
     .post_seek_resync =  post_seek_resync_asf,
     .close            =  close_asf
   };
@@ -23,11 +23,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <nanosoft.h>
+#include <bswap.h>
 
 #include <dvframe.h>
+#include <avi.h>
 #define LOG_DOMAIN "avi"
 
 /* Define the variables below to get a detailed file dump
@@ -228,19 +231,6 @@ typedef struct
   uint32_t fccType;
   } riff_header_t;
 
-/* idx1 */
-
-typedef struct
-  {
-  uint32_t num_entries;
-  struct
-    {
-    uint32_t ckid;
-    uint32_t dwFlags;
-    uint32_t dwChunkOffset;
-    uint32_t dwChunkLength;
-    } * entries;
-  } idx1_t;
 
 /* strh */
 
@@ -348,7 +338,7 @@ typedef struct indx_s
 typedef struct
   {
   avih_t avih;
-  idx1_t idx1;
+  avi_idx1_t idx1;
   int has_idx1;
   
   uint32_t movi_size;
@@ -575,13 +565,13 @@ static int read_avih(bgav_input_context_t* input,
 
 /* indx */
 
-static void free_idx1(idx1_t * idx1)
+void bgav_avi_idx1_free(avi_idx1_t * idx1)
   {
   if(idx1->entries)
     free(idx1->entries);
   }
 
-static void dump_idx1(idx1_t * idx1)
+static void dump_idx1(avi_idx1_t * idx1)
   {
   int i;
   gavl_dprintf("idx1, %d entries\n", idx1->num_entries);
@@ -607,23 +597,27 @@ static int probe_idx1(bgav_input_context_t * input)
   return 0;
   }
 
-static int read_idx1(bgav_input_context_t * input, idx1_t * ret)
+int bgav_avi_idx1_read(bgav_input_context_t * input, avi_idx1_t * ret)
   {
   int i;
   chunk_header_t ch;
   if(!read_chunk_header(input, &ch))
     return 0;
   ret->num_entries = ch.ckSize / 16;
+
+  if(ret->num_entries > INT_MAX / 4)
+    return 0;
   
   ret->entries = calloc(ret->num_entries, sizeof(*ret->entries));
+
+  /* Entries are 4 little endian integers, except for the fourcc */
+  if(!bgav_input_read_array_32_le(input, (uint32_t*)ret->entries,
+                                  ret->num_entries * 4))
+    return 0;
+
   for(i = 0; i < ret->num_entries; i++)
-    {
-    if(!bgav_input_read_fourcc(input, &ret->entries[i].ckid) ||
-       !bgav_input_read_32_le(input, &ret->entries[i].dwFlags) ||
-       !bgav_input_read_32_le(input, &ret->entries[i].dwChunkOffset) ||
-       !bgav_input_read_32_le(input, &ret->entries[i].dwChunkLength))
-      return 0;
-    }
+    ret->entries[i].ckid = bswap_32(ret->entries[i].ckid);
+  
   return 1;
   }
 
@@ -797,31 +791,28 @@ static int read_indx(bgav_input_context_t * input, indx_t * ret,
         if(!bgav_input_read_64_le(input, &ret->i.field_chunk.qwBaseOffset) ||
            !bgav_input_read_32_le(input, &ret->i.field_chunk.dwReserved3))
           return 0;
+        if(ret->nEntriesInUse > INT_MAX / 3)
+          return 0;
         ret->i.field_chunk.entries =
           malloc(ret->nEntriesInUse * sizeof(*(ret->i.field_chunk.entries)));
 
-        for(i = 0; i < ret->nEntriesInUse; i++)
-          {
-          if(!bgav_input_read_32_le(input, &ret->i.field_chunk.entries[i].dwOffset) ||
-             !bgav_input_read_32_le(input, &ret->i.field_chunk.entries[i].dwSize) ||
-             !bgav_input_read_32_le(input, &ret->i.field_chunk.entries[i].dwOffsetField2))
-            return 0;
-          }
+        if(!bgav_input_read_array_32_le(input, (uint32_t*)ret->i.field_chunk.entries,
+                                        ret->nEntriesInUse * 3))
+          return 0;
         }
       else
         {
         if(!bgav_input_read_64_le(input, &ret->i.chunk.qwBaseOffset) ||
            !bgav_input_read_32_le(input, &ret->i.chunk.dwReserved3))
           return 0;
+        if(ret->nEntriesInUse > INT_MAX / 2)
+          return 0;
         ret->i.chunk.entries =
           malloc(ret->nEntriesInUse * sizeof(*(ret->i.chunk.entries)));
         
-        for(i = 0; i < ret->nEntriesInUse; i++)
-          {
-          if(!bgav_input_read_32_le(input, &ret->i.chunk.entries[i].dwOffset) ||
-             !bgav_input_read_32_le(input, &ret->i.chunk.entries[i].dwSize))
-            return 0;
-          }
+        if(!bgav_input_read_array_32_le(input, (uint32_t*)ret->i.chunk.entries,
+                                        ret->nEntriesInUse * 2))
+          return 0;
         }
       break;
     }
@@ -1648,7 +1639,7 @@ static int open_avi(bgav_demuxer_context_t * ctx)
     {
     bgav_input_seek(ctx->input, ctx->tt->cur->data_start + p->movi_size, SEEK_SET);
 
-    if(probe_idx1(ctx->input) && read_idx1(ctx->input, &p->idx1))
+    if(probe_idx1(ctx->input) && bgav_avi_idx1_read(ctx->input, &p->idx1))
       {
       p->has_idx1 = 1;
 
@@ -1786,7 +1777,7 @@ static void close_avi(bgav_demuxer_context_t * ctx)
   if(priv)
     {
     if(priv->has_idx1)
-      free_idx1(&priv->idx1);
+      bgav_avi_idx1_free(&priv->idx1);
         
     if(priv->info)
       bgav_RIFFINFO_destroy(priv->info);
@@ -90,20 +90,18 @@ static int open_dv(bgav_demuxer_context_t * ctx)
   vs->stream_id = VIDEO_ID;
   vs->ci->flags &= ~GAVL_COMPRESSION_HAS_B_FRAMES;
   
+  ctx->tt->cur->data_start = ctx->input->position;
+  
   /* Set duration */
 
-  if(ctx->input->total_bytes)
-    {
-    total_frames = ctx->input->total_bytes / priv->frame_size;
-    vs->stats.pts_end = (int64_t)total_frames * vs->data.video.format->frame_duration;
-    }
+  if((total_frames = bgav_demuxer_stride_frames(ctx, priv->frame_size)) >= 0)
+    vs->stats.pts_end = total_frames * vs->data.video.format->frame_duration;
   
   if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
   
   bgav_track_set_format(ctx->tt->cur, "DV", NULL);
   
-  ctx->tt->cur->data_start = ctx->input->position;
   ctx->index_mode = INDEX_MODE_SIMPLE;
   
   return 1;
@@ -154,31 +152,25 @@ static gavl_source_status_t next_packet_dv(bgav_demuxer_context_t * ctx)
 static void seek_dv(bgav_demuxer_context_t * ctx, int64_t time,
                     int scale)
   {
-  int64_t file_position;
   dv_priv_t * priv;
   bgav_stream_t * as, * vs;
-  int64_t frame_pos;
   int64_t t;
   priv = ctx->priv;
   vs = bgav_track_get_video_stream(ctx->tt->cur, 0);
   as = bgav_track_get_audio_stream(ctx->tt->cur, 0);
   
-  t = gavl_time_rescale(scale, vs->data.video.format->timescale,
-                        time);
-  
-  frame_pos = t / vs->data.video.format->frame_duration;
+  t = bgav_demuxer_stride_seek(ctx, priv->frame_size,
+                               vs->data.video.format->frame_duration,
+                               vs->data.video.format->timescale,
+                               time, scale);
   
-  file_position = frame_pos * priv->frame_size;
-
-  t = frame_pos * vs->data.video.format->frame_duration;
+  t *= vs->data.video.format->frame_duration;
   STREAM_SET_SYNC(vs, t);
   
   STREAM_SET_SYNC(as, 
                   gavl_time_rescale(vs->data.video.format->timescale,
                                     as->data.audio.format->samplerate,
                                     t));
-  
-  bgav_input_seek(ctx->input, file_position, SEEK_SET);
   }
 
 
@@ -562,6 +562,14 @@ static void init_video_stream(bgav_demuxer_context_t * ctx,
   s->stream_id = index;
   }
 
+static int is_rtp_session(bgav_input_context_t * input)
+  {
+  return input->location &&
+    (gavl_string_starts_with(input->location, "sdp://") ||
+     gavl_string_starts_with(input->location, "rtp://") ||
+     gavl_string_starts_with(input->location, "rtsp://"));
+  }
+
 static int open_ffmpeg(bgav_demuxer_context_t * ctx)
   {
   int i;
@@ -571,11 +579,24 @@ static int open_ffmpeg(bgav_demuxer_context_t * ctx)
   
   AVDictionaryEntry * tag;
   AVDictionary *opts = NULL;
+  int jitter = 200;
+  int udp_buffer = 0;
   
   avformat_network_init();
 
   av_dict_set(&opts, "protocol_whitelist", "file,udp,rtp", 0);
   av_dict_set(&opts, "reorder_queue_size", "500", 0);
+
+  /* Jitter buffer depth and socket buffer for RTP sessions */
+  if(is_rtp_session(ctx->input))
+    {
+    gavl_dictionary_get_int(ctx->opt, BGAV_OPT_RTP_JITTER, &jitter);
+    av_dict_set_int(&opts, "max_delay", (int64_t)jitter * 1000, 0);
+
+    if(gavl_dictionary_get_int(ctx->opt, BGAV_OPT_UDP_BUFFER, &udp_buffer) &&
+       (udp_buffer > 0))
+      av_dict_set_int(&opts, "buffer_size", udp_buffer, 0);
+    }
   //  av_dict_set(&opts, "localaddr", "10.0.0.19", 0);
   
   priv = calloc(1, sizeof(*priv));
@@ -90,6 +90,8 @@ typedef struct
   int need_video_extradata;
 
   int audio_frame_duration;
+
+  int load_si; /* Build the seek index on the first seek */
   } flv_priv_t;
 
 static int probe_flv(bgav_input_context_t * input)
@@ -760,7 +762,7 @@ static void handle_metadata(bgav_demuxer_context_t * ctx)
   {
   bgav_stream_t * s;
   double number;
-  meta_object_t * obj, *obj1;
+  meta_object_t * obj;
   int num_obj;
   flv_priv_t * priv;
   int as, vs;
@@ -785,68 +787,278 @@ static void handle_metadata(bgav_demuxer_context_t * ctx)
   
   if(meta_object_find_number(obj, num_obj, "duration", &number) && (number != 0.0))
     gavl_track_set_duration(ctx->tt->cur->info, gavl_seconds_to_time(number));
+  }
+
+/*
+ *  Seek index
+ *
+ *  The index is sparse: It contains the positions of the tags (including
+ *  the preceding PreviousTagSize) for seek_si(), the packets are still
+ *  read by next_packet_flv(). It is built on the first seek, because
+ *  it can mean reading all tag headers. It is taken from the keyframes
+ *  table of onMetaData if each entry points to a video keyframe with the
+ *  right timestamp. Otherwise it is built by scanning only the tag
+ *  headers.
+ */
+
+/* Maximum difference between metadata time and tag timestamp (ms) */
+#define INDEX_TIME_TOLERANCE 2
+
+/* Maximum number of tags to search for the audio after a keyframe */
+#define INDEX_MAX_AUDIO_SEARCH 16
+
+/* Maximum number of tags before the first keyframe */
+#define INDEX_MAX_START_TAGS 64
+
+/*
+ *  Read PreviousTagSize, tag header and the first data byte.
+ *  For H.264, the composition time offset is added to the pts
+ *  like in next_packet_flv().
+ */
+
+static int read_tag_header(bgav_input_context_t * input, int64_t pos,
+                           uint32_t * prev_size, flv_tag * t, uint8_t * flags,
+                           int64_t * pts)
+  {
+  uint8_t type;
+  uint32_t cts;
   
-  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+  bgav_input_seek(input, pos, SEEK_SET);
+  
+  if(!bgav_input_read_32_be(input, prev_size) ||
+     !flv_tag_read(input, t))
+    return 0;
+
+  *flags = 0;
+  if(((t->type == AUDIO_ID) || (t->type == VIDEO_ID)) &&
+     t->data_size &&
+     !bgav_input_read_8(input, flags))
+    return 0;
+
+  if((t->type == VIDEO_ID) && ((*flags & 0xf) == 7) && (t->data_size >= 5))
     {
-    obj1 = meta_object_find(obj, num_obj, "keyframes");
-    
-    if(obj1 && (obj1->type == TYPE_OBJECT) &&
-       meta_object_find(obj1->data.object.children, obj1->data.object.num_children,
-                        "filepositions") &&
-       meta_object_find(obj1->data.object.children, obj1->data.object.num_children,
-                        "times"))
-      ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    if(!bgav_input_read_8(input, &type) ||
+       !bgav_input_read_24_be(input, &cts))
+      return 0;
+    *pts = (int64_t)t->timestamp + cts;
     }
+  else
+    *pts = t->timestamp;
+  
+  return 1;
+  }
+
+static void index_add_tag(bgav_demuxer_context_t * ctx, int64_t pos,
+                          const flv_tag * t, uint8_t flags, int64_t pts)
+  {
+  int keyframe = 1;
+  
+  if(((t->type != AUDIO_ID) && (t->type != VIDEO_ID)) ||
+     !bgav_track_find_stream_all(ctx->tt->cur, t->type))
+    return;
+
+  if((t->type == VIDEO_ID) && ((flags >> 4) != 1))
+    keyframe = 0;
+  
+  gavl_packet_index_add(ctx->si, pos, t->data_size, t->type,
+                        pts,
+                        keyframe ? GAVL_PACKET_KEYFRAME : 0, 0);
   }
 
-static void seek_flv(bgav_demuxer_context_t * ctx, int64_t time, int scale)
+static int index_from_metadata(bgav_demuxer_context_t * ctx)
   {
-  double time_float;
   meta_object_t * obj;
   int num_obj;
-  
   meta_object_t * times;
   meta_object_t * filepositions;
   meta_object_t * keyframes;
-  int64_t file_pos;
-  uint32_t i;
   flv_priv_t * priv;
+  int i, j;
+  int num;
+  int64_t pos;
+  int64_t next_pos;
+  int64_t key_pos;
+  uint32_t prev_size;
+  uint8_t flags;
+  int64_t pts;
+  flv_tag t;
+  int have_audio;
+  
   priv = ctx->priv;
   
-  /* Get index objects */
-
   obj = priv->metadata.data.object.children;
   num_obj = priv->metadata.data.object.num_children;
 
-  keyframes = meta_object_find(obj, num_obj, "keyframes");
-
-  if(!keyframes)
-    return;
+  if(!(keyframes = meta_object_find(obj, num_obj, "keyframes")) ||
+     (keyframes->type != TYPE_OBJECT))
+    return 0;
   
   obj = keyframes->data.object.children;
   num_obj = keyframes->data.object.num_children;
   
-  times = meta_object_find(obj, num_obj, "times");
-  if(!times)
-    return;
-  filepositions = meta_object_find(obj, num_obj, "filepositions");
-  if(!filepositions)
-    return;
+  if(!(times = meta_object_find(obj, num_obj, "times")) ||
+     !(filepositions = meta_object_find(obj, num_obj, "filepositions")) ||
+     (times->type != TYPE_ARRAY) || (filepositions->type != TYPE_ARRAY))
+    return 0;
+
+  num = times->data.array.num_elements;
+  if(num > filepositions->data.array.num_elements)
+    num = filepositions->data.array.num_elements;
+  if(!num)
+    return 0;
+  
+  have_audio = !!ctx->tt->cur->num_audio_streams;
+  
+  ctx->si = gavl_packet_index_create(0);
+  
+  /* Tags before the first keyframe */
+  key_pos = (int64_t)filepositions->data.array.elements[0].data.number - 4;
+  pos = ctx->tt->cur->data_start;
+
+  for(i = 0; i < INDEX_MAX_START_TAGS; i++)
+    {
+    if(pos >= key_pos)
+      break;
+    if(!read_tag_header(ctx->input, pos, &prev_size, &t, &flags, &pts))
+      goto fail;
+    index_add_tag(ctx, pos, &t, flags, pts);
+    pos += 15 + t.data_size;
+    }
+  if(pos != key_pos)
+    goto fail;
+  
+  for(i = 0; i < num; i++)
+    {
+    /* Validate keyframe */
+    
+    if((times->data.array.elements[i].type != TYPE_NUMBER) ||
+       (filepositions->data.array.elements[i].type != TYPE_NUMBER))
+      goto fail;
+    
+    pos = (int64_t)filepositions->data.array.elements[i].data.number - 4;
+
+    if((pos < ctx->tt->cur->data_start) ||
+       ((ctx->input->total_bytes > 0) && (pos >= ctx->input->total_bytes)) ||
+       (ctx->si->num_entries &&
+        (pos <= ctx->si->entries[ctx->si->num_entries-1].position)))
+      goto fail;
+    
+    if(!read_tag_header(ctx->input, pos, &prev_size, &t, &flags, &pts) ||
+       (t.type != VIDEO_ID) ||
+       ((flags >> 4) != 1) ||
+       (fabs(times->data.array.elements[i].data.number * 1000.0 - t.timestamp) >
+        INDEX_TIME_TOLERANCE))
+      goto fail;
+    
+    index_add_tag(ctx, pos, &t, flags, pts);
+
+    if(!have_audio)
+      continue;
+    
+    /* Audio tag following the keyframe */
+    
+    if(i < num - 1)
+      next_pos = (int64_t)filepositions->data.array.elements[i+1].data.number - 4;
+    else
+      next_pos = -1;
+
+    for(j = 0; j < INDEX_MAX_AUDIO_SEARCH; j++)
+      {
+      pos += 15 + t.data_size;
+
+      if((next_pos >= 0) && (pos >= next_pos))
+        break;
+      
+      if(!read_tag_header(ctx->input, pos, &prev_size, &t, &flags, &pts))
+        break;
+
+      if(t.type == AUDIO_ID)
+        {
+        index_add_tag(ctx, pos, &t, flags, pts);
+        break;
+        }
+      }
+    }
+
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Using keyframe index from metadata (%d entries)",
+           num);
+  return 1;
+
+  fail:
+
+  gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Keyframe index from metadata is invalid");
+  gavl_packet_index_destroy(ctx->si);
+  ctx->si = NULL;
+  return 0;
+  }
+
+static int index_from_tags(bgav_demuxer_context_t * ctx)
+  {
+  int64_t pos;
+  uint32_t prev_size;
+  uint32_t last_size = 0;
+  uint8_t flags;
+  int64_t pts;
+  flv_tag t;
+  
+  ctx->si = gavl_packet_index_create(0);
   
-  /* Search index position */
-  time_float = gavl_time_to_seconds(gavl_time_unscale(scale, time));
-  for(i = times->data.array.num_elements-1; i >= 0; i--)
+  pos = ctx->tt->cur->data_start;
+
+  while((ctx->input->total_bytes <= 0) ||
+        (pos + 15 <= ctx->input->total_bytes))
     {
-    if(times->data.array.elements[i].data.number < time_float)
+    if(!read_tag_header(ctx->input, pos, &prev_size, &t, &flags, &pts))
+      break;
+
+    /* Check the back link */
+    if(last_size && (prev_size != last_size))
+      {
+      gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+               "Broken tag chain at position %"PRId64", index is incomplete", pos);
+      break;
+      }
+    
+    /* Truncated file */
+    if((ctx->input->total_bytes > 0) &&
+       (pos + 15 + t.data_size > ctx->input->total_bytes))
       break;
+    
+    index_add_tag(ctx, pos, &t, flags, pts);
+    
+    last_size = t.data_size + 11;
+    pos += 15 + t.data_size;
+    }
+
+  if(!ctx->si->num_entries)
+    {
+    gavl_packet_index_destroy(ctx->si);
+    ctx->si = NULL;
+    return 0;
     }
+
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Built index from tag headers (%d entries)",
+           ctx->si->num_entries);
+  return 1;
+  }
+
+static void load_si_flv(bgav_demuxer_context_t * ctx)
+  {
+  flv_priv_t * priv = ctx->priv;
+
+  /* Try only once */
+  if(!priv->load_si)
+    return;
+  priv->load_si = 0;
   
-  /* Seek to position */
-  file_pos = (int64_t)(filepositions->data.array.elements[i].data.number)-4;
-  bgav_input_seek(ctx->input, file_pos, SEEK_SET);
+  if(!(priv->have_metadata && index_from_metadata(ctx)))
+    index_from_tags(ctx);
 
+  if(ctx->si)
+    ctx->si->flags |= GAVL_PACKET_INDEX_SPARSE;
+  
+  bgav_input_seek(ctx->input, ctx->tt->cur->data_start, SEEK_SET);
   }
-     
 
 static int open_flv(bgav_demuxer_context_t * ctx)
   {
@@ -972,6 +1184,21 @@ static int open_flv(bgav_demuxer_context_t * ctx)
       }
     bgav_input_seek(ctx->input, pos, SEEK_SET);
     }
+
+  /*
+   *  Sample accurate seeking and building the packet index
+   *  use the complete (cached) packet index instead. Scanning the
+   *  tags of a slow input takes too long and opening for a scan
+   *  never seeks.
+   */
+  if((ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) &&
+     !(ctx->input->flags & BGAV_INPUT_SEEK_SLOW) &&
+     !bgav_options_get_bool(ctx->opt, BGAV_OPT_SAMPLE_ACCURATE) &&
+     !(ctx->b && (ctx->b->flags & (BGAV_FLAG_BUILD_INDEX | BGAV_FLAG_SCAN))))
+    {
+    priv->load_si = 1;
+    ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    }
   
   bgav_track_set_format(ctx->tt->cur, "FLV", "video/x-flv");
 
@@ -1017,7 +1244,7 @@ const bgav_demuxer_t bgav_demuxer_flv =
     .probe       = probe_flv,
     .open        = open_flv,
     .next_packet = next_packet_flv,
-    .seek        = seek_flv,
+    .load_si     = load_si_flv,
     .close       = close_flv
   };
 
@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
 
 // #include <yuv4mpeg.h>
 
@@ -34,10 +36,208 @@
 
 #define PROBE_LEN 12
 
+#define SEQUENCE_TIMESCALE_DEFAULT      25
+#define SEQUENCE_FRAME_DURATION_DEFAULT 1
+
+/*
+ *  Image sequences: Locations like shot_%05d.png (or shot_%d.png) are
+ *  numbered images in one directory. The input opens the first file (see
+ *  bgav_image_sequence_first_file()) so we can probe it, all further
+ *  frames are read by the demuxer.
+ */
+
+typedef struct
+  {
+  char * dir;     /* Directory to scan         */
+  char * prefix;  /* Filename before the number */
+  char * suffix;  /* Filename after the number  */
+  int width;      /* Number is padded with zeros to this width */
+
+  int64_t first;
+  int64_t last;
+  int64_t num_files;
+  } sequence_t;
+
 typedef struct
   {
+  sequence_t seq;
+  int64_t cur;     /* Next frame to read */
+  int is_sequence;
   } image_t;
 
+static int sequence_parse(sequence_t * seq, const char * pattern)
+  {
+  const char * start;
+  const char * pos;
+  const char * slash;
+
+  /* Exactly one conversion in the filename */
+  if(!(start = strchr(pattern, '%')) ||
+     ((slash = strrchr(pattern, '/')) && (slash > start)))
+    return 0;
+
+  pos = start + 1;
+  seq->width = 0;
+
+  if(*pos == '0')
+    {
+    pos++;
+    if(!isdigit(*pos))
+      return 0;
+    while(isdigit(*pos))
+      {
+      seq->width = seq->width * 10 + (*pos - '0');
+      pos++;
+      }
+    }
+
+  if((*pos != 'd') || strchr(pos, '%'))
+    return 0;
+  pos++;
+
+  seq->prefix = gavl_strndup(pattern, start);
+  seq->suffix = gavl_strdup(pos);
+
+  if(!slash)
+    seq->dir = gavl_strdup(".");
+  else if(slash == pattern)
+    seq->dir = gavl_strdup("/");
+  else
+    seq->dir = gavl_strndup(pattern, slash);
+  return 1;
+  }
+
+static int sequence_scan(sequence_t * seq)
+  {
+  DIR * dir;
+  struct dirent * e;
+  const char * prefix;
+  const char * num;
+  int prefix_len, suffix_len, len, digits, i;
+  int64_t idx;
+
+  if((prefix = strrchr(seq->prefix, '/')))
+    prefix++;
+  else
+    prefix = seq->prefix;
+
+  prefix_len = strlen(prefix);
+  suffix_len = strlen(seq->suffix);
+
+  if(!(dir = opendir(seq->dir)))
+    return 0;
+
+  seq->num_files = 0;
+
+  while((e = readdir(dir)))
+    {
+    len = strlen(e->d_name);
+
+    if((len <= prefix_len + suffix_len) ||
+       strncmp(e->d_name, prefix, prefix_len) ||
+       strcmp(e->d_name + len - suffix_len, seq->suffix))
+      continue;
+
+    num = e->d_name + prefix_len;
+    digits = len - prefix_len - suffix_len;
+
+    /* Leading zeros only as padding */
+    if((digits > 1) && (num[0] == '0') && (digits != seq->width))
+      continue;
+    if(digits < seq->width)
+      continue;
+
+    idx = 0;
+    for(i = 0; i < digits; i++)
+      {
+      if(!isdigit(num[i]))
+        break;
+      idx = idx * 10 + (num[i] - '0');
+      }
+    if(i < digits)
+      continue;
+
+    if(!seq->num_files || (idx < seq->first))
+      seq->first = idx;
+    if(!seq->num_files || (idx > seq->last))
+      seq->last = idx;
+    seq->num_files++;
+    }
+  closedir(dir);
+  return (seq->num_files > 0);
+  }
+
+static char * sequence_filename(const sequence_t * seq, int64_t idx)
+  {
+  return gavl_sprintf("%s%0*"PRId64"%s", seq->prefix, seq->width, idx, seq->suffix);
+  }
+
+static void sequence_free(sequence_t * seq)
+  {
+  if(seq->dir)
+    free(seq->dir);
+  if(seq->prefix)
+    free(seq->prefix);
+  if(seq->suffix)
+    free(seq->suffix);
+  memset(seq, 0, sizeof(*seq));
+  }
+
+static int sequence_init(sequence_t * seq, const char * pattern)
+  {
+  /* Existing files are never patterns */
+  if(!access(pattern, F_OK) ||
+     !sequence_parse(seq, pattern))
+    return 0;
+
+  if(!sequence_scan(seq))
+    {
+    sequence_free(seq);
+    return 0;
+    }
+  return 1;
+  }
+
+char * bgav_image_sequence_first_file(const char * pattern)
+  {
+  char * ret;
+  sequence_t seq;
+  memset(&seq, 0, sizeof(seq));
+
+  if(!sequence_init(&seq, pattern))
+    return NULL;
+
+  ret = sequence_filename(&seq, seq.first);
+  sequence_free(&seq);
+  return ret;
+  }
+
+static int read_file(const char * filename, bgav_packet_t * p)
+  {
+  FILE * f;
+  int64_t size;
+  int ret = 0;
+
+  if(!(f = fopen(filename, "rb")))
+    return 0;
+
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  if(size > 0)
+    {
+    gavl_packet_alloc(p, size);
+    if(fread(p->buf.buf, 1, size, f) == size)
+      {
+      p->buf.len = size;
+      ret = 1;
+      }
+    }
+  fclose(f);
+  return ret;
+  }
+
 static const uint8_t png_sig[] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
 
 static int is_png(const uint8_t * data)
@@ -104,10 +304,59 @@ static int probe_image(bgav_input_context_t * input)
   return 0;
   }
 
+static void init_sequence(bgav_demuxer_context_t * ctx, bgav_stream_t * s)
+  {
+  image_t * priv = ctx->priv;
+  int timescale = SEQUENCE_TIMESCALE_DEFAULT;
+  int frame_duration = SEQUENCE_FRAME_DURATION_DEFAULT;
+  int64_t num_frames;
+  
+  gavl_dictionary_get_int(ctx->opt, BGAV_OPT_IMAGE_SEQUENCE_TIMESCALE, &timescale);
+  gavl_dictionary_get_int(ctx->opt, BGAV_OPT_IMAGE_SEQUENCE_FRAME_DURATION, &frame_duration);
+
+  if((timescale <= 0) || (frame_duration <= 0))
+    {
+    timescale = SEQUENCE_TIMESCALE_DEFAULT;
+    frame_duration = SEQUENCE_FRAME_DURATION_DEFAULT;
+    }
+  
+  num_frames = priv->seq.last - priv->seq.first + 1;
+
+  if(priv->seq.num_files < num_frames)
+    gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+             "Image sequence has %"PRId64" missing frames",
+             num_frames - priv->seq.num_files);
+
+  gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Image sequence: frames %"PRId64" - %"PRId64,
+           priv->seq.first, priv->seq.last);
+  
+  s->data.video.format->timescale = timescale;
+  s->data.video.format->frame_duration = frame_duration;
+  s->data.video.format->framerate_mode = GAVL_FRAMERATE_CONSTANT;
+
+  s->stats.pts_start = 0;
+  s->stats.pts_end = num_frames * frame_duration;
+  
+  priv->cur = priv->seq.first;
+  
+  ctx->flags |= (BGAV_DEMUXER_CAN_SEEK|BGAV_DEMUXER_SAMPLE_ACCURATE);
+  }
+
 static int open_image(bgav_demuxer_context_t * ctx)
   {
   uint8_t probe_data[PROBE_LEN];
   bgav_stream_t * s;
+  image_t * priv;
+  const char * location = NULL;
+  const char * format = NULL;
+  const char * mimetype = NULL;
+  
+  priv = calloc(1, sizeof(*priv));
+  ctx->priv = priv;
+  
+  if(gavl_metadata_get_src(&ctx->input->m, GAVL_META_SRC, 0, NULL, &location) &&
+     location && sequence_init(&priv->seq, location))
+    priv->is_sequence = 1;
   
   /* Create track table */
 
@@ -122,44 +371,101 @@ static int open_image(bgav_demuxer_context_t * ctx)
   if(is_png(probe_data))
     {
     s->fourcc = BGAV_MK_FOURCC('p', 'n', 'g', ' ');
-    bgav_track_set_format(ctx->tt->cur, "PNG image", "image/png");
+    format = priv->is_sequence ? "PNG image sequence" : "PNG image";
+    mimetype = "image/png";
     s->ci->id = GAVL_CODEC_ID_PNG;
     }
   else if(is_tiff(probe_data))
     {
     s->fourcc = BGAV_MK_FOURCC('t', 'i', 'f', 'f');
-    bgav_track_set_format(ctx->tt->cur, "TIFF image", "image/tiff");
+    format = priv->is_sequence ? "TIFF image sequence" : "TIFF image";
+    mimetype = "image/tiff";
     s->ci->id = GAVL_CODEC_ID_TIFF;
     }
   else if(is_jpeg(probe_data))
     {
     s->fourcc = BGAV_MK_FOURCC('j', 'p', 'e', 'g');    
-    bgav_track_set_format(ctx->tt->cur, "JPEG image", "image/jpeg");
+    format = priv->is_sequence ? "JPEG image sequence" : "JPEG image";
+    mimetype = "image/jpeg";
     s->ci->id = GAVL_CODEC_ID_JPEG;
     }
-  
-  s->data.video.format->timescale = 1000; // Actually arbitrary since we only have pts = 0
-  s->data.video.format->frame_duration = 0;
-  s->data.video.format->framerate_mode = GAVL_FRAMERATE_STILL;
+
+  if(format)
+    bgav_track_set_format(ctx->tt->cur, format, mimetype);
+
+  if(priv->is_sequence)
+    init_sequence(ctx, s);
+  else
+    {
+    s->data.video.format->timescale = 1000; // Actually arbitrary since we only have pts = 0
+    s->data.video.format->frame_duration = 0;
+    s->data.video.format->framerate_mode = GAVL_FRAMERATE_STILL;
+
+    s->stats.size_max = ctx->input->total_bytes;
+    s->stats.size_min = ctx->input->total_bytes;
+    
+    /* Seeking is done by the generic code */
+    ctx->flags |= BGAV_DEMUXER_SEEK_ITERATIVE;
+    ctx->index_mode = INDEX_MODE_SIMPLE;
+    }
   
   s->timescale = s->data.video.format->timescale;
   s->data.video.format->pixel_width  = 1;
   s->data.video.format->pixel_height = 1;  
   
   s->ci->flags &= ~(GAVL_COMPRESSION_HAS_B_FRAMES | GAVL_COMPRESSION_HAS_P_FRAMES);
-
-  s->stats.size_max = ctx->input->total_bytes;
-  s->stats.size_min = ctx->input->total_bytes;
   
-  ctx->index_mode = INDEX_MODE_SIMPLE;
   return 1;
   }
 
+static gavl_source_status_t next_packet_sequence(bgav_demuxer_context_t * ctx)
+  {
+  bgav_packet_t * p;
+  bgav_stream_t * s;
+  char * filename;
+  int result;
+  image_t * priv = ctx->priv;
+  
+  s = bgav_track_get_video_stream(ctx->tt->cur, 0);
+  p = bgav_stream_get_packet_write(s);
+  
+  while(1)
+    {
+    if(priv->cur > priv->seq.last)
+      return GAVL_SOURCE_EOF;
+
+    filename = sequence_filename(&priv->seq, priv->cur);
+    result = read_file(filename, p);
+
+    if(!result)
+      gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Skipping %s (cannot read file)", filename);
+    free(filename);
+
+    if(result)
+      break;
+    priv->cur++;
+    }
+
+  p->position = priv->cur;
+  p->pts = (priv->cur - priv->seq.first) * s->data.video.format->frame_duration;
+  p->duration = s->data.video.format->frame_duration;
+  PACKET_SET_KEYFRAME(p);
+  
+  priv->cur++;
+  
+  bgav_stream_done_packet_write(s, p);
+  return GAVL_SOURCE_OK;
+  }
+
 
 static gavl_source_status_t next_packet_image(bgav_demuxer_context_t * ctx)
   {
   bgav_packet_t * p;
   bgav_stream_t * s;
+  image_t * priv = ctx->priv;
+
+  if(priv->is_sequence)
+    return next_packet_sequence(ctx);
   
   s = bgav_track_get_video_stream(ctx->tt->cur, 0);
   
@@ -181,8 +487,37 @@ static gavl_source_status_t next_packet_image(bgav_demuxer_context_t * ctx)
   return GAVL_SOURCE_OK;
   }
 
+/* Called for sequences only, single images seek iteratively */
+
+static void seek_image(bgav_demuxer_context_t * ctx, int64_t time, int scale)
+  {
+  bgav_stream_t * s;
+  int64_t frame;
+  image_t * priv = ctx->priv;
+  
+  s = bgav_track_get_video_stream(ctx->tt->cur, 0);
+
+  frame = gavl_time_rescale(scale, s->data.video.format->timescale, time) /
+    s->data.video.format->frame_duration;
+
+  if(frame > priv->seq.last - priv->seq.first)
+    frame = priv->seq.last - priv->seq.first;
+  if(frame < 0)
+    frame = 0;
+  
+  priv->cur = priv->seq.first + frame;
+  STREAM_SET_SYNC(s, frame * s->data.video.format->frame_duration);
+  }
+
 static void close_image(bgav_demuxer_context_t * ctx)
   {
+  image_t * priv = ctx->priv;
+
+  if(!priv)
+    return;
+  
+  sequence_free(&priv->seq);
+  free(priv);
   }
 
 const bgav_demuxer_t bgav_demuxer_image =
@@ -190,5 +525,6 @@ const bgav_demuxer_t bgav_demuxer_image =
     .probe        = probe_image,
     .open         = open_image,
     .next_packet = next_packet_image,
+    .seek =        seek_image,
     .close =       close_image
   };
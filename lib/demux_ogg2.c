@@ -67,6 +67,9 @@ typedef struct
   gavl_dictionary_t m;
 
   int flags;
+
+  /* Theora only */
+  int granule_shift;
   
   }  ogg_stream_t;
 
@@ -618,25 +621,25 @@ static void sync_streams(bgav_demuxer_context_t * ctx, int64_t t)
 
 static int post_seek_resync_ogg(bgav_demuxer_context_t * ctx)
   {
-  int i;
   int64_t position;
+  int64_t end_pos;
   bgav_ogg_page_t ph;
-
+  
   sync_streams(ctx, GAVL_TIME_UNDEFINED);
   
   /* We don't bother calculating CRC. Instead we check for the "OggS" pattern where we expect
      it */
+
+  end_pos = ctx->input->position + MAX_PAGE_BYTES;
+  if(end_pos > ctx->input->total_bytes)
+    end_pos = ctx->input->total_bytes;
   
-  for(i = 0; i < MAX_PAGE_BYTES; i++)
+  while(1)
     {
-    if(ctx->input->position >= ctx->input->total_bytes - MIN_HEADER_BYTES)
+    if(!bgav_ogg_find_page(ctx->input, end_pos) ||
+       (ctx->input->position >= ctx->input->total_bytes - MIN_HEADER_BYTES))
       return 0;
     
-    if(!bgav_ogg_probe(ctx->input))
-      {
-      bgav_input_skip(ctx->input, 1);
-      continue;
-      }
     position = ctx->input->position;
     
     /* Check for next page */
@@ -662,6 +665,186 @@ static int post_seek_resync_ogg(bgav_demuxer_context_t * ctx)
   return 0;
   }
 
+/*
+ *  Seeking: Bisection on the granulepos of the pages. Only the page headers
+ *  are read, the page contents are skipped. All pages found on the way are
+ *  remembered in the seek map of the track, so later seeks start with a
+ *  narrower interval.
+ */
+
+/* Start a bit before the seek point so all streams have data before it */
+#define SEEK_PREROLL (GAVL_TIME_SCALE/2)
+
+static gavl_time_t granulepos_2_time(bgav_stream_t * s, int64_t granulepos,
+                                     int keyframe)
+  {
+  int64_t frames;
+  ogg_stream_t * sp = s->priv;
+
+  if(granulepos < 0)
+    return GAVL_TIME_UNDEFINED;
+  
+  switch(sp->fourcc)
+    {
+    case FOURCC_VORBIS:
+    case FOURCC_FLAC:
+    case FOURCC_FLAC_NEW:
+    case FOURCC_SPEEX:
+      if(!s->data.audio.format->samplerate)
+        return GAVL_TIME_UNDEFINED;
+      return gavl_time_unscale(s->data.audio.format->samplerate, granulepos);
+    case FOURCC_OPUS:
+      return gavl_time_unscale(48000, granulepos);
+    case FOURCC_THEORA:
+      if(!s->data.video.format->timescale || !s->data.video.format->frame_duration)
+        return GAVL_TIME_UNDEFINED;
+      frames = granulepos >> sp->granule_shift;
+      if(!keyframe)
+        frames += granulepos - (frames << sp->granule_shift);
+      return gavl_frames_to_time(s->data.video.format->timescale,
+                                 s->data.video.format->frame_duration,
+                                 frames);
+    }
+  return GAVL_TIME_UNDEFINED;
+  }
+
+/*
+ *  Read page headers until a page of an audio- or video stream with a
+ *  valid granulepos is found. Returns the file position of the page or -1.
+ *  If video is nonzero, only theora pages are considered and the time of
+ *  the last keyframe is returned.
+ */
+
+static int64_t next_timed_page(bgav_demuxer_context_t * ctx, int64_t end_pos,
+                               int video, gavl_time_t * time)
+  {
+  bgav_ogg_page_t ph;
+  bgav_stream_t * s;
+  ogg_stream_t * sp;
+  
+  while(bgav_ogg_find_page(ctx->input, end_pos))
+    {
+    if(!bgav_ogg_page_read_header(ctx->input, &ph))
+      return -1;
+
+    /* False capture pattern */
+    if(ph.stream_structure_version)
+      {
+      bgav_input_seek(ctx->input, ph.position + 1, SEEK_SET);
+      continue;
+      }
+
+    bgav_ogg_page_skip(ctx->input, &ph);
+    
+    if((ph.granulepos < 1) ||
+       !(s = bgav_track_find_stream(ctx, ph.serialno)))
+      continue;
+
+    sp = s->priv;
+    
+    if(video)
+      {
+      if(sp->fourcc != FOURCC_THEORA)
+        continue;
+      }
+    else if((s->type != GAVL_STREAM_AUDIO) && (s->type != GAVL_STREAM_VIDEO))
+      continue;
+
+    if((*time = granulepos_2_time(s, ph.granulepos, video)) == GAVL_TIME_UNDEFINED)
+      continue;
+    
+    if(!video)
+      bgav_seek_map_add(ctx->tt->cur, ph.position, *time);
+    
+    return ph.position;
+    }
+  return -1;
+  }
+
+/* Find the last page starting before goal */
+
+static int64_t bisect_granulepos(bgav_demuxer_context_t * ctx, gavl_time_t goal)
+  {
+  int i;
+  int64_t lo, hi, mid, pos;
+  gavl_time_t page_time;
+  bgav_track_t * t = ctx->tt->cur;
+  
+  lo = t->data_start;
+  hi = (t->data_end > 0) ? t->data_end : ctx->input->total_bytes;
+
+  /* The seek map is sorted by position */
+  for(i = 0; i < t->num_seek_points; i++)
+    {
+    if(t->seek_points[i].time < goal)
+      lo = t->seek_points[i].position;
+    else
+      {
+      hi = t->seek_points[i].position;
+      break;
+      }
+    }
+  
+  while(hi - lo > MAX_PAGE_BYTES)
+    {
+    mid = lo + (hi - lo) / 2;
+    bgav_input_seek(ctx->input, mid, SEEK_SET);
+    
+    if(((pos = next_timed_page(ctx, hi, 0, &page_time)) < 0) ||
+       (page_time >= goal))
+      hi = mid;
+    else
+      lo = pos;
+    }
+
+  /* Walk through the remaining pages */
+  bgav_input_seek(ctx->input, lo, SEEK_SET);
+
+  while((pos = next_timed_page(ctx, hi, 0, &page_time)) >= 0)
+    {
+    if(page_time >= goal)
+      break;
+    lo = pos;
+    }
+  
+  return lo;
+  }
+
+static void seek_ogg(bgav_demuxer_context_t * ctx, int64_t time, int scale)
+  {
+  int64_t pos;
+  gavl_time_t goal;
+  gavl_time_t key_time;
+  
+  goal = gavl_time_unscale(scale, time) - SEEK_PREROLL;
+  
+  if(goal <= 0)
+    pos = ctx->tt->cur->data_start;
+  else
+    {
+    pos = bisect_granulepos(ctx, goal);
+
+    /* For theora we need to start before the keyframe */
+    if(ctx->tt->cur->num_video_streams)
+      {
+      bgav_input_seek(ctx->input, pos, SEEK_SET);
+      if((next_timed_page(ctx, ctx->tt->cur->data_end, 1, &key_time) >= 0) &&
+         (key_time < goal))
+        pos = bisect_granulepos(ctx, key_time);
+      }
+    }
+  
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Seek %f: Page position %"PRId64,
+           gavl_time_to_seconds(gavl_time_unscale(scale, time)), pos);
+  
+  bgav_input_seek(ctx->input, pos, SEEK_SET);
+
+  if(pos == ctx->tt->cur->data_start)
+    sync_streams(ctx, 0);
+  else
+    sync_streams(ctx, GAVL_TIME_UNDEFINED);
+  }
+
 #if 0
 static void close_ogg(bgav_demuxer_context_t * ctx)
   {
@@ -686,6 +869,7 @@ const bgav_demuxer_t bgav_demuxer_ogg2 =
     .probe =        bgav_ogg_probe,
     .open =         open_ogg,
     .next_packet =  next_packet_ogg,
+    .seek =         seek_ogg,
     .post_seek_resync =  post_seek_resync_ogg,
     .select_track = select_track_ogg
   };
@@ -787,6 +971,11 @@ static int stream_append_header_packet(bgav_stream_t * s, const gavl_buffer_t *
     {
     case FOURCC_VORBIS: 
     case FOURCC_THEORA:
+      /* KFGSHIFT from the identification header */
+      if((p->fourcc == FOURCC_THEORA) &&
+         (p->header_packets_read == 1) && (buf->len >= 42))
+        p->granule_shift = ((buf->buf[40] & 0x03) << 3) | (buf->buf[41] >> 5);
+      
       if(p->header_packets_read == 2)
         parse_vorbis_comment(s, buf->buf + 7, buf->len - 7);
       gavl_append_xiph_header(&s->ci->codec_header, buf->buf, buf->len);
@@ -107,6 +107,29 @@ typedef struct
   int samples_per_block;
   } stream_priv_t;
 
+/*
+ *  Windowed superindex: For very long files, we don't keep the whole
+ *  index in memory. Instead, we save the table positions of all streams
+ *  every window_size packets and build the index piecewise.
+ */
+
+#define SI_WINDOW_DEFAULT 65536
+#define SI_WINDOW_MIN     16 /* Minimum number of windows */
+#define WINDOW_CACHE      4
+
+typedef struct
+  {
+  int packet;              /* Packet number at the window start */
+  stream_priv_t * streams; /* Table positions at the window start */
+  } qt_checkpoint_t;
+
+typedef struct
+  {
+  int index;               /* Checkpoint index */
+  int64_t last_used;
+  gavl_packet_index_t * si;
+  } qt_window_t;
+
 typedef struct
   {
   gavl_dictionary_t m_emsg;
@@ -135,6 +158,17 @@ typedef struct
 
   qt_moof_t current_moof;
   qt_mdat_t fragment_mdat;
+
+  /* Windowed superindex for very long files */
+  int num_packets;
+  int window_size;
+  
+  int num_checkpoints;
+  qt_checkpoint_t * checkpoints;
+
+  qt_window_t windows[WINDOW_CACHE];
+  int64_t window_counter;
+  int cur_window; /* Last window in ctx->si */
   } qt_priv_t;
 
 static void bgav_qt_moof_to_superindex(bgav_demuxer_context_t * ctx,
@@ -359,7 +393,7 @@ static int check_keyframe(stream_priv_t * s)
   return ret;
   }
 
-static void add_packet(bgav_demuxer_context_t * ctx,
+static void add_packet(gavl_packet_index_t * si,
                        qt_priv_t * priv,
                        bgav_stream_t * s,
                        int64_t offset,
@@ -369,9 +403,28 @@ static void add_packet(bgav_demuxer_context_t * ctx,
                        int duration,
                        int chunk_size)
   {
-  if(stream_id >= 0)
-    gavl_packet_index_add(ctx->si, offset, chunk_size,
-                          stream_id, timestamp, keyframe ? GAVL_PACKET_KEYFRAME : 0, duration);
+  if(stream_id < 0)
+    return;
+
+  if(!si)
+    {
+    /* Dry run for the windowed index: Just collect the stream stats */
+    gavl_packet_t p;
+
+    if(!s)
+      return;
+    
+    gavl_packet_init(&p);
+    p.pts = timestamp;
+    p.duration = duration;
+    p.buf.len = chunk_size;
+    p.flags = keyframe ? GAVL_PACKET_KEYFRAME : 0;
+    gavl_stream_stats_update(&s->stats, &p);
+    return;
+    }
+  
+  gavl_packet_index_add(si, offset, chunk_size,
+                        stream_id, timestamp, keyframe ? GAVL_PACKET_KEYFRAME : 0, duration);
 
 #if 0
   if(index && !ctx->si->entries[index-1].size)
@@ -447,31 +500,14 @@ static void build_index_fragmented(bgav_demuxer_context_t * ctx)
     }
   }
 
-static void build_index(bgav_demuxer_context_t * ctx)
+/* Count the total number of packets */
+
+static int count_packets(qt_priv_t * priv)
   {
-  int i, j;
-  int stream_id = 0;
-  int64_t chunk_offset;
-  int64_t * chunk_indices;
-  stream_priv_t * s;
-  qt_priv_t * priv;
+  int i;
   int num_packets = 0;
-  bgav_stream_t * bgav_s;
-  int chunk_samples;
-  int packet_size;
-  int duration;
   qt_trak_t * trak;
-  int pts_offset;
-  int done = 0;
-  priv = ctx->priv;
   
-  if(priv->fragmented)
-    {
-    build_index_fragmented(ctx);
-    return;
-    }
-
-  /* 1 step: Count the total number of chunks */
   for(i = 0; i < priv->moov.num_tracks; i++)
     {
     trak = &priv->moov.tracks[i];
@@ -505,22 +541,23 @@ static void build_index(bgav_demuxer_context_t * ctx)
       num_packets += bgav_qt_trak_chunks(&priv->moov.tracks[i]);
       }
     }
-  if(!num_packets)
-    {
-    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "No packets in movie");
-    return;
-    }
-  ctx->si = gavl_packet_index_create(num_packets);
-  
-  chunk_indices = calloc(priv->moov.num_tracks, sizeof(*chunk_indices));
+  return num_packets;
+  }
 
+/* Initialize the table positions before building the index */
+
+static void init_packets(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  stream_priv_t * s;
+  bgav_stream_t * bgav_s;
+  qt_priv_t * priv = ctx->priv;
+  
   /* Skip empty mdats */
 
   while(!priv->mdats[priv->current_mdat].size)
     priv->current_mdat++;
   
-  i = 0;
-
   /* Set the dts of the streams */
   for(i = 0; i < ctx->tt->cur->num_streams; i++)
     {
@@ -532,8 +569,32 @@ static void build_index(bgav_demuxer_context_t * ctx)
 
     //    fprintf(stderr, "Stream: %d, dts: %"PRId64"\n", i, s->dts);
     }
+  }
+
+/*
+ *  Add the packets starting with packet number i until the
+ *  packet number end is reached. The table positions are taken
+ *  from and saved to the stream_priv_t structures. If si is NULL,
+ *  only the stream stats are updated. Returns the next packet number.
+ */
+
+static int build_packets(bgav_demuxer_context_t * ctx,
+                         gavl_packet_index_t * si, int i, int end)
+  {
+  int j;
+  int stream_id = 0;
+  int64_t chunk_offset;
+  stream_priv_t * s;
+  qt_priv_t * priv;
+  bgav_stream_t * bgav_s;
+  int chunk_samples;
+  int packet_size;
+  int duration;
+  int pts_offset;
+  int done = 0;
+  priv = ctx->priv;
   
-  while(i < num_packets)
+  while((i < priv->num_packets) && (i < end))
     {
     /* Find the stream with the lowest chunk offset */
 
@@ -550,8 +611,9 @@ static void build_index(bgav_demuxer_context_t * ctx)
         }
       }
     
-    //    if(j == priv->moov.num_tracks)
-    //      return;
+    /* All chunks are done */
+    if(chunk_offset == 9223372036854775807LL)
+      return priv->num_packets;
     
     bgav_s = bgav_track_find_stream_all(ctx->tt->cur, stream_id);
 
@@ -589,7 +651,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
             s->stbl->stts.entries[s->stts_pos].duration :
             s->stbl->stts.entries[0].duration;
 
-          add_packet(ctx,
+          add_packet(si,
                      priv,
                      bgav_s,
                      chunk_offset,
@@ -635,7 +697,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
           {
           packet_size = chunk_samples * bgav_s->ci->block_align;
         
-          add_packet(ctx,
+          add_packet(si,
                      priv,
                      bgav_s,
                      chunk_offset,
@@ -651,7 +713,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
 
           for(k = 0; k < num_blocks; k++)
             {
-            add_packet(ctx,
+            add_packet(si,
                        priv,
                        bgav_s,
                        chunk_offset + k * bgav_s->ci->block_align,
@@ -724,7 +786,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
            (s->skip_last_frame &&
             (s->stco_pos == s->stbl->stco.num_entries)))
           {
-          add_packet(ctx,
+          add_packet(si,
                      priv,
                      bgav_s,
                      chunk_offset,
@@ -736,7 +798,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
           }
         else
           {
-          add_packet(ctx,
+          add_packet(si,
                      priv,
                      bgav_s,
                      chunk_offset,
@@ -798,7 +860,7 @@ static void build_index(bgav_demuxer_context_t * ctx)
           duration = s->stbl->stts.entries[0].duration;
 
         
-        add_packet(ctx,
+        add_packet(si,
                    priv,
                    bgav_s,
                    chunk_offset,
@@ -834,14 +896,246 @@ static void build_index(bgav_demuxer_context_t * ctx)
     else
       {
       /* Fill in dummy packet */
-      add_packet(ctx, priv, NULL, chunk_offset, stream_id, -1, 0, 0, 0);
+      add_packet(si, priv, NULL, chunk_offset, stream_id, -1, 0, 0, 0);
       i++;
       priv->streams[stream_id].stco_pos++;
       }
     if(done)
+      return priv->num_packets;
+    }
+  return i;
+  }
+
+/* Check whether the chunks of different streams are in separate file regions */
+
+static int is_noninterleaved(bgav_demuxer_context_t * ctx)
+  {
+  int i, j;
+  qt_stco_t * stco_i;
+  qt_stco_t * stco_j;
+  qt_priv_t * priv = ctx->priv;
+  
+  for(i = 0; i < priv->moov.num_tracks; i++)
+    {
+    stco_i = &priv->moov.tracks[i].mdia.minf.stbl.stco;
+    
+    if(!stco_i->num_entries || !bgav_track_find_stream_all(ctx->tt->cur, i))
+      continue;
+
+    for(j = i+1; j < priv->moov.num_tracks; j++)
+      {
+      stco_j = &priv->moov.tracks[j].mdia.minf.stbl.stco;
+      
+      if(!stco_j->num_entries || !bgav_track_find_stream_all(ctx->tt->cur, j))
+        continue;
+
+      if((stco_i->entries[stco_i->num_entries-1] < stco_j->entries[0]) ||
+         (stco_j->entries[stco_j->num_entries-1] < stco_i->entries[0]))
+        return 1;
+      }
+    }
+  return 0;
+  }
+
+/* Walk through the tables once and save the positions at the window starts */
+
+static void build_checkpoints(bgav_demuxer_context_t * ctx)
+  {
+  int i = 0;
+  int checkpoints_alloc = 0;
+  qt_checkpoint_t * cp;
+  qt_priv_t * priv = ctx->priv;
+  
+  while(i < priv->num_packets)
+    {
+    if(priv->num_checkpoints >= checkpoints_alloc)
+      {
+      checkpoints_alloc += 64;
+      priv->checkpoints = realloc(priv->checkpoints,
+                                  checkpoints_alloc * sizeof(*priv->checkpoints));
+      }
+    cp = priv->checkpoints + priv->num_checkpoints;
+    
+    cp->packet = i;
+    cp->streams = malloc(priv->moov.num_tracks * sizeof(*cp->streams));
+    memcpy(cp->streams, priv->streams, priv->moov.num_tracks * sizeof(*cp->streams));
+    priv->num_checkpoints++;
+    
+    i = build_packets(ctx, NULL, i, i + priv->window_size);
+    }
+
+  gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Using windowed index: %d packets in %d windows",
+           priv->num_packets, priv->num_checkpoints);
+  }
+
+/* Get a window from the cache or build it */
+
+static gavl_packet_index_t * get_window(bgav_demuxer_context_t * ctx, int index)
+  {
+  int i;
+  int end;
+  qt_window_t * w;
+  qt_priv_t * priv = ctx->priv;
+
+  priv->window_counter++;
+
+  for(i = 0; i < WINDOW_CACHE; i++)
+    {
+    if(priv->windows[i].si && (priv->windows[i].index == index))
+      {
+      priv->windows[i].last_used = priv->window_counter;
+      return priv->windows[i].si;
+      }
+    }
+
+  /* Replace the least recently used one */
+  w = &priv->windows[0];
+  
+  for(i = 1; i < WINDOW_CACHE; i++)
+    {
+    if(priv->windows[i].last_used < w->last_used)
+      w = &priv->windows[i];
+    }
+
+  if(w->si)
+    gavl_packet_index_clear(w->si);
+  else
+    w->si = gavl_packet_index_create(priv->window_size);
+
+  if(index < priv->num_checkpoints - 1)
+    end = priv->checkpoints[index+1].packet;
+  else
+    end = priv->num_packets;
+  
+  memcpy(priv->streams, priv->checkpoints[index].streams,
+         priv->moov.num_tracks * sizeof(*priv->streams));
+  
+  build_packets(ctx, w->si, priv->checkpoints[index].packet, end);
+  
+  w->index = index;
+  w->last_used = priv->window_counter;
+  return w->si;
+  }
+
+/* Make ctx->si contain the windows from first to last */
+
+static void load_windows(bgav_demuxer_context_t * ctx, int first, int last)
+  {
+  int i, j;
+  gavl_packet_index_t * w;
+  qt_priv_t * priv = ctx->priv;
+
+  gavl_packet_index_clear(ctx->si);
+  
+  for(i = first; i <= last; i++)
+    {
+    w = get_window(ctx, i);
+
+    for(j = 0; j < w->num_entries; j++)
+      gavl_packet_index_add(ctx->si, w->entries[j].position, w->entries[j].size,
+                            w->entries[j].stream_id, w->entries[j].pts,
+                            w->entries[j].flags, w->entries[j].duration);
+    }
+  
+  priv->cur_window = last;
+  
+  ctx->index_position = 0;
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    ctx->tt->cur->streams[i]->index_position = 0;
+
+  bgav_demuxer_si_window_changed(ctx);
+  }
+
+/* Check if all streams start before time at a checkpoint */
+
+static int checkpoint_before(bgav_demuxer_context_t * ctx,
+                             const qt_checkpoint_t * cp, int64_t time, int scale)
+  {
+  int i;
+  int track;
+  bgav_stream_t * s;
+  qt_priv_t * priv = ctx->priv;
+  
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    {
+    s = ctx->tt->cur->streams[i];
+
+    if((s->action == BGAV_STREAM_MUTE) || !s->priv ||
+       ((s->type != GAVL_STREAM_AUDIO) && (s->type != GAVL_STREAM_VIDEO)))
+      continue;
+
+    track = (stream_priv_t*)s->priv - priv->streams;
+
+    /* Stream finished already */
+    if(cp->streams[track].stco_pos >= cp->streams[track].stbl->stco.num_entries)
+      continue;
+
+    if(gavl_time_rescale(s->timescale, scale, cp->streams[track].dts) > time)
+      return 0;
+    }
+  return 1;
+  }
+
+static void load_si_window_quicktime(bgav_demuxer_context_t * ctx,
+                                     int64_t time, int scale)
+  {
+  int i = 0;
+  qt_priv_t * priv = ctx->priv;
+
+  if(time == GAVL_TIME_UNDEFINED)
+    {
+    load_windows(ctx, 0, 0);
+    return;
+    }
+  
+  for(i = priv->num_checkpoints - 1; i > 0; i--)
+    {
+    if(checkpoint_before(ctx, &priv->checkpoints[i], time, scale))
       break;
     }
-  free(chunk_indices);
+
+  /* Include the neighbouring windows for finding the keyframes */
+  load_windows(ctx, (i > 0) ? i - 1 : 0,
+               (i < priv->num_checkpoints - 1) ? i + 1 : i);
+  }
+
+static void build_index(bgav_demuxer_context_t * ctx)
+  {
+  qt_priv_t * priv;
+  priv = ctx->priv;
+  
+  if(priv->fragmented)
+    {
+    build_index_fragmented(ctx);
+    return;
+    }
+
+  if(!(priv->num_packets = count_packets(priv)))
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "No packets in movie");
+    return;
+    }
+
+  init_packets(ctx);
+
+  priv->window_size = SI_WINDOW_DEFAULT;
+  gavl_dictionary_get_int(ctx->opt, BGAV_OPT_SI_WINDOW, &priv->window_size);
+  
+  if((priv->window_size > 0) &&
+     (priv->num_packets / priv->window_size > SI_WINDOW_MIN) &&
+     (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) &&
+     !is_noninterleaved(ctx))
+    {
+    build_checkpoints(ctx);
+    
+    ctx->si = gavl_packet_index_create(3 * priv->window_size);
+    ctx->flags |= BGAV_DEMUXER_SI_WINDOW;
+    load_windows(ctx, 0, 0);
+    return;
+    }
+  
+  ctx->si = gavl_packet_index_create(priv->num_packets);
+  build_packets(ctx, ctx->si, 0, priv->num_packets);
   }
 
 #define SET_UDTA_STRING(gavl_name, src) \
@@ -1958,6 +2252,25 @@ static void build_edl(bgav_demuxer_context_t * ctx)
   }
 
 
+/* Take the stream durations from the media headers instead of the index */
+
+static void set_scan_durations(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  bgav_stream_t * s;
+  stream_priv_t * sp;
+  
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    {
+    s = ctx->tt->cur->streams[i];
+    
+    if(!(sp = s->priv) || !sp->trak || !sp->trak->mdia.mdhd.duration)
+      continue;
+    
+    s->stats.pts_end = s->stats.pts_start + sp->trak->mdia.mdhd.duration;
+    }
+  }
+
 static int open_quicktime(bgav_demuxer_context_t * ctx)
   {
   qt_atom_header_t h;
@@ -2078,6 +2391,26 @@ static int open_quicktime(bgav_demuxer_context_t * ctx)
   ctx->tt = bgav_track_table_create(1);
   quicktime_init(ctx);
 
+  i = 0;
+
+  while(ftyps[i].format)
+    {
+    if(ftyps[i].fourcc == priv->ftyp_fourcc)
+      {
+      bgav_track_set_format(ctx->tt->cur, ftyps[i].format, ftyps[i].mimetype);
+      break;
+      }
+    
+    i++;
+    }
+
+  /* Scanning: The media headers are enough */
+  if(ctx->b && (ctx->b->flags & BGAV_FLAG_SCAN) && !priv->fragmented)
+    {
+    set_scan_durations(ctx);
+    return 1;
+    }
+  
   /* Build index */
   build_index(ctx);
   
@@ -2086,8 +2419,9 @@ static int open_quicktime(bgav_demuxer_context_t * ctx)
     return 0;
 
   /* Quicktime is almost always sample accurate */
-  
-  ctx->flags |= BGAV_DEMUXER_SAMPLE_ACCURATE;
+
+  if(!(ctx->flags & BGAV_DEMUXER_SI_WINDOW))
+    ctx->flags |= BGAV_DEMUXER_SAMPLE_ACCURATE;
   
   /* Check if we have an EDL */
   if(priv->has_edl)
@@ -2102,20 +2436,6 @@ static int open_quicktime(bgav_demuxer_context_t * ctx)
     }
   else if(ctx->input->position < ctx->si->entries[0].position)
     bgav_input_skip(ctx->input, ctx->si->entries[0].position - ctx->input->position);
-
-  
-  i = 0;
-
-  while(ftyps[i].format)
-    {
-    if(ftyps[i].fourcc == priv->ftyp_fourcc)
-      {
-      bgav_track_set_format(ctx->tt->cur, ftyps[i].format, ftyps[i].mimetype);
-      break;
-      }
-    
-    i++;
-    }
   
   if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
@@ -2128,6 +2448,7 @@ static int open_quicktime(bgav_demuxer_context_t * ctx)
 
 static void close_quicktime(bgav_demuxer_context_t * ctx)
   {
+  int i;
   qt_priv_t * priv;
 
   priv = ctx->priv;
@@ -2137,6 +2458,18 @@ static void close_quicktime(bgav_demuxer_context_t * ctx)
     
   if(priv->mdats)
     free(priv->mdats);
+
+  for(i = 0; i < priv->num_checkpoints; i++)
+    free(priv->checkpoints[i].streams);
+  if(priv->checkpoints)
+    free(priv->checkpoints);
+
+  for(i = 0; i < WINDOW_CACHE; i++)
+    {
+    if(priv->windows[i].si)
+      gavl_packet_index_destroy(priv->windows[i].si);
+    }
+  
   bgav_qt_moov_free(&priv->moov);
   free(ctx->priv);
   }
@@ -2275,6 +2608,21 @@ static gavl_source_status_t next_packet_quicktime(bgav_demuxer_context_t * ctx)
       return bgav_demuxer_next_packet_si(ctx);
       }
     }
+  else if(ctx->flags & BGAV_DEMUXER_SI_WINDOW)
+    {
+    gavl_source_status_t st;
+    
+    while((st = bgav_demuxer_next_packet_si(ctx)) == GAVL_SOURCE_EOF)
+      {
+      /* End of the window: Load the next one */
+      if((ctx->index_position < ctx->si->num_entries) ||
+         (priv->cur_window >= priv->num_checkpoints - 1) ||
+         bgav_track_eof_d(ctx->tt->cur))
+        break;
+      load_windows(ctx, priv->cur_window + 1, priv->cur_window + 1);
+      }
+    return st;
+    }
   else
     {
     return bgav_demuxer_next_packet_si(ctx);
@@ -2287,6 +2635,7 @@ const bgav_demuxer_t bgav_demuxer_quicktime =
     .probe =       probe_quicktime,
     .open =        open_quicktime,
     .next_packet = next_packet_quicktime,
+    .load_si_window = load_si_window_quicktime,
     .close =       close_quicktime
   };
 
@@ -127,17 +127,18 @@ static int open_rawaudio(bgav_demuxer_context_t * ctx)
       break;
     }
 
+  ctx->tt->cur->data_start = 0;
+
   if((ctx->input->total_bytes > 0))
     {
     s->stats.pts_start = 0;
-    s->stats.pts_end     = ctx->input->total_bytes / s->ci->block_align;
+    s->stats.pts_end     = bgav_demuxer_stride_frames(ctx, s->ci->block_align);
     s->stats.total_bytes = ctx->input->total_bytes;
 
     if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
       ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
     }
 
-  ctx->tt->cur->data_start = 0;
   ctx->flags |= BGAV_DEMUXER_SAMPLE_ACCURATE;
 
   
@@ -186,27 +187,14 @@ static gavl_source_status_t next_packet_rawaudio(bgav_demuxer_context_t * ctx)
 
 static void seek_rawaudio(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   {
-  int64_t file_position;
   bgav_stream_t * s;
   
   s = bgav_track_get_audio_stream(ctx->tt->cur, 0);
 
-  if(s->data.audio.bits_per_sample)
-    {
-    file_position = s->ci->block_align * gavl_time_rescale(scale,
-                                                                  s->data.audio.format->samplerate,
-                                                                  time);
-    }
-  else
-    {
-    file_position = (gavl_time_unscale(scale, time) * (s->codec_bitrate / 8)) / scale;
-    file_position /= s->ci->block_align;
-    file_position *= s->ci->block_align;
-    }
-  /* Calculate the time before we add the start offset */
-  STREAM_SET_SYNC(s, (int64_t)file_position / s->ci->block_align);
-  
-  bgav_input_seek(ctx->input, file_position, SEEK_SET);
+  /* Each sample is a frame of block_align bytes */
+  STREAM_SET_SYNC(s, bgav_demuxer_stride_seek(ctx, s->ci->block_align, 1,
+                                              s->data.audio.format->samplerate,
+                                              time, scale));
   }
 
 static void close_rawaudio(bgav_demuxer_context_t * ctx)
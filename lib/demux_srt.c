@@ -33,6 +33,27 @@
 
 #define STREAM_ID 1
 
+/*
+ *  Cue index
+ *
+ *  Built while the file is read from the start (or completely at open
+ *  time if BGAV_OPT_SUBTITLE_INDEX is set). Each entry stores the
+ *  position and the parser state before a cue. max_end is the largest
+ *  end time of all cues up to this one, it's monotonic even for
+ *  unsorted or overlapping cues, so the first cue still visible at the
+ *  seek time can be found by binary search.
+ */
+
+typedef struct
+  {
+  int64_t position;
+  int64_t max_end;
+
+  int64_t time_offset;
+  int scale_num;
+  int scale_den;
+  } cue_t;
+
 typedef struct
   {
   int64_t time_offset;
@@ -43,6 +64,10 @@ typedef struct
 
   gavl_buffer_t line_buf;
 
+  cue_t * cues;
+  int num_cues;
+  int cues_alloc;
+  int index_complete;
   } srt_t;
 
 static int probe_srt(bgav_input_context_t * input)
@@ -71,37 +96,55 @@ static int probe_srt(bgav_input_context_t * input)
     return 0;
   }
 
-static gavl_source_status_t next_packet_srt(bgav_demuxer_context_t * ctx)
+static void save_state(srt_t * srt, cue_t * cue, int64_t position)
   {
-  bgav_stream_t * s;
-  
-  int lines_read;
-  int a1,a2,a3,a4,b1,b2,b3,b4;
-  int i,len;
-  srt_t * srt;
-  gavl_time_t start, end;
-  char * str;
+  cue->position    = position;
+  cue->time_offset = srt->time_offset;
+  cue->scale_num   = srt->scale_num;
+  cue->scale_den   = srt->scale_den;
+  }
 
-  bgav_packet_t * p;
-  
-  srt = ctx->priv;
+static void restore_state(srt_t * srt, const cue_t * cue)
+  {
+  srt->time_offset = cue->time_offset;
+  srt->scale_num   = cue->scale_num;
+  srt->scale_den   = cue->scale_den;
+  }
 
-  s = bgav_track_find_stream(ctx, STREAM_ID);
+/* Append a cue unless it's already in the index */
 
-  /* Detect post seek */
-  if(ctx->input->position == ctx->tt->cur->data_start)
+static void index_cue(srt_t * srt, cue_t * cue, int64_t end)
+  {
+  if(srt->index_complete ||
+     (srt->num_cues && (cue->position <= srt->cues[srt->num_cues-1].position)))
+    return;
+
+  cue->max_end = end;
+  if(srt->num_cues && (srt->cues[srt->num_cues-1].max_end > end))
+    cue->max_end = srt->cues[srt->num_cues-1].max_end;
+  
+  if(srt->num_cues + 1 > srt->cues_alloc)
     {
-    //    fprintf(stderr, "SRT: Resetting time\n");
-    srt->time_offset = 0;
-    srt->scale_num = 1;
-    srt->scale_den = 1;
+    srt->cues_alloc += 1024;
+    srt->cues = realloc(srt->cues, srt->cues_alloc * sizeof(*srt->cues));
     }
+  srt->cues[srt->num_cues++] = *cue;
+  }
+
+/* Read lines up to the next timing line, return start and end in milliseconds */
+
+static int read_timing(bgav_demuxer_context_t * ctx,
+                       gavl_time_t * start, gavl_time_t * end)
+  {
+  int a1,a2,a3,a4,b1,b2,b3,b4;
+  int i;
+  char * str;
+  srt_t * srt = ctx->priv;
   
-  /* Read lines */
   while(1)
     {
     if(!bgav_input_read_convert_line(ctx->input, &srt->line_buf))
-      return GAVL_SOURCE_EOF;
+      return 0;
     str = (char*)srt->line_buf.buf;
     // fprintf(stderr, "Line: %s (%c)\n", srt->line, srt->line[0]);
     
@@ -125,84 +168,207 @@ static gavl_source_status_t next_packet_srt(bgav_demuxer_context_t * ctx)
         }
       continue;
       }
-    else if((len=sscanf (str,
-                         "%d:%d:%d%[,.:]%d --> %d:%d:%d%[,.:]%d",
-                         &a1,&a2,&a3,(char *)&i,&a4,
-                         &b1,&b2,&b3,(char *)&i,&b4)) == 10)
+    else if(sscanf(str,
+                   "%d:%d:%d%[,.:]%d --> %d:%d:%d%[,.:]%d",
+                   &a1,&a2,&a3,(char *)&i,&a4,
+                   &b1,&b2,&b3,(char *)&i,&b4) == 10)
       {
       break;
       }
     }
 
-  //  p = 
-  
-  start  = a1;
-  start *= 60;
-  start += a2;
-  start *= 60;
-  start += a3;
-  start *= 1000;
-  start += a4;
-
-  end  = b1;
-  end *= 60;
-  end += b2;
-  end *= 60;
-  end += b3;
-  end *= 1000;
-  end += b4;
+  *start  = a1;
+  *start *= 60;
+  *start += a2;
+  *start *= 60;
+  *start += a3;
+  *start *= 1000;
+  *start += a4;
 
-  p = bgav_stream_get_packet_write(s);
-  
-  p->pts = start + srt->time_offset;
-  p->duration = end - start;
+  *end  = b1;
+  *end *= 60;
+  *end += b2;
+  *end *= 60;
+  *end += b3;
+  *end *= 1000;
+  *end += b4;
+  return 1;
+  }
 
-  p->pts = gavl_time_rescale(srt->scale_den,
-                             srt->scale_num,
-                             p->pts);
+/* Read the text lines of a cue into p (or skip them if p is NULL) */
 
-  p->duration = gavl_time_rescale(srt->scale_den,
-                                  srt->scale_num,
-                                  p->duration);
-  
-  p->buf.len = 0;
-  
-  /* Read lines until we are done */
+static int read_text(bgav_demuxer_context_t * ctx, bgav_packet_t * p)
+  {
+  int lines_read = 0;
+  srt_t * srt = ctx->priv;
 
-  lines_read = 0;
+  if(p)
+    p->buf.len = 0;
+  
   while(1)
     {
     if(!bgav_input_read_convert_line(ctx->input, &srt->line_buf))
       {
       srt->line_buf.len = 0;
       if(!lines_read)
-        return GAVL_SOURCE_EOF;
+        return 0;
       }
     
     if(!srt->line_buf.len)
       {
       /* Zero terminate */
-      if(lines_read)
+      if(lines_read && p)
         {
         p->buf.buf[p->buf.len] = '\0';
         // Terminator doesn't count for data size
         // p->data_size++;
         }
-      bgav_stream_done_packet_write(s, p);
-      return GAVL_SOURCE_OK;
+      return 1;
       }
-    if(lines_read)
+
+    lines_read++;
+
+    if(!p)
+      continue;
+    
+    if(lines_read > 1)
       {
       p->buf.buf[p->buf.len] = '\n';
       p->buf.len++;
       }
     
-    lines_read++;
     gavl_packet_alloc(p, p->buf.len + srt->line_buf.len + 2);
     gavl_buffer_append(&p->buf, &srt->line_buf);
     }
   /* Never get here */
-  return GAVL_SOURCE_EOF;
+  return 0;
+  }
+
+static gavl_source_status_t next_packet_srt(bgav_demuxer_context_t * ctx)
+  {
+  bgav_stream_t * s;
+  srt_t * srt;
+  gavl_time_t start, end;
+  bgav_packet_t * p;
+  cue_t cue;
+  
+  srt = ctx->priv;
+
+  s = bgav_track_find_stream(ctx, STREAM_ID);
+
+  /* Detect post seek */
+  if(ctx->input->position == ctx->tt->cur->data_start)
+    {
+    //    fprintf(stderr, "SRT: Resetting time\n");
+    srt->time_offset = 0;
+    srt->scale_num = 1;
+    srt->scale_den = 1;
+    }
+
+  save_state(srt, &cue, ctx->input->position);
+  
+  /* Read lines */
+  if(!read_timing(ctx, &start, &end))
+    {
+    /* We only jump to indexed cues, so the index has no gaps */
+    srt->index_complete = 1;
+    return GAVL_SOURCE_EOF;
+    }
+
+  p = bgav_stream_get_packet_write(s);
+  
+  p->pts = start + srt->time_offset;
+  p->duration = end - start;
+
+  p->pts = gavl_time_rescale(srt->scale_den,
+                             srt->scale_num,
+                             p->pts);
+
+  p->duration = gavl_time_rescale(srt->scale_den,
+                                  srt->scale_num,
+                                  p->duration);
+  
+  /* Read lines until we are done */
+  if(!read_text(ctx, p))
+    return GAVL_SOURCE_EOF;
+
+  index_cue(srt, &cue, p->pts + p->duration);
+  
+  bgav_stream_done_packet_write(s, p);
+  return GAVL_SOURCE_OK;
+  }
+
+/* Parse the whole file without creating packets */
+
+static void build_index(bgav_demuxer_context_t * ctx)
+  {
+  srt_t * srt = ctx->priv;
+  gavl_time_t start, end;
+  cue_t cue;
+  int64_t start_pos = ctx->input->position;
+
+  while(1)
+    {
+    save_state(srt, &cue, ctx->input->position);
+
+    if(!read_timing(ctx, &start, &end) ||
+       !read_text(ctx, NULL))
+      break;
+    
+    /* Same rounding as in next_packet_srt() */
+    index_cue(srt, &cue,
+              gavl_time_rescale(srt->scale_den, srt->scale_num,
+                                start + srt->time_offset) +
+              gavl_time_rescale(srt->scale_den, srt->scale_num,
+                                end - start));
+    }
+  srt->index_complete = 1;
+
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Indexed %d cues", srt->num_cues);
+  
+  bgav_input_seek(ctx->input, start_pos, SEEK_SET);
+  srt->time_offset = 0;
+  srt->scale_num = 1;
+  srt->scale_den = 1;
+  }
+
+static void seek_srt(bgav_demuxer_context_t * ctx, int64_t time, int scale)
+  {
+  int lo, hi, mid;
+  int64_t t;
+  srt_t * srt = ctx->priv;
+  bgav_stream_t * s = bgav_track_get_subtitle_stream(ctx->tt->cur, 0);
+
+  if(!srt->num_cues)
+    {
+    bgav_subtitle_seek(ctx, time, scale);
+    return;
+    }
+
+  /* One tick earlier is safe against rounding, skipto drops extra cues */
+  t = gavl_time_rescale(scale, s->timescale, time) - 1;
+
+  if(srt->index_complete || (srt->cues[srt->num_cues-1].max_end >= t))
+    {
+    /* First cue with max_end >= t */
+    lo = 0;
+    hi = srt->num_cues - 1;
+
+    while(lo < hi)
+      {
+      mid = (lo + hi) / 2;
+      if(srt->cues[mid].max_end >= t)
+        hi = mid;
+      else
+        lo = mid + 1;
+      }
+    }
+  else /* Continue indexing from the last known cue */
+    lo = srt->num_cues - 1;
+  
+  bgav_input_seek(ctx->input, srt->cues[lo].position, SEEK_SET);
+  restore_state(srt, &srt->cues[lo]);
+  bgav_subtitle_skipto(s, &time, scale);
   }
 
 static int open_srt(bgav_demuxer_context_t * ctx)
@@ -224,7 +390,12 @@ static int open_srt(bgav_demuxer_context_t * ctx)
   srt->scale_den = 1;
 
   if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+    {
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+
+    if(bgav_options_get_bool(ctx->opt, BGAV_OPT_SUBTITLE_INDEX))
+      build_index(ctx);
+    }
   
   return 1;
   }
@@ -234,6 +405,9 @@ static void close_srt(bgav_demuxer_context_t * ctx)
   srt_t * srt = ctx->priv;
 
   gavl_buffer_free(&srt->line_buf);
+
+  if(srt->cues)
+    free(srt->cues);
   free(srt);
   }
   
@@ -241,7 +415,7 @@ const bgav_demuxer_t bgav_demuxer_srt =
   {
     .probe =       probe_srt,
     .open =        open_srt,
-    .seek =        bgav_subtitle_seek,
+    .seek =        seek_srt,
     .next_packet = next_packet_srt,
     .close =       close_srt
   };
@@ -41,6 +41,10 @@ typedef struct
 
   
   int buf_size;
+
+  /* Bytes per frame including the frame header, 0 if frames can't be located
+     arithmetically */
+  int64_t stride;
   } y4m_t;
 
 static int probe_y4m(bgav_input_context_t * input)
@@ -84,6 +88,45 @@ static const char * next_tag(const char * old)
   return old;
   }
 
+/*
+ *  Frame headers may carry parameters, which makes their size variable.
+ *  We use arithmetic seeking only if the first and the last frame
+ *  have a bare header and the payload divides evenly into frames.
+ */
+
+#define FRAME_HEADER     "FRAME\n"
+#define FRAME_HEADER_LEN 6
+
+static int check_stride(bgav_demuxer_context_t * ctx, int64_t stride)
+  {
+  uint8_t buf[FRAME_HEADER_LEN];
+  int64_t num_frames;
+  int64_t end;
+  int ret = 0;
+  
+  if(bgav_input_get_data(ctx->input, buf, FRAME_HEADER_LEN) < FRAME_HEADER_LEN ||
+     memcmp(buf, FRAME_HEADER, FRAME_HEADER_LEN))
+    return 0;
+
+  if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) ||
+     ((num_frames = bgav_demuxer_stride_frames(ctx, stride)) <= 0))
+    return 0;
+
+  end = ctx->tt->cur->data_start + num_frames * stride;
+
+  if(end != ctx->input->total_bytes)
+    return 0;
+
+  bgav_input_seek(ctx->input, end - stride, SEEK_SET);
+
+  if(bgav_input_read_data(ctx->input, buf, FRAME_HEADER_LEN) == FRAME_HEADER_LEN &&
+     !memcmp(buf, FRAME_HEADER, FRAME_HEADER_LEN))
+    ret = 1;
+  
+  bgav_input_seek(ctx->input, ctx->tt->cur->data_start, SEEK_SET);
+  return ret;
+  }
+
 static int open_y4m(bgav_demuxer_context_t * ctx)
   {
   y4m_t * priv;
@@ -225,6 +268,28 @@ static int open_y4m(bgav_demuxer_context_t * ctx)
   s->fourcc = BGAV_MK_FOURCC('y','4','m',' ');
 
   bgav_track_set_format(ctx->tt->cur, "yuv4mpeg", NULL);
+
+  ctx->tt->cur->data_start = ctx->input->position;
+  
+  if(priv->buf_size &&
+     check_stride(ctx, FRAME_HEADER_LEN + priv->buf_size))
+    {
+    priv->stride = FRAME_HEADER_LEN + priv->buf_size;
+    
+    s->stats.pts_end = bgav_demuxer_stride_frames(ctx, priv->stride) *
+      s->data.video.format->frame_duration;
+    
+    ctx->flags |= (BGAV_DEMUXER_CAN_SEEK|BGAV_DEMUXER_SAMPLE_ACCURATE);
+    }
+  else
+    {
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN,
+             "Frame size is not constant, seeking needs an index");
+    ctx->flags |= BGAV_DEMUXER_SEEK_ITERATIVE;
+
+    if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+      ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    }
   
   ctx->index_mode = INDEX_MODE_SIMPLE;
   return 1;
@@ -311,6 +376,21 @@ static gavl_source_status_t next_packet_y4m(bgav_demuxer_context_t * ctx)
   }
 
 
+static void seek_y4m(bgav_demuxer_context_t * ctx, int64_t time, int scale)
+  {
+  bgav_stream_t * s;
+  y4m_t * priv;
+  
+  priv = ctx->priv;
+  s = bgav_track_get_video_stream(ctx->tt->cur, 0);
+  
+  STREAM_SET_SYNC(s, bgav_demuxer_stride_seek(ctx, priv->stride,
+                                              s->data.video.format->frame_duration,
+                                              s->data.video.format->timescale,
+                                              time, scale) *
+                  s->data.video.format->frame_duration);
+  }
+
 static void close_y4m(bgav_demuxer_context_t * ctx)
   {
   y4m_t * priv;
@@ -326,5 +406,6 @@ const bgav_demuxer_t bgav_demuxer_y4m =
     .probe        = probe_y4m,
     .open         = open_y4m,
     .next_packet = next_packet_y4m,
+    .seek =        seek_y4m,
     .close =       close_y4m
   };
@@ -29,11 +29,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <dirent.h>
 
 #include <unistd.h>
-
+#include <pthread.h>
 
 
 #define LOG_DOMAIN "demuxer"
@@ -190,14 +195,60 @@ static const demuxer_t demuxers[] =
     { &bgav_demuxer_rawaudio, "Raw audio" },
   };
 
-static const demuxer_t sync_demuxers[] =
+/*
+ *  Cheap tests on raw bytes, which must succeed for a sync demuxer
+ *  to detect a stream starting at that position. They let us scan
+ *  for a sync point without calling the full probe functions at
+ *  every byte.
+ */
+
+static int can_sync_srt(const uint8_t * data, int len)
+  {
+  return (data[0] >= '0' && data[0] <= '9') || (data[0] == '@') || (data[0] == 0xff);
+  }
+
+static int can_sync_mpegts(const uint8_t * data, int len)
+  {
+  if(data[0] != 0x47)
+    return 0;
+  /* 188, 192 or 204 byte packets */
+  if((len > 204) && (data[188] != 0x47) && (data[192] != 0x47) && (data[204] != 0x47))
+    return 0;
+  return 1;
+  }
+
+static int can_sync_mpegaudio(const uint8_t * data, int len)
   {
-    { &bgav_demuxer_srt,       "SubRip subtitle" },
-    { &bgav_demuxer_mpegts2,   "MPEG-2 transport stream" },
+  return (len >= 4) && (data[0] == 0xff) && ((data[1] & 0xe0) == 0xe0);
+  }
+
+static int can_sync_adts(const uint8_t * data, int len)
+  {
+  return (len >= 7) && (data[0] == 0xff) && ((data[1] & 0xf6) == 0xf0);
+  }
+
+static int can_sync_mpegps(const uint8_t * data, int len)
+  {
+  if(len < 12)
+    return 0;
+  return ((data[0] == 0x00) && (data[1] == 0x00) && (data[2] == 0x01) && (data[3] == 0xba)) ||
+    (data[0] == 'R');
+  }
+
+static const struct
+  {
+  const bgav_demuxer_t * demuxer;
+  char * format_name;
+  int (*can_sync)(const uint8_t * data, int len);
+  }
+sync_demuxers[] =
+  {
+    { &bgav_demuxer_srt,       "SubRip subtitle",         can_sync_srt       },
+    { &bgav_demuxer_mpegts2,   "MPEG-2 transport stream", can_sync_mpegts    },
     //    { &bgav_demuxer_mpegts,    "MPEG-2 transport stream" },
-    { &bgav_demuxer_mpegaudio, "MPEG Audio" },
-    { &bgav_demuxer_adts,      "ADTS" },
-    { &bgav_demuxer_mpegps,    "MPEG System" },
+    { &bgav_demuxer_mpegaudio, "MPEG Audio",              can_sync_mpegaudio },
+    { &bgav_demuxer_adts,      "ADTS",                    can_sync_adts      },
+    { &bgav_demuxer_mpegps,    "MPEG System",             can_sync_mpegps    },
   };
 
 static struct
@@ -220,38 +271,171 @@ static const int num_sync_demuxers = sizeof(sync_demuxers)/sizeof(sync_demuxers[
 
 static const int num_mimetypes = sizeof(mimetypes)/sizeof(mimetypes[0]);
 
+/* Hash of mimetype -> mimetypes[] index, built once */
+
+static bgav_fourcc_table_t mimetype_table;
+static pthread_once_t mimetype_table_once = PTHREAD_ONCE_INIT;
+
+static void init_mimetype_table()
+  {
+  int i;
+  uint32_t keys[sizeof(mimetypes)/sizeof(mimetypes[0])];
+  
+  for(i = 0; i < num_mimetypes; i++)
+    keys[i] = bgav_string_hash(mimetypes[i].mimetype);
+  
+  bgav_fourcc_table_init(&mimetype_table, keys, num_mimetypes);
+  }
+
+#if defined(__GNUC__) && defined(__ELF__)
+static void __cleanup() __attribute__ ((destructor));
+ 
+static void __cleanup()
+  {
+  bgav_fourcc_table_free(&mimetype_table);
+  }
+#endif
+
+static const bgav_demuxer_t * find_by_mimetype(const char * mimetype)
+  {
+  int i, num;
+  const int * idx;
+
+  pthread_once(&mimetype_table_once, init_mimetype_table);
+  
+  if(!(idx = bgav_fourcc_table_get(&mimetype_table,
+                                   bgav_string_hash(mimetype), &num)))
+    return NULL;
+
+  /* Resolve hash collisions */
+  for(i = 0; i < num; i++)
+    {
+    if(!strcmp(mimetypes[idx[i]].mimetype, mimetype))
+      return mimetypes[idx[i]].demuxer;
+    }
+  return NULL;
+  }
+
 // int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer);
 
 
 #define SYNC_BYTES (32*1024)
 
+/* Maximum number of bytes, a sync demuxer probe looks at */
+#define SYNC_LOOKAHEAD (32*1024)
 
+/*
+ *  Get a copy of the first len bytes of the input without
+ *  consuming them. Data is read in large chunks into the input buffer
+ *  so all subsequent probe functions are served from memory.
+ */
 
-const bgav_demuxer_t * bgav_demuxer_probe(bgav_input_context_t * input)
+static void get_snapshot(bgav_input_context_t * input, gavl_buffer_t * ret, int len)
+  {
+  int old_len;
+
+  gavl_buffer_reset(ret);
+  
+  do{
+    old_len = input->buf.len - input->buf.pos;
+    bgav_input_ensure_buffer_size(input, len);
+    } while((input->buf.len - input->buf.pos < len) &&
+            (input->buf.len - input->buf.pos > old_len));
+  
+  gavl_buffer_append_data(ret, input->buf.buf + input->buf.pos,
+                          input->buf.len - input->buf.pos);
+  }
+
+static const bgav_demuxer_t * scan_sync(bgav_input_context_t * input)
   {
   int i;
   int bytes_skipped;
-  uint8_t skip;
-  const char * mimetype = NULL;
+  int end;
+  int64_t start_pos = input->position;
+  gavl_buffer_t snapshot;
+  const bgav_demuxer_t * ret = NULL;
+  
+  gavl_buffer_init(&snapshot);
+  get_snapshot(input, &snapshot, SYNC_BYTES + SYNC_LOOKAHEAD);
+
+  end = snapshot.len;
+  if(end > SYNC_BYTES + 1)
+    end = SYNC_BYTES + 1;
+  
+  /* Single pass over the snapshot */
+  for(bytes_skipped = 1; bytes_skipped < end; bytes_skipped++)
+    {
+    for(i = 0; i < num_sync_demuxers; i++)
+      {
+      if(!sync_demuxers[i].can_sync(snapshot.buf + bytes_skipped,
+                                    snapshot.len - bytes_skipped))
+        continue;
+
+      /* Candidate: Move the input there and do the real check. Skipping
+         is done within the input buffer */
+      
+      if(input->position < start_pos + bytes_skipped)
+        bgav_input_skip(input, start_pos + bytes_skipped - input->position);
+      
+      if(sync_demuxers[i].demuxer->probe(input))
+        {
+        gavl_log(GAVL_LOG_INFO, LOG_DOMAIN,
+                 "Detected %s format after skipping %d bytes (position: %"PRId64")",
+                 sync_demuxers[i].format_name, bytes_skipped, input->position);
+        ret = sync_demuxers[i].demuxer;
+        goto end;
+        }
+      }
+    }
+  
+  end:
+  gavl_buffer_free(&snapshot);
+  return ret;
+  }
 
+const bgav_demuxer_t * bgav_demuxer_probe(bgav_input_context_t * input,
+                                          const bgav_demuxer_t * hint)
+  {
+  int i;
+  const char * mimetype = NULL;
+  const bgav_demuxer_t * ret;
+  
   //  fprintf(stderr, "bgav_demuxer_probe\n");
   //  gavl_dictionary_dump(&input->m, 2);
   
-  if(gavl_metadata_get_src(&input->m, GAVL_META_SRC, 0, &mimetype, NULL) && mimetype)
+  if(gavl_metadata_get_src(&input->m, GAVL_META_SRC, 0, &mimetype, NULL) && mimetype &&
+     (ret = find_by_mimetype(mimetype)))
+    {
+    gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN,
+             "Got demuxer for mimetype %s", mimetype);
+    return ret;
+    }
+
+  /* For files, read everything the probe functions need at once */
+  if(input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+    bgav_input_ensure_buffer_size(input, SYNC_BYTES + SYNC_LOOKAHEAD);
+
+  /* Batch scans mostly see the same format again, try that first */
+  if(hint)
     {
-    for(i = 0; i < num_mimetypes; i++)
+    for(i = 0; i < num_demuxers; i++)
       {
-      if(!strcmp(mimetypes[i].mimetype, mimetype))
+      if(demuxers[i].demuxer != hint)
+        continue;
+      if(hint->probe(input))
         {
         gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN,
-                 "Got demuxer for mimetype %s", mimetype);
-        return mimetypes[i].demuxer;
+                 "Detected %s format (same as before)", demuxers[i].format_name);
+        return hint;
         }
+      break;
       }
     }
-
+  
   for(i = 0; i < num_demuxers; i++)
     {
+    if(demuxers[i].demuxer == hint)
+      continue;
     if(demuxers[i].demuxer->probe(input))
       {
       gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN,
@@ -272,27 +456,9 @@ const bgav_demuxer_t * bgav_demuxer_probe(bgav_input_context_t * input)
     }
   
   /* Try again with skipping initial bytes */
-
-  bytes_skipped = 0;
-
-  while(bytes_skipped < SYNC_BYTES)
-    {
-    bytes_skipped++;
-    if(!bgav_input_read_data(input, &skip, 1))
-      return NULL;
-
-    for(i = 0; i < num_sync_demuxers; i++)
-      {
-      if(sync_demuxers[i].demuxer->probe(input))
-        {
-        gavl_log(GAVL_LOG_INFO, LOG_DOMAIN,
-                 "Detected %s format after skipping %d bytes (position: %"PRId64")",
-                 sync_demuxers[i].format_name, bytes_skipped, input->position);
-        return sync_demuxers[i].demuxer;
-        }
-      }
-    
-    }
+  
+  if((ret = scan_sync(input)))
+    return ret;
   
   if(input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
     {
@@ -385,6 +551,52 @@ static void init_superindex(bgav_demuxer_context_t * ctx)
     }
   }
 
+/*
+ *  Windowed superindex: ctx->si holds only a part of the index. The
+ *  demuxer collected the stream stats of the whole file while counting
+ *  the packets.
+ */
+
+static void init_superindex_window(bgav_demuxer_context_t * ctx)
+  {
+  int i = 0;
+
+  while(i < ctx->tt->cur->num_streams)
+    {
+    if(!ctx->tt->cur->streams[i]->stats.total_packets)
+      {
+      gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+               "Removing stream %d (no packets found)", i+1);
+      bgav_track_remove_stream(ctx->tt->cur, i);
+      continue;
+      }
+    i++;
+    }
+  
+  bgav_demuxer_si_window_changed(ctx);
+  }
+
+void bgav_demuxer_si_window_changed(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  bgav_stream_t * s;
+  
+  if(ctx->flags & BGAV_DEMUXER_LIVE)
+    return;
+  
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    {
+    s = ctx->tt->cur->streams[i];
+    
+    if((s->first_index_pos =
+        gavl_packet_index_get_first(ctx->si, s->stream_id)) < 0)
+      continue;
+
+    s->last_index_pos = gavl_packet_index_get_last(ctx->si, s->stream_id);
+    bgav_packet_index_set_durations(ctx->si, s);
+    }
+  }
+
 #if 0
 void bgav_demuxer_set_durations_from_superindex(bgav_demuxer_context_t * ctx, bgav_track_t * t)
   {
@@ -426,24 +638,125 @@ void bgav_demuxer_check_interleave(bgav_demuxer_context_t * ctx)
   }
 #endif
 
-static int read_packet_superindex(bgav_demuxer_context_t * ctx, bgav_stream_t * s,
-                                  gavl_packet_t * p, int pos)
+/*
+ *  Read ahead for non-interleaved files: Instead of seeking to each packet
+ *  we read the following packets of the stream in one chunk and serve
+ *  them from memory.
+ */
+
+#define SI_READAHEAD_DEFAULT (8*1024*1024)
+#define SI_READAHEAD_MAX_GAP (64*1024)
+
+static int get_si_readahead(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  int num = 0;
+  int ret = SI_READAHEAD_DEFAULT;
+  
+  gavl_dictionary_get_int(ctx->opt, BGAV_OPT_SI_READAHEAD, &ret);
+
+  if(ret <= 0)
+    return 0;
+  
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    {
+    if(ctx->tt->cur->streams[i]->action != BGAV_STREAM_MUTE)
+      num++;
+    }
+  if(num > 1)
+    ret /= num;
+  return ret;
+  }
+
+static int fill_si_cache(bgav_demuxer_context_t * ctx, bgav_stream_t * s, int pos)
+  {
+  int64_t start, end;
+  int max_bytes;
+  int next;
+  int num = 1;
+  
+  if(!(max_bytes = get_si_readahead(ctx)))
+    return 0;
+  
+  start = ctx->si->entries[pos].position;
+  end = start + ctx->si->entries[pos].size;
+
+  /* Packet alone is larger than the cache: Read it directly */
+  if(end - start > max_bytes)
+    return 0;
+  
+  next = pos;
+  while((next = gavl_packet_index_get_next_packet(ctx->si, s->stream_id, next+1)) >= 0)
+    {
+    if((ctx->si->entries[next].position < end) ||
+       (ctx->si->entries[next].position - end > SI_READAHEAD_MAX_GAP) ||
+       (ctx->si->entries[next].position + ctx->si->entries[next].size - start > max_bytes))
+      break;
+    end = ctx->si->entries[next].position + ctx->si->entries[next].size;
+    num++;
+    }
+
+  /* Nothing to gain for a single packet */
+  if(num < 2)
+    return 0;
+  
+  if(start != ctx->input->position)
+    {
+    if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+      return 0;
+    bgav_input_seek(ctx->input, start, SEEK_SET);
+    }
+
+  gavl_buffer_alloc(&s->si_cache, end - start);
+  s->si_cache.len = bgav_input_read_data(ctx->input, s->si_cache.buf, end - start);
+  s->si_cache_start = start;
+  return 1;
+  }
+
+static int si_cache_has(bgav_stream_t * s, int64_t position, int size)
+  {
+  return (position >= s->si_cache_start) &&
+    (position + size <= s->si_cache_start + s->si_cache.len);
+  }
+
+static int read_data_superindex(bgav_demuxer_context_t * ctx, bgav_stream_t * s,
+                                uint8_t * data, int pos)
   {
-  if(ctx->si->entries[pos].position > ctx->input->position)
-    bgav_input_skip(ctx->input, ctx->si->entries[pos].position - ctx->input->position);
-  else if(ctx->si->entries[pos].position < ctx->input->position)
+  int64_t position = ctx->si->entries[pos].position;
+  int size = ctx->si->entries[pos].size;
+  
+  if((ctx->flags & BGAV_DEMUXER_NONINTERLEAVED) &&
+     (si_cache_has(s, position, size) ||
+      (fill_si_cache(ctx, s, pos) && si_cache_has(s, position, size))))
+    {
+    memcpy(data, s->si_cache.buf + (position - s->si_cache_start), size);
+    return 1;
+    }
+  
+  if(position > ctx->input->position)
+    bgav_input_skip(ctx->input, position - ctx->input->position);
+  else if(position < ctx->input->position)
     {
     if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
       {
       gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Couldn't seek backwards");
       return 0;
       }
-    bgav_input_seek(ctx->input, ctx->si->entries[pos].position, SEEK_SET);
+    bgav_input_seek(ctx->input, position, SEEK_SET);
     }
   
+  if(bgav_input_read_data(ctx->input, data, size) < size)
+    return 0;
+  return 1;
+  }
+
+static int read_packet_superindex(bgav_demuxer_context_t * ctx, bgav_stream_t * s,
+                                  gavl_packet_t * p, int pos)
+  {
   p->buf.len = ctx->si->entries[pos].size;
   gavl_packet_alloc(p, p->buf.len);
-  if(bgav_input_read_data(ctx->input, p->buf.buf, p->buf.len) < p->buf.len)
+
+  if(!read_data_superindex(ctx, s, p->buf.buf, pos))
     return 0;
   
   if(s->flags & STREAM_DTS_ONLY)
@@ -505,7 +818,7 @@ gavl_source_status_t bgav_demuxer_next_packet_si(bgav_demuxer_context_t * ctx)
         break;
       ctx->index_position++;
       }
-    if(!s)
+    if(!s || (ctx->index_position >= ctx->si->num_entries))
       return GAVL_SOURCE_EOF;
     idx = ctx->index_position;
     ctx->index_position++;
@@ -532,7 +845,9 @@ int bgav_demuxer_start(bgav_demuxer_context_t * ctx)
   
   if(ctx->si)
     {
-    if(!(ctx->si->flags & GAVL_PACKET_INDEX_SPARSE))
+    if(ctx->flags & BGAV_DEMUXER_SI_WINDOW)
+      init_superindex_window(ctx);
+    else if(!(ctx->si->flags & GAVL_PACKET_INDEX_SPARSE))
       {
       init_superindex(ctx);
       //    check_interleave(ctx);
@@ -552,6 +867,62 @@ int bgav_demuxer_start(bgav_demuxer_context_t * ctx)
   return 1;
   }
 
+void bgav_demuxer_load_si_window(bgav_demuxer_context_t * ctx,
+                                 int64_t time, int scale)
+  {
+  if((ctx->flags & BGAV_DEMUXER_SI_WINDOW) && ctx->demuxer->load_si_window)
+    ctx->demuxer->load_si_window(ctx, time, scale);
+  }
+
+void bgav_demuxer_load_si(bgav_demuxer_context_t * ctx)
+  {
+  if(!ctx->si && ctx->demuxer->load_si)
+    ctx->demuxer->load_si(ctx);
+  }
+
+/* Fixed stride files */
+
+int64_t bgav_demuxer_stride_frames(bgav_demuxer_context_t * ctx, int64_t stride)
+  {
+  int64_t end;
+
+  if(stride <= 0)
+    return -1;
+
+  if(ctx->tt->cur->data_end > 0)
+    end = ctx->tt->cur->data_end;
+  else if(ctx->input->total_bytes > 0)
+    end = ctx->input->total_bytes;
+  else
+    return -1;
+
+  if(end <= ctx->tt->cur->data_start)
+    return 0;
+
+  return (end - ctx->tt->cur->data_start) / stride;
+  }
+
+int64_t bgav_demuxer_stride_seek(bgav_demuxer_context_t * ctx, int64_t stride,
+                                 int64_t frame_duration, int timescale,
+                                 int64_t time, int scale)
+  {
+  int64_t frame;
+  int64_t num_frames;
+
+  frame = gavl_time_rescale(scale, timescale, time) / frame_duration;
+
+  /* Seeking beyond the end leaves us at the last frame */
+  num_frames = bgav_demuxer_stride_frames(ctx, stride);
+  if((num_frames > 0) && (frame >= num_frames))
+    frame = num_frames - 1;
+
+  if(frame < 0)
+    frame = 0;
+
+  bgav_input_seek(ctx->input, ctx->tt->cur->data_start + frame * stride, SEEK_SET);
+  return frame;
+  }
+
 void bgav_demuxer_stop(bgav_demuxer_context_t * ctx)
   {
   ctx->demuxer->close(ctx);
@@ -580,7 +951,9 @@ gavl_source_status_t bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
     demuxer->b->flags |= BGAV_FLAG_STATE_SENT;
     }
 
+  BGAV_TRACE_BEGIN("next_packet");
   ret = demuxer->demuxer->next_packet(demuxer);
+  BGAV_TRACE_END("next_packet");
       
   if(ret == GAVL_SOURCE_EOF)
     {
@@ -695,6 +1068,43 @@ static int parse_packet(bgav_demuxer_context_t * ctx)
   return 1;
   }
 
+/* Estimate the duration from the bitrates without parsing the file */
+
+static int estimate_duration(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  int64_t bytes;
+  int64_t bitrate = 0;
+  bgav_stream_t * s;
+  
+  for(i = 0; i < ctx->tt->cur->num_streams; i++)
+    {
+    s = ctx->tt->cur->streams[i];
+    
+    if(!(s->type & (GAVL_STREAM_AUDIO | GAVL_STREAM_VIDEO)))
+      continue;
+
+    if(s->container_bitrate > 0)
+      bitrate += s->container_bitrate;
+    else if(s->codec_bitrate > 0)
+      bitrate += s->codec_bitrate;
+    else
+      return 0;
+    }
+
+  if(ctx->tt->cur->data_end > 0)
+    bytes = ctx->tt->cur->data_end - ctx->tt->cur->data_start;
+  else
+    bytes = ctx->input->total_bytes - ctx->tt->cur->data_start;
+  
+  if((bitrate <= 0) || (bytes <= 0))
+    return 0;
+
+  gavl_dictionary_set_long(ctx->tt->cur->metadata, GAVL_META_APPROX_DURATION,
+                           gavl_time_unscale(bitrate, bytes * 8));
+  return 1;
+  }
+
 int bgav_demuxer_get_duration(bgav_demuxer_context_t * ctx)
   {
   int i;
@@ -767,6 +1177,12 @@ int bgav_demuxer_get_duration(bgav_demuxer_context_t * ctx)
   
     parse_end(ctx, type_mask);
     }
+  else if(ctx->b && (ctx->b->flags & BGAV_FLAG_SCAN))
+    {
+    /* Building the index means parsing the whole file */
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Estimating duration from bitrate");
+    return estimate_duration(ctx);
+    }
   else if(ctx->index_mode == INDEX_MODE_SIMPLE)
     {
     int i;
@@ -778,7 +1194,7 @@ int bgav_demuxer_get_duration(bgav_demuxer_context_t * ctx)
        !location)
       return 0;
     
-    if(!(ctx->si = bgav_get_packet_index(location)))
+    if(!(ctx->si = bgav_get_packet_index(location, ctx->opt)))
       return 0;
 
     for(i = 0; i < ctx->tt->cur->num_streams; i++)
@@ -827,6 +1243,8 @@ void bgav_demuxer_parse_track(bgav_demuxer_context_t * ctx)
   {
   int type_mask = GAVL_STREAM_AUDIO | GAVL_STREAM_VIDEO | GAVL_STREAM_TEXT | GAVL_STREAM_OVERLAY;
 
+  BGAV_TRACE_BEGIN("build_index");
+  
   ctx->si = gavl_packet_index_create(0);
   
   parse_start(ctx, type_mask, 0);
@@ -842,10 +1260,237 @@ void bgav_demuxer_parse_track(bgav_demuxer_context_t * ctx)
   gavl_packet_index_sort_by_position(ctx->si);
   
   parse_end(ctx, type_mask);
+
+  BGAV_TRACE_END("build_index");
+  }
+
+/* Packet index cache */
+
+#define INDEX_CACHE_THRESHOLD_DEFAULT 2000 /* Milliseconds */
+#define INDEX_CACHE_SIZE_DEFAULT      1024 /* Megabytes    */
+
+typedef struct
+  {
+  char * name;
+  int64_t size;
+  time_t mtime;
+  } cache_entry_t;
+
+static int compare_cache_entry(const void * p1, const void * p2)
+  {
+  const cache_entry_t * e1 = p1;
+  const cache_entry_t * e2 = p2;
+
+  if(e1->mtime < e2->mtime)
+    return -1;
+  else if(e1->mtime > e2->mtime)
+    return 1;
+  return 0;
+  }
+
+/* Load a cached index if it is newer than the file */
+
+static gavl_packet_index_t * load_cached_index(const char * filename,
+                                               const char * url)
+  {
+  struct stat st_uri;
+  struct stat st_idx;
+  gavl_packet_index_t * ret;
+
+  if(stat(filename, &st_idx) ||
+     stat(url, &st_uri) ||
+     (st_uri.st_mtime >= st_idx.st_mtime))
+    return NULL;
+
+  if(!(ret = bgav_packet_index_load_compact(filename)) &&
+     !(ret = gavl_packet_index_load(filename)))
+    return NULL;
+
+  /* Mark as recently used. This keeps the index newer than the file */
+  utimes(filename, NULL);
+
+  gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Loaded packet index from %s", filename);
+  return ret;
+  }
+
+/* Write to a temporary file first so readers never see partial indices */
+
+static void save_cached_index(const gavl_packet_index_t * idx,
+                              const char * filename)
+  {
+  char * tmp;
+  int result;
+
+  tmp = gavl_sprintf("%s.%d.tmp", filename, (int)getpid());
+
+  if(!(result = bgav_packet_index_save_compact(idx, tmp)))
+    result = gavl_packet_index_save(idx, tmp);
+
+  if(result && !rename(tmp, filename))
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Saved packet index to %s", filename);
+  else
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Saving packet index to %s failed", filename);
+    unlink(tmp);
+    }
+  free(tmp);
+  }
+
+/* Remove the least recently used indices until the cache is small enough */
+
+static void evict_cached_indices(const char * cache_dir, int64_t max_size)
+  {
+  DIR * d;
+  struct dirent * res;
+  struct stat st;
+  char * filename;
+  char * lockname;
+  int fd;
+  int i;
+  int num_entries = 0;
+  int entries_alloc = 0;
+  cache_entry_t * entries = NULL;
+  int64_t total_size = 0;
+
+  if(!(d = opendir(cache_dir)))
+    return;
+
+  while((res = readdir(d)))
+    {
+    /* Index files are named by the md5 sum, lock and temporary files have suffixes */
+    if(strchr(res->d_name, '.'))
+      continue;
+
+    filename = gavl_sprintf("%s/%s", cache_dir, res->d_name);
+
+    if(stat(filename, &st) || !S_ISREG(st.st_mode))
+      {
+      free(filename);
+      continue;
+      }
+
+    if(num_entries == entries_alloc)
+      {
+      entries_alloc += 64;
+      entries = realloc(entries, entries_alloc * sizeof(*entries));
+      }
+
+    entries[num_entries].name  = filename;
+    entries[num_entries].size  = st.st_size;
+    entries[num_entries].mtime = st.st_mtime;
+    total_size += st.st_size;
+    num_entries++;
+    }
+  closedir(d);
+
+  if(total_size > max_size)
+    {
+    qsort(entries, num_entries, sizeof(*entries), compare_cache_entry);
+
+    for(i = 0; (i < num_entries) && (total_size > max_size); i++)
+      {
+      if(unlink(entries[i].name))
+        continue;
+
+      total_size -= entries[i].size;
+
+      gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Removed cached index %s", entries[i].name);
+
+      /* Remove the lock file unless someone is building the index right now */
+      lockname = gavl_sprintf("%s.lock", entries[i].name);
+      if((fd = open(lockname, O_RDWR)) >= 0)
+        {
+        if(!flock(fd, LOCK_EX | LOCK_NB))
+          unlink(lockname);
+        close(fd);
+        }
+      free(lockname);
+      }
+    }
+
+  for(i = 0; i < num_entries; i++)
+    free(entries[i].name);
+  if(entries)
+    free(entries);
+  }
+
+/*
+ *  Only one process builds an index at a time. Others block on the
+ *  lock file and load the result afterwards. Since evict_cached_indices()
+ *  removes lock files, we might have locked a file, which was unlinked
+ *  meanwhile. In this case we try again with the new one.
+ *
+ *  Before blocking, a waiting process appends a byte to the lock file.
+ *  The lock holder truncates it after locking, so a nonempty lock file
+ *  tells the builder that others are waiting for its index.
+ */
+
+static int lock_cached_index(const char * filename, int * waited)
+  {
+  int fd = -1;
+  char * lockname;
+  struct stat st_fd;
+  struct stat st_name;
+
+  *waited = 0;
+
+  lockname = gavl_sprintf("%s.lock", filename);
+
+  while(1)
+    {
+    if((fd = open(lockname, O_RDWR | O_CREAT | O_APPEND, 0644)) < 0)
+      break;
+
+    if(flock(fd, LOCK_EX | LOCK_NB))
+      {
+      if(errno != EWOULDBLOCK)
+        goto fail;
+      
+      if(!*waited)
+        gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Waiting for another process building the packet index");
+      *waited = 1;
+
+      if(write(fd, "w", 1) < 0)
+        gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Marking lock file failed: %s", strerror(errno));
+
+      while(flock(fd, LOCK_EX))
+        {
+        if(errno != EINTR)
+          goto fail;
+        }
+      }
+
+    /* Check if we locked the current lock file */
+    if(!fstat(fd, &st_fd) && !stat(lockname, &st_name) &&
+       (st_fd.st_dev == st_name.st_dev) && (st_fd.st_ino == st_name.st_ino))
+      {
+      /* Clear the marks of processes, which waited for the previous holder */
+      if(st_fd.st_size && ftruncate(fd, 0))
+        gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Truncating lock file failed: %s", strerror(errno));
+      break;
+      }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    }
   
+  free(lockname);
+  return fd;
+
+  fail:
+  close(fd);
+  free(lockname);
+  return -1;
+  }
+
+static int have_index_waiters(int lock_fd)
+  {
+  struct stat st;
+  return !fstat(lock_fd, &st) && (st.st_size > 0);
   }
 
-gavl_packet_index_t * bgav_get_packet_index(const char * url)
+gavl_packet_index_t * bgav_get_packet_index(const char * url,
+                                            const bgav_options_t * opt)
   {
   bgav_t * b = NULL;
   char hash[GAVL_MD5_LENGTH];
@@ -855,25 +1500,33 @@ gavl_packet_index_t * bgav_get_packet_index(const char * url)
   char * cache_dir = NULL;
   gavl_time_t before;
   gavl_time_t duration;
-  struct stat st_uri;
-  struct stat st_idx;
-  
+  int lock_fd = -1;
+  int waited = 0;
+  int threshold = INDEX_CACHE_THRESHOLD_DEFAULT;
+  int cache_size = INDEX_CACHE_SIZE_DEFAULT;
+
+  if(opt)
+    {
+    gavl_dictionary_get_int(opt, BGAV_OPT_INDEX_CACHE_THRESHOLD, &threshold);
+    gavl_dictionary_get_int(opt, BGAV_OPT_INDEX_CACHE_SIZE, &cache_size);
+    }
+
   /* Read cached entry */
   gavl_md5_buffer_str(url, strlen(url), hash);
   
   cache_dir = gavl_search_cache_dir(PACKAGE, NULL, "indices");
   filename = gavl_sprintf("%s/%s", cache_dir, hash);
-  
-  if(!stat(filename, &st_idx) &&
-     !stat(url, &st_uri) &&
-     (st_uri.st_mtime < st_idx.st_mtime) &&
-     (ret = gavl_packet_index_load(filename)))
-    {
-    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Loaded packet index from %s", filename);
-    //    gavl_packet_index_dump(ret);
+
+  if((ret = load_cached_index(filename, url)))
     goto end;
-    }
 
+  if((lock_fd = lock_cached_index(filename, &waited)) >= 0)
+    {
+    /* Might have been built while we waited */
+    if((ret = load_cached_index(filename, url)))
+      goto end;
+    }
+  
   gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Building packet index");
   
   before = gavl_time_get_monotonic();
@@ -893,15 +1546,26 @@ gavl_packet_index_t * bgav_get_packet_index(const char * url)
   
   gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Built packet index in %f seconds", gavl_time_to_seconds(duration));
   //  gavl_packet_index_dump(ret);
-  
-  if(duration > GAVL_TIME_SCALE * 2)
+
+  /* Waiting means the index is shared, so it's always worth saving */
+  if(ret && (lock_fd >= 0) &&
+     (waited || have_index_waiters(lock_fd) ||
+      (duration > gavl_time_unscale(1000, threshold))))
     {
-    gavl_packet_index_save(ret, filename);
-    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Saved packet index to %s", filename);
+    save_cached_index(ret, filename);
+
+    if(cache_size > 0)
+      evict_cached_indices(cache_dir, (int64_t)cache_size * 1024 * 1024);
     }
   
   end:
 
+  if(lock_fd >= 0)
+    {
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+    }
+  
   if(cache_dir)
     free(cache_dir);
   if(filename)
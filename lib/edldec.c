@@ -0,0 +1,637 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  EDL playback.
+ *
+ *  Each stream of the selected track has its own decoder instance for
+ *  the current segment. The decoder for the following segment is
+ *  opened and positioned in a background thread as soon as a segment
+ *  becomes current, so switching segments doesn't stall.
+ *
+ *  Segment times are converted to the output timescale (samplerate or
+ *  video timescale of the first segment) when the track is selected.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "edldec"
+
+/* Samples per audio frame */
+#define AUDIO_FRAME_SIZE 1024
+
+typedef struct
+  {
+  const char * url;
+  int track;
+  int stream;
+  int timescale;
+  int64_t src_time;     /* Timescale of the segment    */
+  int64_t dst_time;     /* Output timescale            */
+  int64_t dst_duration; /* Output timescale            */
+  } segment_t;
+
+typedef struct
+  {
+  bgav_t * b;
+  gavl_audio_source_t * asrc;
+  gavl_video_source_t * vsrc;
+  int seg;              /* -1 if closed                */
+  int64_t start;        /* Source pts of src_time       */
+  int eof;
+  } source_t;
+
+typedef struct
+  {
+  bgav_edl_dec_t * dec;
+
+  gavl_stream_type_t type;
+
+  int num_segments;
+  segment_t * segments;
+
+  int cur_seg;
+  source_t cur;
+  source_t next;
+
+  pthread_t preload_thread;
+  int preloading;
+
+  int64_t time;      /* Output time */
+  int64_t skip_time; /* Video frames before this are skipped after seeking */
+  int timescale;     /* Output timescale */
+
+  gavl_audio_format_t afmt;
+  gavl_video_format_t vfmt;
+  gavl_audio_frame_t * aframe;
+
+  gavl_audio_source_t * out_asrc;
+  gavl_video_source_t * out_vsrc;
+  } stream_t;
+
+struct bgav_edl_dec_s
+  {
+  gavl_dictionary_t edl;
+  bgav_options_t opt;
+
+  int num_audio_streams;
+  int num_video_streams;
+  stream_t * streams;
+  };
+
+/* Sources */
+
+static void source_init(source_t * src)
+  {
+  memset(src, 0, sizeof(*src));
+  src->seg = -1;
+  }
+
+static void source_close(source_t * src)
+  {
+  if(src->b)
+    bgav_close(src->b);
+  source_init(src);
+  }
+
+/* Open the source for a segment and position it offset (output timescale) after the segment start */
+
+static int source_open(stream_t * es, source_t * src, int seg, int64_t offset)
+  {
+  int64_t t;
+  int64_t target;
+  int64_t start;
+  int start_scale;
+  const segment_t * sg = &es->segments[seg];
+
+  source_init(src);
+
+  src->b = bgav_create();
+  bgav_options_copy(bgav_get_options(src->b), &es->dec->opt);
+
+  if(!bgav_open(src->b, sg->url) ||
+     !bgav_select_track(src->b, sg->track))
+    goto fail;
+
+  if(es->type == GAVL_STREAM_AUDIO)
+    {
+    if(!bgav_set_audio_stream(src->b, sg->stream, BGAV_STREAM_DECODE))
+      goto fail;
+    }
+  else if(!bgav_set_video_stream(src->b, sg->stream, BGAV_STREAM_DECODE))
+    goto fail;
+
+  if(!bgav_start(src->b))
+    goto fail;
+
+  /* Segment times count from the start of the source stream, which
+     doesn't need to be at pts 0 */
+  if(es->type == GAVL_STREAM_AUDIO)
+    {
+    start = bgav_audio_start_time(src->b, sg->stream);
+    start_scale = bgav_get_audio_format(src->b, sg->stream)->samplerate;
+    }
+  else
+    {
+    start = bgav_video_start_time(src->b, sg->stream);
+    start_scale = bgav_get_video_format(src->b, sg->stream)->timescale;
+    }
+
+  if(start == GAVL_TIME_UNDEFINED)
+    start = 0;
+  
+  src->start = start + gavl_time_rescale(sg->timescale, start_scale, sg->src_time);
+  
+  target = gavl_time_rescale(start_scale, sg->timescale, start) + sg->src_time;
+  if(offset > 0)
+    target += gavl_time_rescale(es->timescale, sg->timescale, offset);
+
+  t = gavl_time_rescale(start_scale, sg->timescale, start);
+  
+  if(target > t)
+    {
+    t = target;
+    if(!bgav_can_seek(src->b) ||
+       !bgav_seek_scaled(src->b, &t, sg->timescale))
+      goto fail;
+    }
+
+  if(es->type == GAVL_STREAM_AUDIO)
+    {
+    const gavl_audio_format_t * fmt;
+
+    src->asrc = bgav_get_audio_source(src->b, sg->stream);
+    fmt = gavl_audio_source_get_src_format(src->asrc);
+
+    /* Make it sample accurate if the demuxer could not */
+    if(t < target)
+      gavl_audio_source_skip(src->asrc,
+                             gavl_time_rescale(sg->timescale, fmt->samplerate,
+                                               target - t));
+    if(es->timescale)
+      gavl_audio_source_set_dst(src->asrc, 0, &es->afmt);
+    }
+  else
+    {
+    src->vsrc = bgav_get_video_source(src->b, sg->stream);
+
+    if(es->timescale)
+      gavl_video_source_set_dst(src->vsrc, 0, &es->vfmt);
+    }
+
+  src->seg = seg;
+  return 1;
+
+  fail:
+
+  gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Opening segment %d (%s) failed",
+           seg, sg->url);
+  source_close(src);
+  return 0;
+  }
+
+/* Preloading */
+
+static void * preload_func(void * data)
+  {
+  stream_t * es = data;
+  source_open(es, &es->next, es->cur_seg + 1, 0);
+  return NULL;
+  }
+
+static void preload_start(stream_t * es)
+  {
+  if(es->cur_seg + 1 >= es->num_segments)
+    return;
+
+  pthread_create(&es->preload_thread, NULL, preload_func, es);
+  es->preloading = 1;
+  }
+
+static void preload_finish(stream_t * es)
+  {
+  if(es->preloading)
+    {
+    pthread_join(es->preload_thread, NULL);
+    es->preloading = 0;
+    }
+  }
+
+static void stream_close_sources(stream_t * es)
+  {
+  preload_finish(es);
+  source_close(&es->cur);
+  source_close(&es->next);
+  }
+
+/* Switch to the next segment */
+
+static void next_segment(stream_t * es)
+  {
+  int64_t offset;
+
+  source_close(&es->cur);
+  preload_finish(es);
+
+  es->cur_seg++;
+
+  if(es->cur_seg >= es->num_segments)
+    {
+    source_close(&es->next);
+    return;
+    }
+
+  if(es->next.seg == es->cur_seg)
+    {
+    es->cur = es->next;
+    source_init(&es->next);
+    }
+  else
+    {
+    source_close(&es->next);
+    offset = es->time - es->segments[es->cur_seg].dst_time;
+    if(!source_open(es, &es->cur, es->cur_seg, offset > 0 ? offset : 0))
+      es->cur.eof = 1;
+    }
+  preload_start(es);
+  }
+
+/* Position a stream at time (output timescale) */
+
+static void stream_seek(stream_t * es, int64_t time)
+  {
+  int i;
+  int64_t offset;
+
+  stream_close_sources(es);
+
+  for(i = 0; i < es->num_segments; i++)
+    {
+    if(time < es->segments[i].dst_time + es->segments[i].dst_duration)
+      break;
+    }
+
+  es->cur_seg = i;
+  es->time = time;
+  es->skip_time = time;
+
+  if(es->cur_seg < es->num_segments)
+    {
+    offset = time - es->segments[i].dst_time;
+    if(!source_open(es, &es->cur, i, offset > 0 ? offset : 0))
+      es->cur.eof = 1;
+    preload_start(es);
+    }
+
+  if(es->out_asrc)
+    gavl_audio_source_reset(es->out_asrc);
+  if(es->out_vsrc)
+    gavl_video_source_reset(es->out_vsrc);
+  }
+
+/* Read callbacks */
+
+static gavl_source_status_t read_audio(void * priv, gavl_audio_frame_t ** frame)
+  {
+  stream_t * es = priv;
+  const segment_t * sg;
+  int64_t end;
+  int num;
+  int result = 0;
+
+  while(1)
+    {
+    if(es->cur_seg >= es->num_segments)
+      return GAVL_SOURCE_EOF;
+
+    sg = &es->segments[es->cur_seg];
+    end = sg->dst_time + sg->dst_duration;
+
+    if(es->time < end)
+      break;
+
+    next_segment(es);
+    }
+
+  num = AUDIO_FRAME_SIZE;
+
+  if(es->time < sg->dst_time)
+    {
+    /* Gap */
+    if(num > sg->dst_time - es->time)
+      num = sg->dst_time - es->time;
+    }
+  else
+    {
+    if(num > end - es->time)
+      num = end - es->time;
+
+    if(es->cur.asrc && !es->cur.eof)
+      {
+      result = gavl_audio_source_read_samples(es->cur.asrc, es->aframe, num);
+      if(result < num)
+        es->cur.eof = 1;
+      }
+    }
+
+  /* Silence for gaps and sources ending before the segment */
+  if(result > 0)
+    num = result;
+  else
+    gavl_audio_frame_mute(es->aframe, &es->afmt);
+
+  es->aframe->valid_samples = num;
+  es->aframe->timestamp = es->time;
+  es->time += num;
+
+  *frame = es->aframe;
+  return GAVL_SOURCE_OK;
+  }
+
+static gavl_source_status_t read_video(void * priv, gavl_video_frame_t ** frame)
+  {
+  stream_t * es = priv;
+  const segment_t * sg;
+  gavl_video_frame_t * f;
+  gavl_source_status_t st;
+  int64_t pts;
+  int64_t duration;
+  int src_scale;
+
+  while(1)
+    {
+    if(es->cur_seg >= es->num_segments)
+      return GAVL_SOURCE_EOF;
+
+    if(!es->cur.vsrc || es->cur.eof)
+      {
+      next_segment(es);
+      continue;
+      }
+
+    sg = &es->segments[es->cur_seg];
+
+    f = NULL;
+    if((st = gavl_video_source_read_frame(es->cur.vsrc, &f)) != GAVL_SOURCE_OK)
+      {
+      if(st == GAVL_SOURCE_AGAIN)
+        return st;
+      es->cur.eof = 1;
+      continue;
+      }
+
+    src_scale = gavl_video_source_get_src_format(es->cur.vsrc)->timescale;
+
+    pts = sg->dst_time +
+      gavl_time_rescale(src_scale, es->timescale, f->timestamp - es->cur.start);
+    duration = gavl_time_rescale(src_scale, es->timescale, f->duration);
+
+    /* Preroll */
+    if((pts < sg->dst_time) || (pts + duration <= es->skip_time))
+      continue;
+
+    if(pts >= sg->dst_time + sg->dst_duration)
+      {
+      es->cur.eof = 1;
+      continue;
+      }
+
+    f->timestamp = pts;
+    f->duration = duration;
+    es->time = pts + duration;
+
+    *frame = f;
+    return GAVL_SOURCE_OK;
+    }
+  }
+
+/* Streams */
+
+static int stream_init(bgav_edl_dec_t * dec, stream_t * es,
+                       const gavl_dictionary_t * s, gavl_stream_type_t type)
+  {
+  int i;
+  int edl_timescale = 0;
+  const gavl_array_t * arr;
+  const gavl_dictionary_t * seg;
+
+  es->dec = dec;
+  es->type = type;
+  source_init(&es->cur);
+  source_init(&es->next);
+
+  gavl_dictionary_get_int(gavl_stream_get_metadata(s),
+                          GAVL_META_STREAM_SAMPLE_TIMESCALE, &edl_timescale);
+
+  if(!(arr = gavl_dictionary_get_array(s, GAVL_EDL_SEGMENTS)) ||
+     !arr->num_entries)
+    return 0;
+
+  es->segments = calloc(arr->num_entries, sizeof(*es->segments));
+
+  for(i = 0; i < arr->num_entries; i++)
+    {
+    if(!(seg = gavl_value_get_dictionary(&arr->entries[i])))
+      return 0;
+
+    gavl_edl_segment_get(seg,
+                         &es->segments[i].track,
+                         &es->segments[i].stream,
+                         &es->segments[i].timescale,
+                         &es->segments[i].src_time,
+                         &es->segments[i].dst_time,
+                         &es->segments[i].dst_duration);
+
+    /* No URL means the file containing the EDL */
+    if(!(es->segments[i].url = gavl_dictionary_get_string(seg, GAVL_META_URI)) &&
+       !(es->segments[i].url = gavl_dictionary_get_string(&dec->edl, GAVL_META_URI)))
+      return 0;
+    }
+  es->num_segments = arr->num_entries;
+
+  /* Open first segment for getting the format */
+  if(!source_open(es, &es->cur, 0, 0))
+    return 0;
+
+  if(type == GAVL_STREAM_AUDIO)
+    {
+    gavl_audio_format_copy(&es->afmt, gavl_audio_source_get_src_format(es->cur.asrc));
+    es->afmt.samples_per_frame = AUDIO_FRAME_SIZE;
+    es->timescale = es->afmt.samplerate;
+    gavl_audio_source_set_dst(es->cur.asrc, 0, &es->afmt);
+
+    es->aframe = gavl_audio_frame_create(&es->afmt);
+    es->out_asrc = gavl_audio_source_create(read_audio, es,
+                                            GAVL_SOURCE_SRC_ALLOC,
+                                            &es->afmt);
+    }
+  else
+    {
+    gavl_video_format_copy(&es->vfmt, gavl_video_source_get_src_format(es->cur.vsrc));
+    es->timescale = es->vfmt.timescale;
+    gavl_video_source_set_dst(es->cur.vsrc, 0, &es->vfmt);
+
+    es->out_vsrc = gavl_video_source_create(read_video, es,
+                                            GAVL_SOURCE_SRC_ALLOC,
+                                            &es->vfmt);
+    }
+
+  if(!edl_timescale)
+    edl_timescale = es->timescale;
+
+  for(i = 0; i < es->num_segments; i++)
+    {
+    es->segments[i].dst_time =
+      gavl_time_rescale(edl_timescale, es->timescale, es->segments[i].dst_time);
+    es->segments[i].dst_duration =
+      gavl_time_rescale(edl_timescale, es->timescale, es->segments[i].dst_duration);
+    }
+
+  preload_start(es);
+  return 1;
+  }
+
+static void stream_free(stream_t * es)
+  {
+  stream_close_sources(es);
+
+  if(es->out_asrc)
+    gavl_audio_source_destroy(es->out_asrc);
+  if(es->out_vsrc)
+    gavl_video_source_destroy(es->out_vsrc);
+  if(es->aframe)
+    gavl_audio_frame_destroy(es->aframe);
+  if(es->segments)
+    free(es->segments);
+  }
+
+static void free_streams(bgav_edl_dec_t * dec)
+  {
+  int i;
+
+  for(i = 0; i < dec->num_audio_streams + dec->num_video_streams; i++)
+    stream_free(&dec->streams[i]);
+
+  if(dec->streams)
+    free(dec->streams);
+
+  dec->streams = NULL;
+  dec->num_audio_streams = 0;
+  dec->num_video_streams = 0;
+  }
+
+/* Public API */
+
+bgav_edl_dec_t * bgav_edl_dec_create(const gavl_dictionary_t * edl,
+                                     const bgav_options_t * opt)
+  {
+  bgav_edl_dec_t * ret = calloc(1, sizeof(*ret));
+
+  gavl_dictionary_copy(&ret->edl, edl);
+
+  if(opt)
+    bgav_options_copy(&ret->opt, opt);
+  else
+    bgav_options_set_defaults(&ret->opt);
+
+  /* Splices must be sample accurate */
+  bgav_options_set_sample_accurate(&ret->opt, 1);
+
+  return ret;
+  }
+
+int bgav_edl_dec_num_tracks(bgav_edl_dec_t * dec)
+  {
+  return gavl_get_num_tracks(&dec->edl);
+  }
+
+int bgav_edl_dec_select_track(bgav_edl_dec_t * dec, int track)
+  {
+  int i;
+  const gavl_dictionary_t * t;
+
+  free_streams(dec);
+
+  if(!(t = gavl_get_track(&dec->edl, track)))
+    return 0;
+
+  dec->num_audio_streams = gavl_track_get_num_audio_streams(t);
+  dec->num_video_streams = gavl_track_get_num_video_streams(t);
+
+  dec->streams = calloc(dec->num_audio_streams + dec->num_video_streams,
+                        sizeof(*dec->streams));
+
+  for(i = 0; i < dec->num_audio_streams; i++)
+    {
+    if(!stream_init(dec, &dec->streams[i],
+                    gavl_track_get_audio_stream(t, i), GAVL_STREAM_AUDIO))
+      goto fail;
+    }
+  for(i = 0; i < dec->num_video_streams; i++)
+    {
+    if(!stream_init(dec, &dec->streams[dec->num_audio_streams + i],
+                    gavl_track_get_video_stream(t, i), GAVL_STREAM_VIDEO))
+      goto fail;
+    }
+  return 1;
+
+  fail:
+  gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Initializing track %d failed", track);
+  free_streams(dec);
+  return 0;
+  }
+
+gavl_audio_source_t * bgav_edl_dec_get_audio_source(bgav_edl_dec_t * dec, int stream)
+  {
+  if((stream < 0) || (stream >= dec->num_audio_streams))
+    return NULL;
+  return dec->streams[stream].out_asrc;
+  }
+
+gavl_video_source_t * bgav_edl_dec_get_video_source(bgav_edl_dec_t * dec, int stream)
+  {
+  if((stream < 0) || (stream >= dec->num_video_streams))
+    return NULL;
+  return dec->streams[dec->num_audio_streams + stream].out_vsrc;
+  }
+
+void bgav_edl_dec_seek(bgav_edl_dec_t * dec, int64_t * time, int scale)
+  {
+  int i;
+  stream_t * es;
+
+  for(i = 0; i < dec->num_audio_streams + dec->num_video_streams; i++)
+    {
+    es = &dec->streams[i];
+    stream_seek(es, gavl_time_rescale(scale, es->timescale, *time));
+    }
+  }
+
+void bgav_edl_dec_destroy(bgav_edl_dec_t * dec)
+  {
+  free_streams(dec);
+  gavl_dictionary_free(&dec->edl);
+  bgav_options_free(&dec->opt);
+  free(dec);
+  }
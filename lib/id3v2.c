@@ -47,6 +47,7 @@ typedef struct
   uint8_t * data; 
   int data_size;
 
+  int64_t data_offset; /* File position if data wasn't loaded */
   } bgav_id3v2_picture_t;
 
 typedef struct
@@ -472,8 +473,14 @@ static char ** read_string_list(uint8_t * data, int data_size)
   return ret;
   }
 
+/*
+ *  If data_size is smaller than frame_size, only the start of the frame
+ *  is available. In this case, the image data is not copied and the
+ *  offset relative to the frame start is returned.
+ */
+
 static bgav_id3v2_picture_t * 
-read_picture(uint8_t * data, int data_size)
+read_picture(uint8_t * data, int data_size, int frame_size)
   {
   int charset;
   int bytes_per_char = 1;
@@ -512,6 +519,17 @@ read_picture(uint8_t * data, int data_size)
       break;
     }
 
+  /* Description exceeds the available data */
+  if((data_size < frame_size) &&
+     (end_pos - (char * )data_start >= data_size))
+    {
+    if(cnv)
+      gavl_charset_converter_destroy(cnv);
+    free(ret->mimetype);
+    free(ret);
+    return NULL;
+    }
+
   if(end_pos > pos)
     {
     if(cnv)
@@ -529,23 +547,37 @@ read_picture(uint8_t * data, int data_size)
 
   data_offset = (pos - (char*)data_start);
   
-  ret->data_size = data_size - data_offset;
+  ret->data_size = frame_size - data_offset;
 
+  if(data_size < frame_size)
+    {
+    ret->data_offset = data_offset;
+    return ret;
+    }
+  
   ret->data = malloc(ret->data_size);
   memcpy(ret->data, pos, ret->data_size);
   return ret;
   }
 
+/* Bytes to read from APIC frames when scanning */
+#define PICTURE_PREFIX 1024
+
 static int read_frame(bgav_input_context_t * input,
                       bgav_id3v2_frame_t * ret,
                       uint8_t * probe_data,
-                      const id3v2_header_t * tag_header)
+                      const id3v2_header_t * tag_header,
+                      int64_t frames_start, int scan)
   {
   uint8_t buf[4];
   uint8_t * data;
+  int64_t data_pos;
   int do_unsync = 0;
+  int bytes_read = 0;
+  int64_t frame_start = input->position - 3;
   
-  ret->header.start = input->position - 3; 
+  /* Relative to the tag start */
+  ret->header.start = frame_start - frames_start + tag_header->header_size; 
  
   if(tag_header->major_version < 4)
     {
@@ -605,7 +637,7 @@ static int read_frame(bgav_input_context_t * input,
   if(ret->header.data_size > input->total_bytes - input->position)
     return 0;
 
-  ret->header.header_size = input->position - ret->header.start;
+  ret->header.header_size = input->position - frame_start;
 
   switch(tag_header->major_version)
     {
@@ -620,9 +652,38 @@ static int read_frame(bgav_input_context_t * input,
       break;
     }
 
-  data = calloc(ret->header.data_size+2, 1);
-  if(bgav_input_read_data(input, data, ret->header.data_size) <
-     ret->header.data_size)
+  /* When scanning, don't load cover images */
+  if(scan && !do_unsync &&
+     (ret->header.fourcc == BGAV_MK_FOURCC('A', 'P', 'I', 'C')) &&
+     (ret->header.data_size > PICTURE_PREFIX))
+    {
+    data_pos = input->position;
+    data = calloc(PICTURE_PREFIX+2, 1);
+    
+    if(bgav_input_read_data(input, data, PICTURE_PREFIX) < PICTURE_PREFIX)
+      {
+      free(data);
+      return 0;
+      }
+    bytes_read = PICTURE_PREFIX;
+    
+    if((ret->picture = read_picture(data, PICTURE_PREFIX, ret->header.data_size)))
+      {
+      ret->picture->data_offset += data_pos;
+      bgav_input_skip(input, ret->header.data_size - PICTURE_PREFIX);
+      free(data);
+      return 1;
+      }
+    /* Fall back to reading the whole frame */
+    data = realloc(data, ret->header.data_size+2);
+    data[ret->header.data_size] = 0x00;
+    data[ret->header.data_size+1] = 0x00;
+    }
+  else
+    data = calloc(ret->header.data_size+2, 1);
+  
+  if(bgav_input_read_data(input, data + bytes_read, ret->header.data_size - bytes_read) <
+     ret->header.data_size - bytes_read)
     return 0;
   
   if(do_unsync)
@@ -669,7 +730,7 @@ static int read_frame(bgav_input_context_t * input,
   else if(ret->header.fourcc == BGAV_MK_FOURCC('A', 'P', 'I', 'C'))
     {
     if(ret->header.data_size > 2)
-      ret->picture = read_picture(data, ret->header.data_size);
+      ret->picture = read_picture(data, ret->header.data_size, ret->header.data_size);
     }
   else /* Copy raw data */
     {
@@ -680,8 +741,6 @@ static int read_frame(bgav_input_context_t * input,
   if(data)
     free(data);
 
-  ret->header.start += tag_header->header_size;
-
 //  dump_frame(ret);  
   return 1;
   }
@@ -693,9 +752,13 @@ bgav_id3v2_tag_t * bgav_id3v2_read(bgav_input_context_t * input)
   uint8_t probe_data[3];
   int64_t tag_start_pos;
   int frames_alloc = 0;
-  bgav_input_context_t * input_mem;
-  uint8_t * data;
+  bgav_input_context_t * input_mem = NULL;
+  bgav_input_context_t * frames_input;
+  int64_t frames_start;
+  int64_t frames_end;
+  uint8_t * data = NULL;
   int data_size;
+  int scan;
 
   int64_t start = input->position;
       
@@ -735,18 +798,35 @@ bgav_id3v2_tag_t * bgav_id3v2_read(bgav_input_context_t * input)
   /* Read frames */
 
   data_size = tag_start_pos + ret->header.data_size - input->position;
-  data = malloc(data_size);
-  if(bgav_input_read_data(input, data, data_size) < data_size)
-    goto fail;
 
-  input_mem = bgav_input_open_memory(data, data_size);
+  /* When scanning, we read the frames directly from the file so we can
+     skip the cover images */
+  scan = input->b && (input->b->flags & BGAV_FLAG_SCAN) && input->total_bytes;
+  
+  if(scan)
+    {
+    frames_input = input;
+    frames_start = input->position;
+    }
+  else
+    {
+    data = malloc(data_size);
+    if(bgav_input_read_data(input, data, data_size) < data_size)
+      goto fail;
     
-  while(input_mem->position < data_size)
+    input_mem = bgav_input_open_memory(data, data_size);
+    frames_input = input_mem;
+    frames_start = 0;
+    }
+
+  frames_end = frames_start + data_size;
+  
+  while(frames_input->position < frames_end)
     {
-    if(input_mem->position >= data_size - 4)
+    if(frames_input->position >= frames_end - 4)
       break;
     
-    if(bgav_input_read_data(input_mem, probe_data, 3) < 3)
+    if(bgav_input_read_data(frames_input, probe_data, 3) < 3)
       goto fail;
 
     if(!probe_data[0] && !probe_data[1] && !probe_data[2])
@@ -756,7 +836,7 @@ bgav_id3v2_tag_t * bgav_id3v2_read(bgav_input_context_t * input)
             (probe_data[1] == 'D') && 
             (probe_data[2] == 'I'))
       {
-      bgav_input_skip(input_mem, 7);
+      bgav_input_skip(frames_input, 7);
       break;
       }
     if(frames_alloc < ret->num_frames + 1)
@@ -767,21 +847,34 @@ bgav_id3v2_tag_t * bgav_id3v2_read(bgav_input_context_t * input)
              FRAMES_TO_ALLOC * sizeof(*ret->frames));
       }
     
-    if(!read_frame(input_mem,
+    if(!read_frame(frames_input,
                    &ret->frames[ret->num_frames],
                    probe_data,
-                   &ret->header))
+                   &ret->header,
+                   frames_start, scan))
       {
       free_frame(&ret->frames[ret->num_frames]);
       break;
       }
     ret->num_frames++;
     }
-  bgav_input_close(input_mem);
-  bgav_input_destroy(input_mem);
-  free(data);
+
+  if(input_mem)
+    {
+    bgav_input_close(input_mem);
+    bgav_input_destroy(input_mem);
+    free(data);
+    }
   
   ret->total_bytes = ret->header.data_size + 10;
+
+  /* Skip padding */
+  
+  if(tag_start_pos + ret->header.data_size > input->position)
+    {
+    bgav_input_skip(input, tag_start_pos + ret->header.data_size - input->position);
+    }
+  
   /* Read footer */
   
   if(ret->header.flags & ID3V2_TAG_FOOTER_PRESENT)
@@ -789,13 +882,6 @@ bgav_id3v2_tag_t * bgav_id3v2_read(bgav_input_context_t * input)
     bgav_input_skip(input, 10);
     ret->total_bytes += 10;
     }
-
-  /* Skip padding */
-  
-  else if(tag_start_pos + ret->header.data_size > input->position)
-    {
-    bgav_input_skip(input, tag_start_pos + ret->header.data_size - input->position);
-    }
   //  bgav_id3v2_dump(ret);
   return ret;
 
@@ -1223,7 +1309,7 @@ void bgav_id3v2_2_metadata(bgav_id3v2_tag_t * t, gavl_dictionary_t*m)
   if(!frame)
     frame = bgav_id3v2_find_frame(t, cover_tags);
   
-  if(frame && frame->picture)
+  if(frame && frame->picture && frame->picture->data)
     {
     /* TODO: Replace this by image buffer */
     gavl_metadata_add_image_embedded(m, GAVL_META_COVER_EMBEDDED, 
@@ -1231,6 +1317,13 @@ void bgav_id3v2_2_metadata(bgav_id3v2_tag_t * t, gavl_dictionary_t*m)
                                      frame->picture->data,
                                      frame->picture->data_size);
     }
+  else if(frame && frame->picture && frame->picture->data_offset)
+    {
+    /* Not loaded (see bgav_open_scan()) */
+    gavl_dictionary_set_long(m, BGAV_META_COVER_OFFSET, frame->picture->data_offset);
+    gavl_dictionary_set_int(m, BGAV_META_COVER_SIZE, frame->picture->data_size);
+    gavl_dictionary_set_string(m, BGAV_META_COVER_MIMETYPE, frame->picture->mimetype);
+    }
 
   /* TXXX and WXXX */
   for(i = 0; i < t->num_frames; i++)
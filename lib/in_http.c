@@ -33,9 +33,23 @@
 
 /* Generic http input module */
 
-/* Streams with a content-length smaller than this will be
-   downloaded at once and buffered */
-#define MAX_DOWNLOAD_SIZE (100*1024*1024)
+/*
+ *  Seekable resources with a known size are read in blocks, which
+ *  are kept in an LRU cache. Blocks are fetched with range requests.
+ *  Sequential blocks are read from the running response, so only
+ *  seeking to an uncached block starts a new request.
+ */
+
+#define BLOCK_SIZE (256*1024)
+#define CACHE_SIZE_DEFAULT 16 /* Megabytes */
+
+typedef struct
+  {
+  int64_t index; /* -1 if unused */
+  int64_t last_use;
+  int len;
+  uint8_t * data;
+  } block_t;
 
 typedef struct
   {
@@ -47,8 +61,13 @@ typedef struct
   gavl_charset_converter_t * charset_cnv;
   int64_t bytes_read;
 
-  gavl_buffer_t buffer;
-  
+  /* Block cache */
+  block_t * blocks;
+  int num_blocks;
+  int64_t use_counter;
+
+  int64_t pos;    /* Read position                    */
+  int64_t io_pos; /* Position of the running response */
   } http_priv;
 
 static void create_header(gavl_dictionary_t * ret, const bgav_options_t * opt)
@@ -187,6 +206,132 @@ static void set_metadata(const gavl_dictionary_t * header, gavl_dictionary_t * m
   }
 
 
+/* Block cache */
+
+static int init_cache(bgav_input_context_t * ctx)
+  {
+  int i;
+  int cache_size = CACHE_SIZE_DEFAULT;
+  http_priv * p = ctx->priv;
+
+  gavl_dictionary_get_int(&ctx->opt, BGAV_OPT_HTTP_CACHE_SIZE, &cache_size);
+
+  if(cache_size <= 0)
+    return 0;
+
+  p->num_blocks = (int)(((int64_t)cache_size * 1024 * 1024) / BLOCK_SIZE);
+  if(p->num_blocks < 2)
+    p->num_blocks = 2;
+
+  p->blocks = calloc(p->num_blocks, sizeof(*p->blocks));
+  for(i = 0; i < p->num_blocks; i++)
+    p->blocks[i].index = -1;
+
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Using block cache with %d blocks",
+           p->num_blocks);
+  return 1;
+  }
+
+static block_t * get_block(bgav_input_context_t * ctx, int64_t index)
+  {
+  int i;
+  int len;
+  int result;
+  int bytes;
+  int64_t start;
+  block_t * ret = NULL;
+  http_priv * p = ctx->priv;
+
+  /* Cache hit or least recently used block */
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    if(p->blocks[i].index == index)
+      {
+      p->blocks[i].last_use = ++p->use_counter;
+      return &p->blocks[i];
+      }
+    if(!ret || (p->blocks[i].last_use < ret->last_use))
+      ret = &p->blocks[i];
+    }
+
+  start = index * BLOCK_SIZE;
+
+  if(start >= ctx->total_bytes)
+    return NULL;
+
+  len = BLOCK_SIZE;
+  if(len > ctx->total_bytes - start)
+    len = ctx->total_bytes - start;
+
+  /* Continue the running response for sequential reads */
+  if(p->io_pos != start)
+    {
+    gavl_io_seek(p->io, start, SEEK_SET);
+    p->io_pos = start;
+    }
+
+  if(!ret->data)
+    ret->data = malloc(BLOCK_SIZE);
+
+  ret->index = -1;
+
+  /* The response can arrive in pieces */
+  bytes = 0;
+  while(bytes < len)
+    {
+    if((result = gavl_io_read_data(p->io, ret->data + bytes, len - bytes)) <= 0)
+      break;
+    bytes += result;
+    }
+
+  if(bytes < len)
+    {
+    /* Force a new request next time */
+    p->io_pos = -1;
+    if(!bytes)
+      return NULL;
+    }
+  else
+    {
+    p->io_pos += bytes;
+    
+    /* Cache only complete blocks, a short read might be a transient error */
+    ret->index = index;
+    }
+  
+  ret->len = bytes;
+  ret->last_use = ++p->use_counter;
+  return ret;
+  }
+
+static int read_cached(bgav_input_context_t * ctx, uint8_t * buffer, int len)
+  {
+  int offset;
+  int bytes;
+  int bytes_read = 0;
+  block_t * b;
+  http_priv * p = ctx->priv;
+
+  while(bytes_read < len)
+    {
+    if(!(b = get_block(ctx, p->pos / BLOCK_SIZE)))
+      break;
+
+    offset = p->pos % BLOCK_SIZE;
+    if(offset >= b->len)
+      break;
+
+    bytes = b->len - offset;
+    if(bytes > len - bytes_read)
+      bytes = len - bytes_read;
+
+    memcpy(buffer + bytes_read, b->data + offset, bytes);
+    bytes_read += bytes;
+    p->pos += bytes;
+    }
+  return bytes_read;
+  }
+
 static int open_http(bgav_input_context_t * ctx, const char * url1, char ** r)
   {
   int ret = 0;
@@ -234,7 +379,12 @@ static int open_http(bgav_input_context_t * ctx, const char * url1, char ** r)
     }
 
   if(gavl_io_can_seek(p->io))
-    ctx->flags |= (BGAV_INPUT_SEEK_SLOW | BGAV_INPUT_CAN_PAUSE);
+    {
+    if(!p->icy_metaint && (ctx->total_bytes > 0) && init_cache(ctx))
+      ctx->flags |= BGAV_INPUT_CAN_PAUSE;
+    else
+      ctx->flags |= (BGAV_INPUT_SEEK_SLOW | BGAV_INPUT_CAN_PAUSE);
+    }
   else
     ctx->flags &= ~BGAV_INPUT_CAN_SEEK_BYTE;
   
@@ -251,7 +401,11 @@ static int64_t seek_byte_http(bgav_input_context_t * ctx,
   {
   http_priv * p = ctx->priv;
   //  fprintf(stderr, "seek_byte_http %"PRId64" %"PRId64"\n", pos, ctx->position);
-  gavl_io_seek(p->io, pos, whence);
+
+  if(p->blocks)
+    p->pos = ctx->position;
+  else
+    gavl_io_seek(p->io, pos, whence);
   return ctx->position;
   }
 
@@ -412,6 +566,10 @@ static int do_read(bgav_input_context_t* ctx,
 static int read_http(bgav_input_context_t* ctx,
                      uint8_t * buffer, int len)
   {
+  http_priv * p = ctx->priv;
+
+  if(p->blocks)
+    return read_cached(ctx, buffer, len);
   return do_read(ctx, buffer, len);
   }
 
@@ -425,6 +583,17 @@ static void close_http(bgav_input_context_t * ctx)
   
   if(p->charset_cnv)
     gavl_charset_converter_destroy(p->charset_cnv);
+
+  if(p->blocks)
+    {
+    int i;
+    for(i = 0; i < p->num_blocks; i++)
+      {
+      if(p->blocks[i].data)
+        free(p->blocks[i].data);
+      }
+    free(p->blocks);
+    }
   free(p);
   }
 
@@ -0,0 +1,705 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  MPEG-TS over UDP (unicast or multicast), raw or RTP encapsulated
+ *  (RFC 2250)
+ *
+ *  udp://[@]host:port
+ *  rtp://[@]host:port
+ *
+ *  RTP headers are detected for each datagram, so both URLs work for
+ *  both variants. For RTP, the reception statistics from RFC 3550 are
+ *  maintained.
+ *
+ *  A receiver thread pulls datagrams into a preallocated ring of slots
+ *  (many per syscall with recvmmsg if available). The ring has exactly
+ *  one writer and one reader, so the hand-off is done with atomic
+ *  indices only. The mutex and condition are only used for waiting
+ *  when the ring is empty.
+ */
+
+#define _GNU_SOURCE
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <avdec_private.h>
+#include <gavl/gavlsocket.h>
+
+#define LOG_DOMAIN "in_udp"
+
+extern const bgav_demuxer_t bgav_demuxer_mpegts2;
+
+#ifdef HAVE_RECVMMSG
+typedef struct mmsghdr msg_t;
+#else
+typedef struct
+  {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+  } msg_t;
+#endif
+
+/* Must be a power of 2 */
+#define NUM_SLOTS   2048
+
+/* Large enough for 7 TS packets (1316 bytes) on standard MTUs */
+#define SLOT_BYTES  2048
+
+/* Maximum number of datagrams per syscall */
+#define BATCH_SIZE  64
+
+#define POLL_TIMEOUT 100  /* Milliseconds, for checking the quit flag */
+#define READ_TIMEOUT 5000 /* Milliseconds */
+
+#define RCVBUF_DEFAULT (4*1024*1024)
+
+/* RFC 3550, appendix A.1 */
+#define RTP_SEQ_MOD      (1<<16)
+#define RTP_MAX_DROPOUT  3000
+#define RTP_MAX_MISORDER 100
+
+/* RTP clock rate for MPEG-2 transport streams */
+#define RTP_CLOCK_RATE   90000
+
+typedef struct
+  {
+  int start; /* Payload start (after the RTP header) */
+  int len;   /* Payload length */
+  uint8_t data[SLOT_BYTES];
+  } slot_t;
+
+/* RTP receiver state, see RFC 3550, appendix A */
+
+typedef struct
+  {
+  uint16_t max_seq;
+  uint32_t cycles;
+  uint32_t base_seq;
+  uint32_t bad_seq;
+
+  int64_t received;
+  
+  int32_t transit;
+  uint32_t jitter; /* Scaled by 16 */
+  } rtp_state_t;
+
+typedef struct
+  {
+  int fd;
+
+  slot_t * slots;
+  
+  /* Free running counters, slot index is counter % NUM_SLOTS */
+  uint32_t write_idx; /* Written by the receiver thread */
+  uint32_t read_idx;  /* Written by the reader */
+
+  /* Read offset in the current slot */
+  int read_pos;
+  
+  pthread_t thread;
+  int quit;
+  int running;
+  
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int waiting;
+
+  /* Statistics */
+  int64_t datagrams;
+  int64_t overruns;     /* Dropped because the ring was full */
+  int64_t truncated;    /* Datagrams larger than SLOT_BYTES */
+  int64_t kernel_drops; /* Dropped by the kernel (socket buffer full) */
+
+  rtp_state_t rtp;
+  pthread_mutex_t rtp_mutex; /* Protects rtp */
+  
+  msg_t msgs[BATCH_SIZE];
+  struct iovec iov[BATCH_SIZE];
+#ifdef SO_RXQ_OVFL
+  uint8_t cmsg[BATCH_SIZE][CMSG_SPACE(sizeof(uint32_t))];
+#endif
+  
+  slot_t scratch;
+  } udp_priv_t;
+
+/* Parse udp://[@]host:port or udp://[@][ipv6]:port (same for rtp://) */
+
+static int parse_url(const char * url, char ** host, int * port)
+  {
+  const char * pos;
+  const char * end;
+  
+  if(!gavl_string_starts_with(url, "udp://") &&
+     !gavl_string_starts_with(url, "rtp://"))
+    return 0;
+  
+  pos = url + 6;
+  
+  if(*pos == '@')
+    pos++;
+
+  if(*pos == '[')
+    {
+    pos++;
+    if(!(end = strchr(pos, ']')))
+      return 0;
+    *host = gavl_strndup(pos, end);
+    end++;
+    }
+  else
+    {
+    if(!(end = strrchr(pos, ':')))
+      return 0;
+    *host = gavl_strndup(pos, end);
+    }
+  
+  if(*end != ':')
+    return 0;
+
+  *port = atoi(end + 1);
+
+  if(**host == '\0')
+    {
+    free(*host);
+    *host = gavl_strdup("0.0.0.0");
+    }
+  
+  return (*port > 0) && (*port < 65536);
+  }
+
+/* Receive up to num datagrams into the iovecs set up by the caller */
+
+static int receive_batch(udp_priv_t * p, int num)
+  {
+  int i;
+#ifdef HAVE_RECVMMSG
+  int result;
+  
+  for(i = 0; i < num; i++)
+    {
+#ifdef SO_RXQ_OVFL
+    p->msgs[i].msg_hdr.msg_control = p->cmsg[i];
+    p->msgs[i].msg_hdr.msg_controllen = sizeof(p->cmsg[i]);
+#endif
+    p->msgs[i].msg_hdr.msg_flags = 0;
+    }
+  
+  result = recvmmsg(p->fd, p->msgs, num, MSG_DONTWAIT, NULL);
+  return (result < 0) ? 0 : result;
+#else
+  ssize_t result;
+  
+  for(i = 0; i < num; i++)
+    {
+#ifdef SO_RXQ_OVFL
+    p->msgs[i].msg_hdr.msg_control = p->cmsg[i];
+    p->msgs[i].msg_hdr.msg_controllen = sizeof(p->cmsg[i]);
+#endif
+    p->msgs[i].msg_hdr.msg_flags = 0;
+    
+    if((result = recvmsg(p->fd, &p->msgs[i].msg_hdr, MSG_DONTWAIT)) < 0)
+      break;
+    p->msgs[i].msg_len = result;
+    }
+  return i;
+#endif
+  }
+
+/* Evaluate flags and ancillary data of a received datagram */
+
+static void check_msg(udp_priv_t * p, struct msghdr * msg)
+  {
+#ifdef SO_RXQ_OVFL
+  struct cmsghdr * cmsg;
+  uint32_t drops;
+  
+  for(cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+    if((cmsg->cmsg_level == SOL_SOCKET) &&
+       (cmsg->cmsg_type == SO_RXQ_OVFL))
+      {
+      /* The kernel reports the total count */
+      memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+      
+      if(drops > p->kernel_drops)
+        {
+        gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+                 "Kernel dropped %"PRId64" datagrams, consider a larger receive buffer",
+                 drops - p->kernel_drops);
+        p->kernel_drops = drops;
+        }
+      }
+    }
+#endif
+  
+  if(msg->msg_flags & MSG_TRUNC)
+    p->truncated++;
+  }
+
+/* Update the statistics for a received RTP packet (RFC 3550, appendix A.1 and A.8) */
+
+static void update_rtp_state(rtp_state_t * s, uint16_t seq, uint32_t timestamp,
+                             uint32_t arrival)
+  {
+  uint16_t udelta;
+  int32_t transit;
+  int32_t d;
+  
+  if(!s->received)
+    {
+    s->base_seq = seq;
+    s->max_seq = seq;
+    s->bad_seq = RTP_SEQ_MOD + 1;
+    s->cycles = 0;
+    }
+  else
+    {
+    udelta = seq - s->max_seq;
+
+    if(udelta < RTP_MAX_DROPOUT)
+      {
+      /* In order, with permissible gap */
+      if(seq < s->max_seq)
+        s->cycles += RTP_SEQ_MOD;
+      s->max_seq = seq;
+      }
+    else if(udelta <= RTP_SEQ_MOD - RTP_MAX_MISORDER)
+      {
+      /* Large jump: Restart if the next packet follows it */
+      if(seq == s->bad_seq)
+        {
+        s->base_seq = seq;
+        s->max_seq = seq;
+        s->cycles = 0;
+        s->received = 0;
+        }
+      else
+        {
+        s->bad_seq = (seq + 1) & (RTP_SEQ_MOD-1);
+        return;
+        }
+      }
+    /* Else duplicate or reordered packet */
+    }
+  
+  s->received++;
+
+  /* Interarrival jitter */
+  transit = arrival - timestamp;
+
+  if(s->received > 1)
+    {
+    d = transit - s->transit;
+    if(d < 0)
+      d = -d;
+    s->jitter += d - ((s->jitter + 8) >> 4);
+    }
+  s->transit = transit;
+  }
+
+/*
+ *  Strip the RTP header. Datagrams starting with a TS sync byte are
+ *  raw transport streams
+ */
+
+static void handle_rtp(udp_priv_t * p, slot_t * slot, uint32_t arrival)
+  {
+  int hdr_len;
+  uint8_t * data = slot->data;
+  
+  slot->start = 0;
+  
+  if((slot->len < 12) || (data[0] == 0x47) || ((data[0] >> 6) != 2))
+    return;
+
+  hdr_len = 12 + 4 * (data[0] & 0x0f);
+
+  /* Extension */
+  if((data[0] & 0x10) && (slot->len >= hdr_len + 4))
+    hdr_len += 4 + 4 * GAVL_PTR_2_16BE(data + hdr_len + 2);
+
+  /* Padding */
+  if(data[0] & 0x20)
+    slot->len -= data[slot->len - 1];
+  
+  if(hdr_len > slot->len)
+    {
+    slot->len = 0;
+    return;
+    }
+
+  slot->start = hdr_len;
+  slot->len -= hdr_len;
+  
+  update_rtp_state(&p->rtp, GAVL_PTR_2_16BE(data + 2),
+                   GAVL_PTR_2_32BE(data + 4), arrival);
+  }
+
+/* Arrival time in RTP timestamp units */
+
+static uint32_t get_arrival_time()
+  {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((int64_t)ts.tv_sec * RTP_CLOCK_RATE +
+                    (int64_t)ts.tv_nsec * RTP_CLOCK_RATE / 1000000000);
+  }
+
+static void * receiver_thread(void * data)
+  {
+  int i;
+  int num;
+  int result;
+  uint32_t write_idx;
+  uint32_t used;
+  uint32_t arrival;
+  struct pollfd pfd;
+  udp_priv_t * p = data;
+
+  pfd.fd = p->fd;
+  pfd.events = POLLIN;
+  
+  while(!__atomic_load_n(&p->quit, __ATOMIC_ACQUIRE))
+    {
+    if(poll(&pfd, 1, POLL_TIMEOUT) <= 0)
+      continue;
+
+    write_idx = p->write_idx;
+    used = write_idx - __atomic_load_n(&p->read_idx, __ATOMIC_ACQUIRE);
+    
+    if(used == NUM_SLOTS)
+      {
+      /* Ring is full: Drain the socket and count the losses */
+      for(i = 0; i < BATCH_SIZE; i++)
+        {
+        p->iov[i].iov_base = p->scratch.data;
+        p->iov[i].iov_len  = SLOT_BYTES;
+        }
+      result = receive_batch(p, BATCH_SIZE);
+
+      if(result && !p->overruns)
+        gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Ring buffer overrun, dropping datagrams");
+      
+      p->overruns += result;
+      continue;
+      }
+
+    /* Receive into consecutive free slots */
+    num = NUM_SLOTS - used;
+    if(num > NUM_SLOTS - (write_idx % NUM_SLOTS))
+      num = NUM_SLOTS - (write_idx % NUM_SLOTS);
+    if(num > BATCH_SIZE)
+      num = BATCH_SIZE;
+
+    for(i = 0; i < num; i++)
+      {
+      p->iov[i].iov_base = p->slots[(write_idx + i) % NUM_SLOTS].data;
+      p->iov[i].iov_len  = SLOT_BYTES;
+      }
+    
+    if(!(result = receive_batch(p, num)))
+      continue;
+
+    /* A batch is taken from the socket at once, so the arrival time of
+       the first datagram is used for all */
+    arrival = get_arrival_time();
+    
+    pthread_mutex_lock(&p->rtp_mutex);
+    
+    for(i = 0; i < result; i++)
+      {
+      p->slots[(write_idx + i) % NUM_SLOTS].len = p->msgs[i].msg_len;
+      check_msg(p, &p->msgs[i].msg_hdr);
+      handle_rtp(p, &p->slots[(write_idx + i) % NUM_SLOTS], arrival);
+      }
+
+    pthread_mutex_unlock(&p->rtp_mutex);
+    
+    p->datagrams += result;
+    
+    /*
+     *  Store write_idx, then load waiting. wait_data() does the same
+     *  the other way round. Only sequential consistency guarantees that
+     *  at least one side sees the other's store, so no wakeup gets lost.
+     */
+    __atomic_store_n(&p->write_idx, write_idx + result, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&p->waiting, __ATOMIC_SEQ_CST))
+      {
+      pthread_mutex_lock(&p->mutex);
+      pthread_cond_signal(&p->cond);
+      pthread_mutex_unlock(&p->mutex);
+      }
+    }
+  return NULL;
+  }
+
+/* Wait until data is available. Return 0 on timeout */
+
+static int wait_data(udp_priv_t * p, int timeout)
+  {
+  struct timespec ts;
+  struct timeval tv;
+  int ret = 1;
+  
+  if(p->read_idx != __atomic_load_n(&p->write_idx, __ATOMIC_ACQUIRE))
+    return 1;
+
+  if(!timeout)
+    return 0;
+  
+  gettimeofday(&tv, NULL);
+  ts.tv_sec  = tv.tv_sec + timeout / 1000;
+  ts.tv_nsec = tv.tv_usec * 1000 + (timeout % 1000) * 1000000;
+  if(ts.tv_nsec >= 1000000000)
+    {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+    }
+  
+  pthread_mutex_lock(&p->mutex);
+  __atomic_store_n(&p->waiting, 1, __ATOMIC_SEQ_CST);
+  
+  while(p->read_idx == __atomic_load_n(&p->write_idx, __ATOMIC_SEQ_CST))
+    {
+    if(pthread_cond_timedwait(&p->cond, &p->mutex, &ts) == ETIMEDOUT)
+      {
+      ret = (p->read_idx != __atomic_load_n(&p->write_idx, __ATOMIC_ACQUIRE));
+      break;
+      }
+    }
+  
+  __atomic_store_n(&p->waiting, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&p->mutex);
+  return ret;
+  }
+
+static int do_read_udp(bgav_input_context_t * ctx, uint8_t * buffer, int len, int block)
+  {
+  int bytes_read = 0;
+  int bytes_to_copy;
+  slot_t * slot;
+  udp_priv_t * p = ctx->priv;
+
+  while(bytes_read < len)
+    {
+    if(!wait_data(p, block ? READ_TIMEOUT : 0))
+      {
+      if(block)
+        gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Got no data for %d ms", READ_TIMEOUT);
+      break;
+      }
+    
+    slot = &p->slots[p->read_idx % NUM_SLOTS];
+
+    bytes_to_copy = slot->len - p->read_pos;
+    if(bytes_to_copy > len - bytes_read)
+      bytes_to_copy = len - bytes_read;
+
+    memcpy(buffer + bytes_read, slot->data + slot->start + p->read_pos, bytes_to_copy);
+    bytes_read += bytes_to_copy;
+    p->read_pos += bytes_to_copy;
+
+    if(p->read_pos >= slot->len)
+      {
+      p->read_pos = 0;
+      __atomic_store_n(&p->read_idx, p->read_idx + 1, __ATOMIC_RELEASE);
+      }
+    }
+  return bytes_read;
+  }
+
+static int read_udp(bgav_input_context_t * ctx, uint8_t * buffer, int len)
+  {
+  return do_read_udp(ctx, buffer, len, 1);
+  }
+
+static int read_nonblock_udp(bgav_input_context_t * ctx, uint8_t * buffer, int len)
+  {
+  return do_read_udp(ctx, buffer, len, 0);
+  }
+
+static int can_read_udp(bgav_input_context_t * ctx, int timeout)
+  {
+  return wait_data(ctx->priv, timeout);
+  }
+
+static int get_rtp_stats_udp(bgav_input_context_t * ctx, bgav_rtp_stats_t * stats)
+  {
+  udp_priv_t * p = ctx->priv;
+  int ret = 0;
+  
+  pthread_mutex_lock(&p->rtp_mutex);
+
+  if(p->rtp.received)
+    {
+    stats->packets_received = p->rtp.received;
+    stats->highest_seq = p->rtp.cycles + p->rtp.max_seq;
+    stats->packets_expected = (int64_t)stats->highest_seq - p->rtp.base_seq + 1;
+    stats->packets_lost = stats->packets_expected - stats->packets_received;
+    stats->jitter = gavl_time_unscale(RTP_CLOCK_RATE, p->rtp.jitter >> 4);
+    ret = 1;
+    }
+  
+  pthread_mutex_unlock(&p->rtp_mutex);
+  return ret;
+  }
+
+static int open_udp(bgav_input_context_t * ctx, const char * url, char ** r)
+  {
+  int i;
+  int port = 0;
+  int rcvbuf = RCVBUF_DEFAULT;
+  char * host = NULL;
+  gavl_socket_address_t * addr = NULL;
+  gavl_dictionary_t * src;
+  udp_priv_t * p;
+  int ret = 0;
+  
+  p = calloc(1, sizeof(*p));
+  p->fd = -1;
+  ctx->priv = p;
+
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_mutex_init(&p->rtp_mutex, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  
+  if(!parse_url(url, &host, &port))
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Invalid URL %s", url);
+    goto fail;
+    }
+  
+  addr = gavl_socket_address_create();
+  
+  if(!gavl_socket_address_set(addr, host, port, SOCK_DGRAM))
+    goto fail;
+  
+  if(gavl_socket_address_is_multicast(addr))
+    p->fd = gavl_udp_socket_create_multicast(addr, NULL);
+  else
+    p->fd = gavl_udp_socket_create(addr);
+
+  if(p->fd < 0)
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Cannot create socket for %s:%d", host, port);
+    goto fail;
+    }
+
+  gavl_dictionary_get_int(&ctx->opt, BGAV_OPT_UDP_BUFFER, &rcvbuf);
+
+  if((rcvbuf > 0) &&
+     (setsockopt(p->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0))
+    gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Setting receive buffer size failed: %s",
+             strerror(errno));
+
+#ifdef SO_RXQ_OVFL
+  i = 1;
+  setsockopt(p->fd, SOL_SOCKET, SO_RXQ_OVFL, &i, sizeof(i));
+#endif
+  
+  p->slots = malloc(NUM_SLOTS * sizeof(*p->slots));
+  
+  for(i = 0; i < BATCH_SIZE; i++)
+    {
+    p->msgs[i].msg_hdr.msg_iov = &p->iov[i];
+    p->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  
+  pthread_create(&p->thread, NULL, receiver_thread, p);
+  p->running = 1;
+
+  ctx->location = gavl_strdup(url);
+  
+  if((src = gavl_metadata_get_src_nc(&ctx->m, GAVL_META_SRC, 0)))
+    gavl_dictionary_set_string(src, GAVL_META_MIMETYPE, "video/MP2T");
+  
+  ctx->demuxer = bgav_demuxer_create(ctx->b, &bgav_demuxer_mpegts2, NULL);
+  
+  if(!bgav_demuxer_start(ctx->demuxer))
+    goto fail;
+  
+  ret = 1;
+  fail:
+  
+  if(host)
+    free(host);
+  if(addr)
+    gavl_socket_address_destroy(addr);
+  
+  return ret;
+  }
+
+static void close_udp(bgav_input_context_t * ctx)
+  {
+  bgav_rtp_stats_t stats;
+  udp_priv_t * p = ctx->priv;
+
+  if(p->running)
+    {
+    __atomic_store_n(&p->quit, 1, __ATOMIC_RELEASE);
+    pthread_join(p->thread, NULL);
+    }
+
+  if(p->datagrams)
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN,
+             "Received %"PRId64" datagrams, overruns: %"PRId64", kernel drops: %"PRId64", truncated: %"PRId64,
+             p->datagrams, p->overruns, p->kernel_drops, p->truncated);
+  
+  if(p->fd >= 0)
+    gavl_socket_close(p->fd);
+
+  if(p->slots)
+    free(p->slots);
+  
+  if(get_rtp_stats_udp(ctx, &stats))
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN,
+             "RTP packets received: %"PRId64", lost: %"PRId64", jitter: %"PRId64" us",
+             stats.packets_received, stats.packets_lost, stats.jitter);
+  
+  pthread_mutex_destroy(&p->mutex);
+  pthread_mutex_destroy(&p->rtp_mutex);
+  pthread_cond_destroy(&p->cond);
+  
+  free(p);
+  }
+
+const bgav_input_t bgav_input_udp =
+  {
+    .name          = "udp",
+    .open          = open_udp,
+    .read          = read_udp,
+    .read_nonblock = read_nonblock_udp,
+    .can_read      = can_read_udp,
+    .close         = close_udp,
+    .get_rtp_stats = get_rtp_stats_udp,
+  };
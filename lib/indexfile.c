@@ -0,0 +1,859 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Compact file format for cached packet indices.
+ *
+ *  All numbers are little endian.
+ *
+ *  File header (24 bytes):
+ *    magic       "BGAVPIX3"
+ *    uint32      Total number of entries
+ *    uint32      Number of streams
+ *    uint32      Entries per block
+ *    uint32      Index flags (e.g. GAVL_PACKET_INDEX_SPARSE)
+ *
+ *  Stream table (16 bytes per stream):
+ *    int32       Stream ID
+ *    uint32      Number of entries
+ *    uint32      Number of blocks
+ *    uint32      Index of the first block in the block table
+ *
+ *  Block table (32 bytes per block):
+ *    uint32      Number of entries
+ *    uint32      Size of the block data
+ *    uint64      Offset of the block data from the file start
+ *    int64       Position of the first entry
+ *    int64       PTS of the first entry
+ *
+ *  The first position and pts allow binary searches over the blocks of
+ *  a stream, so a lookup needs to decode only the block it hits.
+ *
+ *  Block data consists of the following columns, one after another:
+ *
+ *    Positions   Signed varints, delta to the previous entry (absolute
+ *                for the first entry)
+ *    Sizes       Unsigned varints
+ *    PTS         Signed varints, delta to the previous entry (absolute
+ *                for the first entry)
+ *    Durations   Signed varints, delta to the previous entry
+ *    Keyframes   Bitmap, one bit per entry
+ *    Flags       Unsigned varints, other flags than GAVL_PACKET_KEYFRAME
+ *
+ *  The entries of all streams must be sorted by position, the global
+ *  order is restored by merging the streams when loading. Entries of
+ *  different streams at the same position (empty packets) come out
+ *  in stream order.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "indexfile"
+
+#define MAGIC      "BGAVPIX3"
+#define MAGIC_LEN  8
+
+#define FILE_HEADER_SIZE   24
+#define STREAM_HEADER_SIZE 16
+#define BLOCK_HEADER_SIZE  32
+
+#define BLOCK_SIZE 4096
+
+/* Limits for loading */
+#define BLOCK_SIZE_MAX    (1<<20)
+#define MIN_ENTRY_BYTES   5 /* One byte for each varint column */
+
+typedef bgav_packet_index_file_entry_t entry_t;
+
+typedef struct
+  {
+  int stream_id;
+  uint32_t num_entries;
+  uint32_t num_blocks;
+  uint32_t first_block;
+  } stream_header_t;
+
+typedef struct
+  {
+  uint32_t num_entries;
+  uint32_t data_size;
+  uint64_t data_offset;
+  int64_t first_position;
+  int64_t first_pts;
+  } block_header_t;
+
+/* Writing */
+
+static void put_32(uint8_t * ptr, uint32_t v)
+  {
+  ptr[0] = v & 0xff;
+  ptr[1] = (v >> 8) & 0xff;
+  ptr[2] = (v >> 16) & 0xff;
+  ptr[3] = (v >> 24) & 0xff;
+  }
+
+static void put_64(uint8_t * ptr, uint64_t v)
+  {
+  put_32(ptr, v & 0xffffffff);
+  put_32(ptr + 4, v >> 32);
+  }
+
+static void put_varint(gavl_buffer_t * buf, uint64_t v)
+  {
+  gavl_buffer_alloc(buf, buf->len + 10);
+
+  while(v >= 0x80)
+    {
+    buf->buf[buf->len++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+    }
+  buf->buf[buf->len++] = v;
+  }
+
+static void put_svarint(gavl_buffer_t * buf, int64_t v)
+  {
+  /* Zigzag encoding */
+  put_varint(buf, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+  }
+
+static void encode_block(gavl_buffer_t * buf, const entry_t * e, int num)
+  {
+  int i;
+  uint8_t * bitmap;
+  int bitmap_len = (num + 7) / 8;
+
+  for(i = 0; i < num; i++)
+    put_svarint(buf, i ? e[i].position - e[i-1].position : e[i].position);
+  for(i = 0; i < num; i++)
+    put_varint(buf, e[i].size);
+  for(i = 0; i < num; i++)
+    put_svarint(buf, i ? e[i].pts - e[i-1].pts : e[i].pts);
+  for(i = 0; i < num; i++)
+    put_svarint(buf, i ? e[i].duration - e[i-1].duration : e[i].duration);
+
+  gavl_buffer_alloc(buf, buf->len + bitmap_len);
+  bitmap = buf->buf + buf->len;
+  memset(bitmap, 0, bitmap_len);
+
+  for(i = 0; i < num; i++)
+    {
+    if(e[i].flags & GAVL_PACKET_KEYFRAME)
+      bitmap[i / 8] |= 1 << (i % 8);
+    }
+  buf->len += bitmap_len;
+
+  for(i = 0; i < num; i++)
+    put_varint(buf, e[i].flags & ~GAVL_PACKET_KEYFRAME);
+  }
+
+int bgav_packet_index_save_compact(const gavl_packet_index_t * idx,
+                                   const char * filename)
+  {
+  int i, j, k;
+  int num_streams = 0;
+  int num_blocks = 0;
+  int block;
+  int num;
+  int * stream_ids = NULL;
+  uint32_t * stream_entries = NULL;
+  entry_t * entries = NULL;
+  uint8_t * ptr;
+  uint64_t data_start;
+
+  gavl_buffer_t header;
+  gavl_buffer_t data;
+  FILE * out = NULL;
+  int ret = 0;
+
+  gavl_buffer_init(&header);
+  gavl_buffer_init(&data);
+
+  /* Entries must be sorted by position */
+  for(i = 1; i < idx->num_entries; i++)
+    {
+    if(idx->entries[i].position < idx->entries[i-1].position)
+      return 0;
+    }
+
+  /* Collect streams */
+  for(i = 0; i < idx->num_entries; i++)
+    {
+    for(j = 0; j < num_streams; j++)
+      {
+      if(stream_ids[j] == idx->entries[i].stream_id)
+        break;
+      }
+    if(j == num_streams)
+      {
+      stream_ids = realloc(stream_ids, (num_streams+1) * sizeof(*stream_ids));
+      stream_entries = realloc(stream_entries, (num_streams+1) * sizeof(*stream_entries));
+      stream_ids[num_streams] = idx->entries[i].stream_id;
+      stream_entries[num_streams] = 0;
+      num_streams++;
+      }
+    stream_entries[j]++;
+    }
+
+  for(i = 0; i < num_streams; i++)
+    num_blocks += (stream_entries[i] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  data_start = FILE_HEADER_SIZE + num_streams * STREAM_HEADER_SIZE +
+    num_blocks * BLOCK_HEADER_SIZE;
+
+  gavl_buffer_alloc(&header, data_start);
+  header.len = data_start;
+  memset(header.buf, 0, header.len);
+
+  memcpy(header.buf, MAGIC, MAGIC_LEN);
+  put_32(header.buf + 8,  idx->num_entries);
+  put_32(header.buf + 12, num_streams);
+  put_32(header.buf + 16, BLOCK_SIZE);
+  put_32(header.buf + 20, idx->flags);
+
+  entries = malloc(BLOCK_SIZE * sizeof(*entries));
+
+  block = 0;
+
+  for(i = 0; i < num_streams; i++)
+    {
+    ptr = header.buf + FILE_HEADER_SIZE + i * STREAM_HEADER_SIZE;
+    put_32(ptr,      stream_ids[i]);
+    put_32(ptr + 4,  stream_entries[i]);
+    put_32(ptr + 8,  (stream_entries[i] + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    put_32(ptr + 12, block);
+
+    /* Encode blocks */
+
+    j = 0;
+    num = 0;
+
+    while(1)
+      {
+      while((j < idx->num_entries) && (num < BLOCK_SIZE))
+        {
+        if(idx->entries[j].stream_id == stream_ids[i])
+          {
+          entries[num].position = idx->entries[j].position;
+          entries[num].size     = idx->entries[j].size;
+          entries[num].pts      = idx->entries[j].pts;
+          entries[num].duration = idx->entries[j].duration;
+          entries[num].flags    = idx->entries[j].flags;
+          num++;
+          }
+        j++;
+        }
+
+      if(!num)
+        break;
+
+      ptr = header.buf + FILE_HEADER_SIZE + num_streams * STREAM_HEADER_SIZE +
+        block * BLOCK_HEADER_SIZE;
+
+      k = data.len;
+      encode_block(&data, entries, num);
+
+      put_32(ptr,      num);
+      put_32(ptr + 4,  data.len - k);
+      put_64(ptr + 8,  data_start + k);
+      put_64(ptr + 16, entries[0].position);
+      put_64(ptr + 24, entries[0].pts);
+
+      block++;
+      num = 0;
+      }
+    }
+
+  if(!(out = fopen(filename, "wb")))
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Cannot open %s: %s", filename, strerror(errno));
+    goto end;
+    }
+
+  if((fwrite(header.buf, 1, header.len, out) < (size_t)header.len) ||
+     (fwrite(data.buf, 1, data.len, out) < (size_t)data.len))
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Writing %s failed: %s", filename, strerror(errno));
+    goto end;
+    }
+
+  gavl_log(GAVL_LOG_DEBUG, LOG_DOMAIN, "Wrote %d entries in %d bytes",
+           idx->num_entries, (int)(header.len + data.len));
+
+  ret = 1;
+
+  end:
+
+  if(out)
+    fclose(out);
+
+  if(stream_ids)
+    free(stream_ids);
+  if(stream_entries)
+    free(stream_entries);
+  if(entries)
+    free(entries);
+
+  gavl_buffer_free(&header);
+  gavl_buffer_free(&data);
+
+  return ret;
+  }
+
+/* Reading */
+
+static uint32_t get_32(const uint8_t * ptr)
+  {
+  return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+    ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+  }
+
+static uint64_t get_64(const uint8_t * ptr)
+  {
+  return (uint64_t)get_32(ptr) | ((uint64_t)get_32(ptr + 4) << 32);
+  }
+
+static int get_varint(const uint8_t ** ptr, const uint8_t * end, uint64_t * ret)
+  {
+  int shift = 0;
+  *ret = 0;
+
+  while(*ptr < end)
+    {
+    *ret |= (uint64_t)(**ptr & 0x7f) << shift;
+
+    if(!(*((*ptr)++) & 0x80))
+      return 1;
+
+    shift += 7;
+    if(shift > 63)
+      return 0;
+    }
+  return 0;
+  }
+
+static int get_svarint(const uint8_t ** ptr, const uint8_t * end, int64_t * ret)
+  {
+  uint64_t v;
+  if(!get_varint(ptr, end, &v))
+    return 0;
+  *ret = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  return 1;
+  }
+
+static int decode_block(const block_header_t * b,
+                        const uint8_t * data, entry_t * e)
+  {
+  uint32_t i;
+  uint64_t u;
+  int64_t s;
+  const uint8_t * ptr = data;
+  const uint8_t * end = data + b->data_size;
+
+  for(i = 0; i < b->num_entries; i++)
+    {
+    if(!get_svarint(&ptr, end, &s))
+      return 0;
+    e[i].position = i ? e[i-1].position + s : s;
+    }
+  for(i = 0; i < b->num_entries; i++)
+    {
+    if(!get_varint(&ptr, end, &u))
+      return 0;
+    e[i].size = u;
+    }
+  for(i = 0; i < b->num_entries; i++)
+    {
+    if(!get_svarint(&ptr, end, &s))
+      return 0;
+    e[i].pts = i ? e[i-1].pts + s : s;
+    }
+  for(i = 0; i < b->num_entries; i++)
+    {
+    if(!get_svarint(&ptr, end, &s))
+      return 0;
+    e[i].duration = i ? e[i-1].duration + s : s;
+    }
+
+  if(end - ptr < (b->num_entries + 7) / 8)
+    return 0;
+
+  for(i = 0; i < b->num_entries; i++)
+    e[i].flags = (ptr[i / 8] & (1 << (i % 8))) ? GAVL_PACKET_KEYFRAME : 0;
+  ptr += (b->num_entries + 7) / 8;
+
+  for(i = 0; i < b->num_entries; i++)
+    {
+    if(!get_varint(&ptr, end, &u))
+      return 0;
+    e[i].flags |= u;
+    }
+
+  /* The block table must match the data */
+  if(b->num_entries &&
+     ((e[0].position != b->first_position) || (e[0].pts != b->first_pts)))
+    return 0;
+  
+  return 1;
+  }
+
+/* Read position within one stream */
+
+typedef struct
+  {
+  stream_header_t h;
+  uint32_t block;     /* Next block to decode */
+  uint32_t num;       /* Decoded entries */
+  uint32_t pos;       /* Next entry */
+  entry_t * entries;
+  } cursor_t;
+
+static int parse_block_header(const uint8_t * map, size_t len,
+                              uint32_t num_streams, uint64_t index,
+                              block_header_t * ret)
+  {
+  const uint8_t * ptr;
+  uint64_t offset = FILE_HEADER_SIZE + (uint64_t)num_streams * STREAM_HEADER_SIZE +
+    (uint64_t)index * BLOCK_HEADER_SIZE;
+
+  if(offset + BLOCK_HEADER_SIZE > len)
+    return 0;
+
+  ptr = map + offset;
+  
+  ret->num_entries = get_32(ptr);
+  ret->data_size   = get_32(ptr + 4);
+  ret->data_offset = get_64(ptr + 8);
+  ret->first_position = (int64_t)get_64(ptr + 16);
+  ret->first_pts      = (int64_t)get_64(ptr + 24);
+
+  if((ret->data_offset > len) || (ret->data_size > len - ret->data_offset))
+    return 0;
+
+  return 1;
+  }
+
+static int cursor_load_block(cursor_t * c, const uint8_t * map, size_t len,
+                             uint32_t num_streams, uint32_t block_size)
+  {
+  block_header_t b;
+
+  if(c->block >= c->h.num_blocks)
+    return 1; /* Stream finished */
+
+  if(!parse_block_header(map, len, num_streams,
+                         (uint64_t)c->h.first_block + c->block, &b) ||
+     !b.num_entries || (b.num_entries > block_size) ||
+     !decode_block(&b, map + b.data_offset, c->entries))
+    return 0;
+
+  c->block++;
+  c->num = b.num_entries;
+  c->pos = 0;
+  return 1;
+  }
+
+static int cursor_advance(cursor_t * c, const uint8_t * map, size_t len,
+                          uint32_t num_streams, uint32_t block_size)
+  {
+  c->pos++;
+
+  if(c->pos < c->num)
+    return 1;
+
+  return cursor_load_block(c, map, len, num_streams, block_size);
+  }
+
+gavl_packet_index_t * bgav_packet_index_load_compact(const char * filename)
+  {
+  int fd;
+  struct stat st;
+  uint8_t * map = NULL;
+  size_t len = 0;
+  uint32_t i, j;
+  uint32_t num_entries;
+  uint32_t num_streams = 0;
+  uint32_t block_size;
+  uint32_t flags;
+  uint64_t stream_entries = 0;
+  const uint8_t * ptr;
+  cursor_t * cursors = NULL;
+  cursor_t * c;
+  gavl_packet_index_t * ret = NULL;
+
+  if((fd = open(filename, O_RDONLY)) < 0)
+    return NULL;
+
+  if(fstat(fd, &st) || (st.st_size < FILE_HEADER_SIZE))
+    goto end;
+
+  len = st.st_size;
+
+  if((map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+    map = NULL;
+    goto end;
+    }
+
+  /* Other format: Let the caller try something else */
+  if(memcmp(map, MAGIC, MAGIC_LEN))
+    goto end;
+
+  num_entries = get_32(map + 8);
+  num_streams = get_32(map + 12);
+  block_size  = get_32(map + 16);
+  flags       = get_32(map + 20);
+
+  /* Don't trust the counts before allocating anything */
+  if(!block_size || (block_size > BLOCK_SIZE_MAX) ||
+     (FILE_HEADER_SIZE + (uint64_t)num_streams * STREAM_HEADER_SIZE > len) ||
+     ((uint64_t)num_entries * MIN_ENTRY_BYTES > len))
+    goto fail;
+
+  cursors = calloc(num_streams, sizeof(*cursors));
+
+  for(i = 0; i < num_streams; i++)
+    {
+    ptr = map + FILE_HEADER_SIZE + i * STREAM_HEADER_SIZE;
+
+    cursors[i].h.stream_id   = (int32_t)get_32(ptr);
+    cursors[i].h.num_entries = get_32(ptr + 4);
+    cursors[i].h.num_blocks  = get_32(ptr + 8);
+    cursors[i].h.first_block = get_32(ptr + 12);
+
+    stream_entries += cursors[i].h.num_entries;
+    
+    if((cursors[i].h.num_blocks !=
+        ((uint64_t)cursors[i].h.num_entries + block_size - 1) / block_size) ||
+       (stream_entries > num_entries))
+      goto fail;
+    
+    cursors[i].entries = malloc(block_size * sizeof(*cursors[i].entries));
+
+    /* Decode first block */
+    if(!cursor_load_block(&cursors[i], map, len, num_streams, block_size))
+      goto fail;
+    }
+
+  if(stream_entries != num_entries)
+    goto fail;
+  
+  ret = gavl_packet_index_create(num_entries);
+  ret->flags = flags;
+
+  /* Merge the streams by position */
+
+  for(i = 0; i < num_entries; i++)
+    {
+    c = NULL;
+
+    for(j = 0; j < num_streams; j++)
+      {
+      if((cursors[j].pos < cursors[j].num) &&
+         (!c || (cursors[j].entries[cursors[j].pos].position <
+                 c->entries[c->pos].position)))
+        c = &cursors[j];
+      }
+
+    if(!c)
+      goto fail;
+
+    gavl_packet_index_add(ret,
+                          c->entries[c->pos].position,
+                          c->entries[c->pos].size,
+                          c->h.stream_id,
+                          c->entries[c->pos].pts,
+                          c->entries[c->pos].flags,
+                          c->entries[c->pos].duration);
+
+    if(!cursor_advance(c, map, len, num_streams, block_size))
+      goto fail;
+    }
+
+  /* Blocks must contain exactly the entries from the stream table */
+  for(j = 0; j < num_streams; j++)
+    {
+    if((cursors[j].pos < cursors[j].num) ||
+       (cursors[j].block < cursors[j].h.num_blocks))
+      goto fail;
+    }
+
+  goto end;
+
+  fail:
+
+  gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Invalid index file %s", filename);
+
+  if(ret)
+    {
+    gavl_packet_index_destroy(ret);
+    ret = NULL;
+    }
+
+  end:
+
+  if(cursors)
+    {
+    for(i = 0; i < num_streams; i++)
+      {
+      if(cursors[i].entries)
+        free(cursors[i].entries);
+      }
+    free(cursors);
+    }
+
+  if(map)
+    munmap(map, len);
+  close(fd);
+
+  return ret;
+  }
+
+
+/* Lookups without loading the whole index */
+
+typedef struct
+  {
+  stream_header_t h;
+  int pts_sorted; /* First pts of the blocks are increasing */
+  } file_stream_t;
+
+struct bgav_packet_index_file_s
+  {
+  uint8_t * map;
+  size_t len;
+
+  uint32_t num_streams;
+  uint32_t block_size;
+  file_stream_t * streams;
+
+  /* Last decoded block */
+  int64_t block;
+  entry_t * entries;
+  };
+
+bgav_packet_index_file_t * bgav_packet_index_file_open(const char * filename)
+  {
+  int fd;
+  struct stat st;
+  uint32_t i, j;
+  uint64_t stream_entries;
+  int64_t last_pts = 0;
+  const uint8_t * ptr;
+  block_header_t b;
+  file_stream_t * s;
+  bgav_packet_index_file_t * ret;
+
+  if((fd = open(filename, O_RDONLY)) < 0)
+    return NULL;
+
+  ret = calloc(1, sizeof(*ret));
+  ret->block = -1;
+
+  if(fstat(fd, &st) || (st.st_size < FILE_HEADER_SIZE))
+    goto fail;
+
+  ret->len = st.st_size;
+
+  if((ret->map = mmap(NULL, ret->len, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+    ret->map = NULL;
+    goto fail;
+    }
+
+  if(memcmp(ret->map, MAGIC, MAGIC_LEN))
+    goto fail;
+
+  ret->num_streams = get_32(ret->map + 12);
+  ret->block_size  = get_32(ret->map + 16);
+
+  if(!ret->block_size || (ret->block_size > BLOCK_SIZE_MAX) ||
+     (FILE_HEADER_SIZE + (uint64_t)ret->num_streams * STREAM_HEADER_SIZE > ret->len))
+    goto fail;
+
+  ret->streams = calloc(ret->num_streams, sizeof(*ret->streams));
+
+  /* Check the block tables, the block data are checked when decoding */
+  
+  for(i = 0; i < ret->num_streams; i++)
+    {
+    s = &ret->streams[i];
+    ptr = ret->map + FILE_HEADER_SIZE + i * STREAM_HEADER_SIZE;
+
+    s->h.stream_id   = (int32_t)get_32(ptr);
+    s->h.num_entries = get_32(ptr + 4);
+    s->h.num_blocks  = get_32(ptr + 8);
+    s->h.first_block = get_32(ptr + 12);
+    s->pts_sorted = 1;
+    
+    if(s->h.num_blocks !=
+       ((uint64_t)s->h.num_entries + ret->block_size - 1) / ret->block_size)
+      goto fail;
+
+    stream_entries = 0;
+    
+    for(j = 0; j < s->h.num_blocks; j++)
+      {
+      if(!parse_block_header(ret->map, ret->len, ret->num_streams,
+                             (uint64_t)s->h.first_block + j, &b))
+        goto fail;
+
+      /* All blocks except the last one are full */
+      if((j < s->h.num_blocks - 1) ? (b.num_entries != ret->block_size) :
+         (!b.num_entries || (b.num_entries > ret->block_size)))
+        goto fail;
+
+      if(j && (b.first_pts < last_pts))
+        s->pts_sorted = 0;
+      last_pts = b.first_pts;
+      
+      stream_entries += b.num_entries;
+      }
+
+    if(stream_entries != s->h.num_entries)
+      goto fail;
+    }
+
+  ret->entries = malloc(ret->block_size * sizeof(*ret->entries));
+  
+  close(fd);
+  return ret;
+  
+  fail:
+  
+  gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Invalid index file %s", filename);
+  close(fd);
+  bgav_packet_index_file_close(ret);
+  return NULL;
+  }
+
+void bgav_packet_index_file_close(bgav_packet_index_file_t * f)
+  {
+  if(f->map)
+    munmap(f->map, f->len);
+  if(f->streams)
+    free(f->streams);
+  if(f->entries)
+    free(f->entries);
+  free(f);
+  }
+
+/* Binary search for the last block, which starts at or before key */
+
+static int64_t find_block(bgav_packet_index_file_t * f, const file_stream_t * s,
+                          int64_t key, int use_pts)
+  {
+  uint32_t lo = 0;
+  uint32_t hi = s->h.num_blocks;
+  uint32_t mid;
+  block_header_t b;
+  
+  while(lo < hi)
+    {
+    mid = lo + (hi - lo) / 2;
+
+    /* Checked when opening */
+    parse_block_header(f->map, f->len, f->num_streams,
+                       (uint64_t)s->h.first_block + mid, &b);
+
+    if((use_pts ? b.first_pts : b.first_position) <= key)
+      lo = mid + 1;
+    else
+      hi = mid;
+    }
+  return (int64_t)lo - 1;
+  }
+
+static int find_entry(bgav_packet_index_file_t * f, int stream_id,
+                      int64_t key, int use_pts, entry_t * ret)
+  {
+  uint32_t i;
+  int idx = -1;
+  int64_t block;
+  int64_t k;
+  block_header_t b;
+  const file_stream_t * s = NULL;
+  
+  for(i = 0; i < f->num_streams; i++)
+    {
+    if(f->streams[i].h.stream_id == stream_id)
+      {
+      s = &f->streams[i];
+      break;
+      }
+    }
+  
+  if(!s || (use_pts && !s->pts_sorted) ||
+     ((block = find_block(f, s, key, use_pts)) < 0))
+    return -1;
+
+  /* Decode only the block we hit */
+  
+  parse_block_header(f->map, f->len, f->num_streams,
+                     s->h.first_block + block, &b);
+
+  if(f->block != s->h.first_block + block)
+    {
+    f->block = -1;
+    if(!decode_block(&b, f->map + b.data_offset, f->entries))
+      return -1;
+    f->block = s->h.first_block + block;
+    }
+
+  /* Largest key not after the requested one, the first entry matches
+     always */
+  
+  for(i = 0; i < b.num_entries; i++)
+    {
+    k = use_pts ? f->entries[i].pts : f->entries[i].position;
+    
+    if((k <= key) &&
+       ((idx < 0) || (k >= (use_pts ? f->entries[idx].pts :
+                            f->entries[idx].position))))
+      idx = i;
+    }
+
+  memcpy(ret, &f->entries[idx], sizeof(*ret));
+  return block * f->block_size + idx;
+  }
+
+int bgav_packet_index_file_find_pts(bgav_packet_index_file_t * f,
+                                    int stream_id, int64_t pts,
+                                    bgav_packet_index_file_entry_t * ret)
+  {
+  return find_entry(f, stream_id, pts, 1, ret);
+  }
+
+int bgav_packet_index_file_find_position(bgav_packet_index_file_t * f,
+                                         int stream_id, int64_t position,
+                                         bgav_packet_index_file_entry_t * ret)
+  {
+  return find_entry(f, stream_id, position, 0, ret);
+  }
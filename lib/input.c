@@ -23,9 +23,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 //#include <ctype.h>
 
 #include <avdec_private.h>
+#include <bswap.h>
 
 #ifdef HAVE_LIBUDF
 #include <cdio/udf.h>
@@ -43,18 +45,27 @@ static int do_read(bgav_input_context_t * ctx, uint8_t * buffer, int len)
   {
   if(ctx->input->read)
     {
-    return ctx->input->read(ctx, buffer, len);
+    int ret;
+    BGAV_TRACE_BEGIN("input_read");
+    ret = ctx->input->read(ctx, buffer, len);
+    BGAV_TRACE_END("input_read");
+    return ret;
     }
   else if(ctx->input->read_block)
     {
     int bytes_read = 0;
     int bytes_to_copy;
+    int result;
     
     while(bytes_read < len)
       {
       if(!ctx->block_ptr || (ctx->block_ptr - ctx->block >= ctx->block_size))
         {
-        if(!ctx->input->read_block(ctx))
+        BGAV_TRACE_BEGIN("input_read");
+        result = ctx->input->read_block(ctx);
+        BGAV_TRACE_END("input_read");
+        
+        if(!result)
           return bytes_read;
         ctx->block_ptr = ctx->block;
         }
@@ -120,11 +131,18 @@ static void add_char(gavl_buffer_t * ret, char c)
   ret->buf[ret->len] = c;
   }
 
+/* Bytes to scan at once when reading lines */
+#define LINE_CHUNK 1024
+
 int bgav_input_read_line(bgav_input_context_t* input,
                          gavl_buffer_t * ret)
   {
-  char c;
+  int bytes;
   int chars_read = 0;
+  const uint8_t * start;
+  const uint8_t * end;
+  const uint8_t * ptr;
+  const uint8_t * cr;
 
   gavl_buffer_reset(ret);
   
@@ -140,22 +158,52 @@ int bgav_input_read_line(bgav_input_context_t* input,
   
   while(1)
     {
-    if(!bgav_input_read_data(input, (uint8_t*)(&c), 1))
+    /* Scan the input buffer instead of reading byte by byte */
+    bytes = LINE_CHUNK;
+
+    if(input->total_bytes && (bytes > input->total_bytes - input->position))
+      bytes = input->total_bytes - input->position;
+
+    if(bytes > 0)
+      {
+      bgav_input_ensure_buffer_size(input, bytes);
+
+      if(bytes > input->buf.len - input->buf.pos)
+        bytes = input->buf.len - input->buf.pos;
+      }
+    
+    if(bytes <= 0)
       {
-      //      return 0;
       add_char(ret, '\0');
       return ret->len;
-      break;
       }
-    chars_read++;
+
+    start = input->buf.buf + input->buf.pos;
+
+    if((end = memchr(start, '\n', bytes)))
+      bytes = end - start;
+
+    /* Append, skipping '\r' */
+    gavl_buffer_alloc(ret, ret->len + bytes + 1);
     
-    if(c == '\n')
-      break;
-    else if(c != '\r')
+    ptr = start;
+    while((cr = memchr(ptr, '\r', start + bytes - ptr)))
       {
-      add_char(ret, c);
-      ret->len++;
+      memcpy(ret->buf + ret->len, ptr, cr - ptr);
+      ret->len += cr - ptr;
+      ptr = cr + 1;
       }
+    memcpy(ret->buf + ret->len, ptr, start + bytes - ptr);
+    ret->len += start + bytes - ptr;
+    
+    if(end)
+      bytes++;
+    
+    chars_read += bytes;
+    bgav_input_skip(input, bytes);
+
+    if(end)
+      break;
     }
   add_char(ret, '\0');
   return chars_read;
@@ -657,6 +705,76 @@ int bgav_input_read_double_64_le(bgav_input_context_t * ctx, double * ret)
   return 1;
   }
 
+/*
+ *  Arrays: The data is read directly into the destination and
+ *  swapped in place. The loops are simple enough to be vectorized
+ *  by the compiler.
+ */
+
+static int read_array(bgav_input_context_t * ctx, void * ret, int num, int size)
+  {
+  int64_t bytes = (int64_t)num * size;
+
+  if((num < 0) || (bytes > INT_MAX))
+    return 0;
+  
+  return (bgav_input_read_data(ctx, ret, bytes) == bytes);
+  }
+
+static void swap_array_32(uint32_t * data, int num)
+  {
+  int i;
+  for(i = 0; i < num; i++)
+    data[i] = bswap_32(data[i]);
+  }
+
+static void swap_array_64(uint64_t * data, int num)
+  {
+  int i;
+  for(i = 0; i < num; i++)
+    data[i] = bswap_64(data[i]);
+  }
+
+int bgav_input_read_array_32_be(bgav_input_context_t * ctx, uint32_t * ret, int num)
+  {
+  if(!read_array(ctx, ret, num, 4))
+    return 0;
+#ifndef WORDS_BIGENDIAN
+  swap_array_32(ret, num);
+#endif
+  return 1;
+  }
+
+int bgav_input_read_array_32_le(bgav_input_context_t * ctx, uint32_t * ret, int num)
+  {
+  if(!read_array(ctx, ret, num, 4))
+    return 0;
+#ifdef WORDS_BIGENDIAN
+  swap_array_32(ret, num);
+#endif
+  return 1;
+  }
+
+int bgav_input_read_array_64_be(bgav_input_context_t * ctx, uint64_t * ret, int num)
+  {
+  if(!read_array(ctx, ret, num, 8))
+    return 0;
+#ifndef WORDS_BIGENDIAN
+  swap_array_64(ret, num);
+#endif
+  return 1;
+  }
+
+int bgav_input_read_array_64_le(bgav_input_context_t * ctx, uint64_t * ret, int num)
+  {
+  if(!read_array(ctx, ret, num, 8))
+    return 0;
+#ifdef WORDS_BIGENDIAN
+  swap_array_64(ret, num);
+#endif
+  return 1;
+  }
+
 int bgav_input_get_double_64_be(bgav_input_context_t * ctx, double * ret)
   {
   uint8_t data[8];
@@ -683,6 +801,7 @@ extern const bgav_input_t bgav_input_stdin;
 extern const bgav_input_t bgav_input_http;
 extern const bgav_input_t bgav_input_hls;
 extern const bgav_input_t bgav_input_sdp;
+extern const bgav_input_t bgav_input_udp;
 
 #ifdef HAVE_CDIO
 extern const bgav_input_t bgav_input_vcd;
@@ -704,6 +823,7 @@ void bgav_inputs_dump()
   gavl_dprintf( "<li>%s\n", bgav_input_stdin.name);
   gavl_dprintf( "<li>%s\n", bgav_input_http.name);
   gavl_dprintf( "<li>%s\n", bgav_input_hls.name);
+  gavl_dprintf( "<li>%s\n", bgav_input_udp.name);
 
 #ifdef HAVE_CDIO
 
@@ -806,6 +926,9 @@ static int input_open(bgav_input_context_t * ctx,
       ctx->input = &bgav_input_hls;
     else if(!strcasecmp(protocol, "sdp"))
       ctx->input = &bgav_input_sdp;
+    else if(!strcasecmp(protocol, "udp") ||
+            !strcasecmp(protocol, "rtp"))
+      ctx->input = &bgav_input_udp;
     else if(!strcasecmp(protocol, "file"))
       ctx->input = &bgav_input_file;
     else if(!strcasecmp(protocol, "stdin") || !strcmp(url, "-"))
@@ -854,6 +977,17 @@ static int input_open(bgav_input_context_t * ctx,
 
     if(!ctx->input && !strcmp(url, "-"))
       ctx->input = &bgav_input_stdin;
+
+    /* Image sequence: Open the first image for probing */
+    if(!ctx->input)
+      {
+      char * first_file;
+      if((first_file = bgav_image_sequence_first_file(url)))
+        {
+        free(tmp_url);
+        tmp_url = first_file;
+        }
+      }
     
     if(!ctx->input)
       ctx->input = &bgav_input_file;
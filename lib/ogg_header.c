@@ -21,7 +21,7 @@
 
 
 
-// #include <string.h>
+#include <string.h>
 #include <config.h>
 
 
@@ -143,6 +143,47 @@ int bgav_ogg_probe(bgav_input_context_t * input)
   return 0;
   }
 
+/* Skip to the next capture pattern. The data is scanned in chunks
+   instead of skipping byte by byte */
+
+#define FIND_PAGE_BYTES 4096
+
+int bgav_ogg_find_page(bgav_input_context_t * ctx, int64_t end_pos)
+  {
+  uint8_t buf[FIND_PAGE_BYTES];
+  uint8_t * ptr;
+  uint8_t * end;
+  int len;
+  
+  while(1)
+    {
+    len = FIND_PAGE_BYTES;
+    
+    if((end_pos > 0) && (ctx->position + len > end_pos))
+      len = end_pos - ctx->position;
+
+    if(len < 4)
+      return 0;
+    
+    if((len = bgav_input_get_data(ctx, buf, len)) < 4)
+      return 0;
+
+    ptr = buf;
+    end = buf + len - 3;
+    
+    while((ptr < end) && (ptr = memchr(ptr, 'O', end - ptr)))
+      {
+      if((ptr[1] == 'g') && (ptr[2] == 'g') && (ptr[3] == 'S'))
+        {
+        bgav_input_skip(ctx, ptr - buf);
+        return 1;
+        }
+      ptr++;
+      }
+    bgav_input_skip(ctx, len - 3);
+    }
+  return 0;
+  }
 
 void bgav_ogg_page_skip(bgav_input_context_t * ctx,
                        const bgav_ogg_page_t * h)
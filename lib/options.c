@@ -35,6 +35,63 @@ void bgav_options_set_sample_accurate(bgav_options_t*b, int p)
   gavl_dictionary_set_int(b, BGAV_OPT_SAMPLE_ACCURATE, p);
   }
 
+void bgav_options_set_video_threads(bgav_options_t*b, int threads)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_VIDEO_THREADS, threads);
+  }
+
+void bgav_options_set_si_readahead(bgav_options_t*b, int bytes)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_SI_READAHEAD, bytes);
+  }
+
+void bgav_options_set_udp_buffer(bgav_options_t*b, int bytes)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_UDP_BUFFER, bytes);
+  }
+
+void bgav_options_set_rtp_jitter(bgav_options_t*b, int ms)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_RTP_JITTER, ms);
+  }
+
+void bgav_options_set_si_window(bgav_options_t*b, int packets)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_SI_WINDOW, packets);
+  }
+
+void bgav_options_set_index_cache_threshold(bgav_options_t*b, int ms)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_INDEX_CACHE_THRESHOLD, ms);
+  }
+
+void bgav_options_set_index_cache_size(bgav_options_t*b, int mb)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_INDEX_CACHE_SIZE, mb);
+  }
+
+void bgav_options_set_http_cache_size(bgav_options_t*b, int mb)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_HTTP_CACHE_SIZE, mb);
+  }
+
+void bgav_options_set_subtitle_index(bgav_options_t*b, int enable)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_SUBTITLE_INDEX, enable);
+  }
+
+void bgav_options_set_trace_file(bgav_options_t*b, const char * filename)
+  {
+  gavl_dictionary_set_string(b, BGAV_OPT_TRACE_FILE, filename);
+  }
+
+void bgav_options_set_image_sequence_rate(bgav_options_t*b,
+                                          int timescale, int frame_duration)
+  {
+  gavl_dictionary_set_int(b, BGAV_OPT_IMAGE_SEQUENCE_TIMESCALE, timescale);
+  gavl_dictionary_set_int(b, BGAV_OPT_IMAGE_SEQUENCE_FRAME_DURATION, frame_duration);
+  }
+
 void bgav_options_set_audio_dynrange(bgav_options_t* b, int audio_dynrange)
   {
   gavl_dictionary_set_int(b, BGAV_OPT_DYNRANGE, audio_dynrange);
@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 
 #include <config.h>
@@ -107,6 +108,39 @@ parsers[] =
     { /* End */ }
   };
 
+/* fourcc -> parsers[] index, built once */
+
+static bgav_fourcc_table_t parser_table;
+static pthread_once_t parser_table_once = PTHREAD_ONCE_INIT;
+
+static void init_parser_table()
+  {
+  int num = 0;
+  uint32_t * keys;
+
+  while(parsers[num].fourcc)
+    num++;
+
+  keys = calloc(num + 1, sizeof(*keys));
+  num = 0;
+  while(parsers[num].fourcc)
+    {
+    keys[num] = parsers[num].fourcc;
+    num++;
+    }
+  bgav_fourcc_table_init(&parser_table, keys, num);
+  free(keys);
+  }
+
+#if defined(__GNUC__) && defined(__ELF__)
+static void __cleanup() __attribute__ ((destructor));
+ 
+static void __cleanup()
+  {
+  bgav_fourcc_table_free(&parser_table);
+  }
+#endif
+
 static void parser_flush_bytes(bgav_packet_parser_t * p)
   {
   int i;
@@ -148,7 +182,13 @@ static void parser_flush_bytes(bgav_packet_parser_t * p)
 
 static int do_parse_frame(bgav_packet_parser_t * p, gavl_packet_t * pkt)
   {
-  if(!p->parse_frame(p, pkt))
+  int result;
+
+  BGAV_TRACE_BEGIN("parse_frame");
+  result = p->parse_frame(p, pkt);
+  BGAV_TRACE_END("parse_frame");
+  
+  if(!result)
     {
     gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Parsing frame failed");
     return 0;
@@ -202,6 +242,16 @@ static gavl_sink_status_t sink_put_func_frame(void * priv, gavl_packet_t * pkt)
   }
 
 /* Parse full */
+
+static int find_frame_boundary(bgav_packet_parser_t * p, int * skip)
+  {
+  int ret;
+  BGAV_TRACE_BEGIN("find_frame_boundary");
+  ret = p->find_frame_boundary(p, skip);
+  BGAV_TRACE_END("find_frame_boundary");
+  return ret;
+  }
+
 static gavl_packet_t * sink_get_func_full(void * priv)
   {
   bgav_packet_parser_t * p = priv;
@@ -252,7 +302,7 @@ static gavl_sink_status_t sink_put_func_full(void * priv, gavl_packet_t * pkt)
   
   /* Try to flush packets */
   
-  while(p->find_frame_boundary(p, &skip))
+  while(find_frame_boundary(p, &skip))
     {
     if(!(p->parser_flags & PARSER_HAS_SYNC))
       {
@@ -336,30 +386,28 @@ bgav_packet_parser_t * bgav_packet_parser_create(gavl_dictionary_t * stream_info
                                                  int stream_flags, gavl_compression_info_t * ci)
   {
   bgav_packet_parser_t * ret = NULL;
-  int idx = 0;
+  const int * idx;
+  int num;
   int fourcc = gavl_stream_get_compression_tag(stream_info);
+
+  pthread_once(&parser_table_once, init_parser_table);
   
-  /* Find parsers */
-  while(parsers[idx].fourcc)
+  /* Find parser */
+  if((idx = bgav_fourcc_table_get(&parser_table, fourcc, &num)))
     {
-    if(parsers[idx].fourcc == fourcc)
-      {
-      ret = calloc(1, sizeof(*ret));
-      ret->ci = ci;
-      ret->info = stream_info;
-      ret->m = gavl_stream_get_metadata_nc(stream_info);
-      ret->afmt = gavl_stream_get_audio_format_nc(ret->info);
-      ret->vfmt = gavl_stream_get_video_format_nc(ret->info);
+    ret = calloc(1, sizeof(*ret));
+    ret->ci = ci;
+    ret->info = stream_info;
+    ret->m = gavl_stream_get_metadata_nc(stream_info);
+    ret->afmt = gavl_stream_get_audio_format_nc(ret->info);
+    ret->vfmt = gavl_stream_get_video_format_nc(ret->info);
       
-      gavl_dictionary_get_int(ret->m, GAVL_META_STREAM_PACKET_TIMESCALE, &ret->packet_timescale);
+    gavl_dictionary_get_int(ret->m, GAVL_META_STREAM_PACKET_TIMESCALE, &ret->packet_timescale);
       
-      ret->stream_flags = stream_flags;
-      ret->fourcc = fourcc;
+    ret->stream_flags = stream_flags;
+    ret->fourcc = fourcc;
       
-      parsers[idx].func(ret);
-      break;
-      }
-    idx++;
+    parsers[idx[0]].func(ret);
     }
   
   if(!ret)
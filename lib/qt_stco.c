@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <stdio.h>
@@ -43,40 +44,43 @@ typedef struct
 int bgav_qt_stco_read(qt_atom_header_t * h,
                       bgav_input_context_t * input, qt_stco_t * ret)
   {
-  uint32_t i, tmp;
+  uint32_t i;
+  uint32_t * tmp;
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
-  if(!bgav_input_read_32_be(input, &ret->num_entries))
+  if(!bgav_input_read_32_be(input, &ret->num_entries) ||
+     (ret->num_entries > INT_MAX))
     return 0;
   
   ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
-  for(i = 0; i < ret->num_entries; i++)
+  tmp = malloc(ret->num_entries * sizeof(*tmp));
+  
+  if(!bgav_input_read_array_32_be(input, tmp, ret->num_entries))
     {
-    if(!bgav_input_read_32_be(input, &tmp))
-      return 0;
-    ret->entries[i] = tmp;
+    free(tmp);
+    return 0;
     }
+  
+  for(i = 0; i < ret->num_entries; i++)
+    ret->entries[i] = tmp[i];
+
+  free(tmp);
   return 1;
   }
 
 int bgav_qt_stco_read_64(qt_atom_header_t * h,
                          bgav_input_context_t * input, qt_stco_t * ret)
   {
-  uint32_t i;
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
-  if(!bgav_input_read_32_be(input, &ret->num_entries))
+  if(!bgav_input_read_32_be(input, &ret->num_entries) ||
+     (ret->num_entries > INT_MAX))
     return 0;
   
   ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
-  for(i = 0; i < ret->num_entries; i++)
-    {
-    if(!bgav_input_read_64_be(input, &ret->entries[i]))
-      return 0;
-    }
-  return 1;
+  return bgav_input_read_array_64_be(input, ret->entries, ret->num_entries);
   }
 
 
@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <stdio.h>
@@ -48,22 +49,18 @@ typedef struct
 int bgav_qt_stsc_read(qt_atom_header_t * h,
                       bgav_input_context_t * input, qt_stsc_t * ret)
   {
-  uint32_t i;
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
-  if(!bgav_input_read_32_be(input, &ret->num_entries))
+  if(!bgav_input_read_32_be(input, &ret->num_entries) ||
+     (ret->num_entries > INT_MAX / 3))
     return 0;
   
   ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
-  for(i = 0; i < ret->num_entries; i++)
-    {
-    if(!bgav_input_read_32_be(input, &ret->entries[i].first_chunk) ||
-       !bgav_input_read_32_be(input, &ret->entries[i].samples_per_chunk) ||
-       !bgav_input_read_32_be(input, &ret->entries[i].sample_description_id))
-      return 0;
-    }
-  return 1;
+
+  /* Entries are triples of 32 bit integers */
+  return bgav_input_read_array_32_be(input, (uint32_t*)ret->entries,
+                                     ret->num_entries * 3);
   }
 
 void bgav_qt_stsc_free(qt_stsc_t * c)
@@ -23,6 +23,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <stdio.h>
@@ -43,21 +44,16 @@
 int bgav_qt_stss_read(qt_atom_header_t * h,
                       bgav_input_context_t * input, qt_stss_t * ret)
   {
-  uint32_t i;
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
-  if(!bgav_input_read_32_be(input, &ret->num_entries))
+  if(!bgav_input_read_32_be(input, &ret->num_entries) ||
+     (ret->num_entries > INT_MAX))
     return 0;
 
   ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
   
-  for(i = 0; i < ret->num_entries; i++)
-    {
-    if(!bgav_input_read_32_be(input, &ret->entries[i]))
-      return 0;
-    }
-  return 1;
+  return bgav_input_read_array_32_be(input, ret->entries, ret->num_entries);
   }
 
 void bgav_qt_stss_free(qt_stss_t * c)
@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <stdio.h>
@@ -43,7 +44,6 @@ typedef struct
 int bgav_qt_stsz_read(qt_atom_header_t * h,
                       bgav_input_context_t * input, qt_stsz_t * ret)
   {
-  uint32_t i;
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
@@ -53,12 +53,11 @@ int bgav_qt_stsz_read(qt_atom_header_t * h,
   
   if(!ret->sample_size)
     {
+    if(ret->num_entries > INT_MAX)
+      return 0;
     ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
-    for(i = 0; i < ret->num_entries; i++)
-      {
-      if(!bgav_input_read_32_be(input, &ret->entries[i]))
-        return 0;
-      }
+    if(!bgav_input_read_array_32_be(input, ret->entries, ret->num_entries))
+      return 0;
     }
   return 1;
   }
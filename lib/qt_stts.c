@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <avdec_private.h>
 #include <stdio.h>
@@ -46,23 +47,18 @@
 int bgav_qt_stts_read(qt_atom_header_t * h,
                       bgav_input_context_t * input, qt_stts_t * ret)
   {
-  uint32_t i;
-
   READ_VERSION_AND_FLAGS;
   memcpy(&ret->h, h, sizeof(*h));
   
-  if(!bgav_input_read_32_be(input, &ret->num_entries))
+  if(!bgav_input_read_32_be(input, &ret->num_entries) ||
+     (ret->num_entries > INT_MAX / 2))
     return 0;
 
   ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
-  
-  for(i = 0; i < ret->num_entries; i++)
-    {
-    if(!bgav_input_read_32_be(input, &ret->entries[i].count) ||
-       !bgav_input_read_32_be(input, &ret->entries[i].duration))
-      return 0;
-    }
-  return 1;
+
+  /* Entries are pairs of 32 bit integers */
+  return bgav_input_read_array_32_be(input, (uint32_t*)ret->entries,
+                                     ret->num_entries * 2);
   }
 
 void bgav_qt_stts_free(qt_stts_t * c)
@@ -86,10 +86,26 @@ int64_t bgav_video_start_time(bgav_t * bgav, int stream)
   return s->stats.pts_start;
   }
 
+/* A windowed index has only the packets around the current position */
+
+static int check_keyframe_index(bgav_stream_t * s)
+  {
+  if(!s->demuxer->si)
+    return 0;
+
+  if(s->demuxer->flags & BGAV_DEMUXER_SI_WINDOW)
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN,
+             "Keyframe search is not supported with a windowed index");
+    return 0;
+    }
+  return 1;
+  }
+
 static int64_t bgav_video_stream_keyframe_before(bgav_stream_t * s, int64_t time)
   {
   int pos;
-  if(!s->demuxer->si)
+  if(!check_keyframe_index(s))
     return GAVL_TIME_UNDEFINED;
   
   pos = s->demuxer->si->num_entries -1;
@@ -120,7 +136,7 @@ static int64_t bgav_video_stream_keyframe_after(bgav_stream_t * s, int64_t time)
   {
   int pos;
 
-  if(!s->demuxer->si)
+  if(!check_keyframe_index(s))
     return GAVL_TIME_UNDEFINED;
 
   pos = 0;
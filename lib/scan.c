@@ -0,0 +1,188 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Batch scanning.
+ *
+ *  Each worker owns one decoder, which is opened with bgav_open_scan()
+ *  for one location after the other and reset in between. The options
+ *  are therefore copied only once per worker and the number of open
+ *  files is bounded by the number of workers.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "scan"
+
+typedef struct
+  {
+  bgav_scan_t * s;
+  bgav_t * b;
+  pthread_t thread;
+  } worker_t;
+
+struct bgav_scan_s
+  {
+  int num_workers;
+  worker_t * workers;
+
+  bgav_scan_callback cb;
+  void * cb_data;
+
+  pthread_mutex_t mutex;    /* Protects the members below */
+  pthread_mutex_t cb_mutex; /* Serializes the callbacks   */
+
+  const char * const * locations;
+  int num_locations;
+  int next_location;
+  int num_opened;
+  };
+
+static void scan_location(worker_t * w, const char * location)
+  {
+  bgav_scan_t * s = w->s;
+  const gavl_dictionary_t * info = NULL;
+
+  if(bgav_open_scan(w->b, location))
+    info = bgav_get_media_info(w->b);
+  else
+    gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Cannot open %s", location);
+
+  pthread_mutex_lock(&s->cb_mutex);
+  s->cb(s->cb_data, location, info);
+  pthread_mutex_unlock(&s->cb_mutex);
+
+  bgav_reset(w->b);
+
+  if(info)
+    {
+    pthread_mutex_lock(&s->mutex);
+    s->num_opened++;
+    pthread_mutex_unlock(&s->mutex);
+    }
+  }
+
+static void * worker_func(void * data)
+  {
+  worker_t * w = data;
+  bgav_scan_t * s = w->s;
+  const char * location;
+
+  while(1)
+    {
+    pthread_mutex_lock(&s->mutex);
+    if(s->next_location >= s->num_locations)
+      {
+      pthread_mutex_unlock(&s->mutex);
+      break;
+      }
+    location = s->locations[s->next_location++];
+    pthread_mutex_unlock(&s->mutex);
+
+    scan_location(w, location);
+    }
+  return NULL;
+  }
+
+bgav_scan_t * bgav_scan_create(const bgav_options_t * opt, int num_threads,
+                               bgav_scan_callback cb, void * cb_data)
+  {
+  int i;
+  bgav_scan_t * ret;
+
+  if(num_threads <= 0)
+    num_threads = gavl_num_cpus();
+  if(num_threads <= 0)
+    num_threads = 1;
+
+  ret = calloc(1, sizeof(*ret));
+
+  ret->cb = cb;
+  ret->cb_data = cb_data;
+
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_mutex_init(&ret->cb_mutex, NULL);
+
+  ret->num_workers = num_threads;
+  ret->workers = calloc(ret->num_workers, sizeof(*ret->workers));
+
+  for(i = 0; i < ret->num_workers; i++)
+    {
+    ret->workers[i].s = ret;
+    ret->workers[i].b = bgav_create();
+    if(opt)
+      bgav_options_copy(bgav_get_options(ret->workers[i].b), opt);
+    }
+
+  /* Do this here rather than concurrently in the first bgav_open() calls */
+  bgav_codecs_init(bgav_get_options(ret->workers[0].b));
+
+  return ret;
+  }
+
+int bgav_scan_files(bgav_scan_t * s, const char * const * locations, int num)
+  {
+  int i;
+  int num_threads;
+
+  s->locations = locations;
+  s->num_locations = num;
+  s->next_location = 0;
+  s->num_opened = 0;
+
+  num_threads = s->num_workers;
+  if(num_threads > num)
+    num_threads = num;
+
+  if(num_threads <= 1)
+    {
+    if(num > 0)
+      worker_func(&s->workers[0]);
+    }
+  else
+    {
+    for(i = 0; i < num_threads; i++)
+      pthread_create(&s->workers[i].thread, NULL, worker_func, &s->workers[i]);
+    for(i = 0; i < num_threads; i++)
+      pthread_join(s->workers[i].thread, NULL);
+    }
+
+  s->locations = NULL;
+  s->num_locations = 0;
+
+  return s->num_opened;
+  }
+
+void bgav_scan_destroy(bgav_scan_t * s)
+  {
+  int i;
+
+  for(i = 0; i < s->num_workers; i++)
+    bgav_close(s->workers[i].b);
+  free(s->workers);
+
+  pthread_mutex_destroy(&s->mutex);
+  pthread_mutex_destroy(&s->cb_mutex);
+  free(s);
+  }
@@ -30,12 +30,20 @@
 
 #define LOG_DOMAIN "seek"
 
+/* Log iterative seeks, which end up more than this before the goal */
+#define SEEK_FAR_OFF (10 * GAVL_TIME_SCALE)
+
 // #define DUMP_ITERATIVE
 
 static int skip_to(bgav_t * b, bgav_track_t * track, int64_t * time, int scale)
   {
+  int ret;
   //  fprintf(stderr, "Skip to: %ld\n", *time);
-  if(!bgav_track_skipto(track, time, scale))
+  BGAV_TRACE_BEGIN("seek_skip");
+  ret = bgav_track_skipto(track, time, scale);
+  BGAV_TRACE_END("seek_skip");
+
+  if(!ret)
     {
     b->flags |= BGAV_FLAG_EOF;
     return 0;
@@ -77,6 +85,8 @@ static int seek_si(bgav_t * b, bgav_demuxer_context_t * ctx,
     
   track = ctx->tt->cur;
   bgav_track_clear(track);
+
+  bgav_demuxer_load_si_window(ctx, time, scale);
   
   /* Seek the start chunks indices of all streams */
   
@@ -193,15 +203,98 @@ typedef struct
   int64_t sync_time;
   } seek_tab_t;
 
+/* Time <-> position map */
+
+#define MAX_SEEK_POINTS 4096
+
+void bgav_seek_map_add(bgav_track_t * t, int64_t position, gavl_time_t time)
+  {
+  int i;
+  
+  /* Find insertion point */
+  for(i = 0; i < t->num_seek_points; i++)
+    {
+    if(t->seek_points[i].position >= position)
+      break;
+    }
+
+  if((i < t->num_seek_points) && (t->seek_points[i].position == position))
+    {
+    t->seek_points[i].time = time;
+    return;
+    }
+
+  /* Don't store points, which are inconsistent with their neighbours */
+  if(((i > 0) && (t->seek_points[i-1].time > time)) ||
+     ((i < t->num_seek_points) && (t->seek_points[i].time < time)))
+    return;
+  
+  if(t->num_seek_points >= MAX_SEEK_POINTS)
+    return;
+  
+  if(t->num_seek_points + 1 > t->seek_points_alloc)
+    {
+    t->seek_points_alloc += 64;
+    t->seek_points = realloc(t->seek_points,
+                             t->seek_points_alloc * sizeof(*t->seek_points));
+    }
+
+  if(i < t->num_seek_points)
+    memmove(t->seek_points + i + 1, t->seek_points + i,
+            (t->num_seek_points - i) * sizeof(*t->seek_points));
+
+  t->seek_points[i].position = position;
+  t->seek_points[i].time     = time;
+  t->num_seek_points++;
+  }
+
+/* Narrow the initial search interval with already known resync points */
+
+static void seek_map_bracket(bgav_track_t * t, int64_t total_bytes,
+                             int64_t time, int scale, seek_tab_t * tab)
+  {
+  int i;
+  int64_t sync_time;
+  
+  for(i = 0; i < t->num_seek_points; i++)
+    {
+    sync_time = gavl_time_scale(scale, t->seek_points[i].time);
+    
+    if((sync_time <= time) && (sync_time >= tab[0].sync_time))
+      {
+      tab[0].sync_time = sync_time;
+      tab[0].percentage = (double)(t->seek_points[i].position - t->data_start) /
+        (double)total_bytes;
+      }
+    else if((sync_time > time) && (sync_time < tab[1].sync_time))
+      {
+      tab[1].sync_time = sync_time;
+      tab[1].percentage = (double)(t->seek_points[i].position - t->data_start) /
+        (double)total_bytes;
+      }
+    }
+  }
+
 static int64_t seek_test(bgav_t * b, int64_t filepos, int scale)
   {
+  int64_t ret;
+  int result;
   bgav_track_clear(b->tt->cur);
   bgav_input_seek(b->input, filepos, SEEK_SET);
 
-  if(!b->demuxer->demuxer->post_seek_resync(b->demuxer))
+  BGAV_TRACE_BEGIN("seek_test");
+  result = b->demuxer->demuxer->post_seek_resync(b->demuxer);
+  BGAV_TRACE_END("seek_test");
+  
+  if(!result)
     return GAVL_TIME_UNDEFINED; // EOF
 
-  return bgav_track_sync_time(b->tt->cur, scale);
+  ret = bgav_track_sync_time(b->tt->cur, scale);
+
+  if(ret != GAVL_TIME_UNDEFINED)
+    bgav_seek_map_add(b->tt->cur, filepos, gavl_time_unscale(scale, ret));
+  
+  return ret;
   }
 
 /* Time can have an arbitrary scale but the zero point must be the same
@@ -252,6 +345,8 @@ static int seek_generic(bgav_t * b, int64_t * time, int scale)
   tab[0].percentage  = 0.0;
   tab[1].sync_time = gavl_time_scale(scale, end_time);
   tab[1].percentage  = 1.0;
+
+  seek_map_bracket(b->tt->cur, total_bytes, *time, scale, tab);
   
   for(i = 0; i < 6; i++)
     {
@@ -301,6 +396,12 @@ static int seek_generic(bgav_t * b, int64_t * time, int scale)
   
   gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Seek generic: Seeks: %d, goal: %"PRId64", reached: %"PRId64" diff: %"PRId64,
            num_seeks, *time, sync_time, *time - sync_time);
+
+  if(gavl_time_unscale(scale, *time - sync_time) > SEEK_FAR_OFF)
+    gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+             "Seek generic landed far off: %f seconds before goal after %d seeks (%d known resync points)",
+             gavl_time_to_seconds(gavl_time_unscale(scale, *time - sync_time)),
+             num_seeks, b->tt->cur->num_seek_points);
   
   bgav_track_resync(b->tt->cur);
 
@@ -329,6 +430,10 @@ static int seek_input(bgav_t * b, int64_t * time, int scale)
 
 int bgav_ensure_index(bgav_t * b)
   {
+  /* We won't get a complete index */
+  if(b->demuxer->flags & BGAV_DEMUXER_SI_WINDOW)
+    return 0;
+  
   if(b->demuxer->si)
     return 1;
   
@@ -341,7 +446,11 @@ int bgav_ensure_index(bgav_t * b)
        !location)
       return 0;
     
-    if((b->demuxer->si = bgav_get_packet_index(location)))
+    BGAV_TRACE_BEGIN("build_index");
+    b->demuxer->si = bgav_get_packet_index(location, &b->opt);
+    BGAV_TRACE_END("build_index");
+    
+    if(b->demuxer->si)
       {
       //      gavl_dprintf("Built packet index:\n");
       //      gavl_packet_index_dump(b->demuxer->si);
@@ -357,8 +466,8 @@ int bgav_ensure_index(bgav_t * b)
   return 0;
   }
 
-int
-bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
+static int
+seek_scaled(bgav_t * b, int64_t * time, int scale)
   {
   bgav_track_t * track = b->tt->cur;
 
@@ -390,7 +499,10 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
     if(!bgav_ensure_index(b))
       gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN, "Sample accurate seeking not supported for format");
     }
-    
+
+  /* Seek index built on demand */
+  bgav_demuxer_load_si(b->demuxer);
+  
   if(b->demuxer->si)
     return seek_si(b, b->demuxer, *time, scale);
   else if(b->input->flags & BGAV_INPUT_CAN_SEEK_TIME)
@@ -398,7 +510,8 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
     return seek_input(b, time, scale);
     }
   /* Seek once */
-  else if(b->demuxer->demuxer->seek)
+  else if(b->demuxer->demuxer->seek &&
+          !(b->demuxer->flags & BGAV_DEMUXER_SEEK_ITERATIVE))
     return seek_once(b, time, scale);
   /* Seek iterative */
   else if(b->demuxer->demuxer->post_seek_resync)
@@ -419,6 +532,16 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
   return 0;
   }
 
+int
+bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
+  {
+  int ret;
+  BGAV_TRACE_BEGIN("seek");
+  ret = seek_scaled(b, time, scale);
+  BGAV_TRACE_END("seek");
+  return ret;
+  }
+
 int
 bgav_seek_to_video_frame(bgav_t * b, int stream, int frame)
   {
@@ -430,6 +553,14 @@ bgav_seek_to_video_frame(bgav_t * b, int stream, int frame)
     pts = s->stats.pts_start + frame * s->data.video.format->frame_duration;
   else if(!(s->ci->flags & GAVL_COMPRESSION_HAS_B_FRAMES))
     {
+    /* Packet numbers in a windowed index are relative to the window */
+    if(!b->demuxer->si || (b->demuxer->flags & BGAV_DEMUXER_SI_WINDOW))
+      {
+      gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN,
+               "Seeking to frames needs a complete packet index");
+      return 0;
+      }
+    
     pts = gavl_packet_index_packet_number_to_pts(b->demuxer->si,
                                                  s->stream_id,
                                                  frame);
@@ -438,26 +569,16 @@ bgav_seek_to_video_frame(bgav_t * b, int stream, int frame)
     }
   else /* B-frames and nonconstant framerate */
     {
-    if(!s->data.video.frame_table)
-      {
-      if(!bgav_ensure_index(b))
-        return 0;
-      
-      s->data.video.frame_table = gavl_packet_index_create(0);
-      
-      gavl_packet_index_extract_stream(b->demuxer->si,
-                                       s->data.video.frame_table,
-                                       s->stream_id);
-      gavl_packet_index_sort_by_pts(s->data.video.frame_table);
-      }
+    if(!bgav_video_ensure_frame_table(b, stream))
+      return 0;
 
-    if((frame < 0) || (frame >= s->data.video.frame_table->num_entries))
+    if((frame < 0) || (frame >= gavl_frame_table_num_frames(s->data.video.frame_table)))
       {
       gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Frame index %d out of range (must be between zero and %"PRId64")",
                frame, bgav_get_num_video_frames(b, stream));
       return 0;
       }
-    pts = s->data.video.frame_table->entries[frame].pts;
+    pts = gavl_frame_table_frame_to_time(s->data.video.frame_table, frame, NULL);
     }
   return bgav_seek_scaled(b, &pts, s->data.video.format->timescale);
   }
@@ -210,6 +210,8 @@ void bgav_stream_clear(bgav_stream_t * s)
   if(s->packet)
     s->packet = NULL;
 
+  gavl_buffer_reset(&s->si_cache);
+
   if(s->pf)
     bgav_packet_filter_reset(s->pf);
   
@@ -346,6 +348,7 @@ void bgav_stream_free(bgav_stream_t * s)
   gavl_compression_info_free(&s->ci_orig);
 
   gavl_dictionary_free(&s->in_info);
+  gavl_buffer_free(&s->si_cache);
 
   }
 
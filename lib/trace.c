@@ -0,0 +1,278 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <avdec_private.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_TRACE
+#include <time.h>
+#include <pthread.h>
+#endif
+
+#define LOG_DOMAIN "trace"
+
+/*
+ *  Pipeline tracer: Begin/end events are recorded into per-thread ring
+ *  buffers and written in the Chrome trace event format when the
+ *  decoder, which started the trace, is closed. Only one trace can be
+ *  active per process. Decoders opened while a trace is running (e.g. for
+ *  building an index) write into that trace.
+ */
+
+#ifdef HAVE_TRACE
+
+/* Events per thread, older events are overwritten */
+#define RING_SIZE (1<<16)
+
+typedef struct
+  {
+  const char * name;
+  int64_t time; /* Nanoseconds since start of the trace */
+  char phase;
+  } event_t;
+
+typedef struct buffer_s
+  {
+  event_t * events;
+  int64_t num_events; /* Events written so far */
+  int tid;
+  int in_use;         /* Thread is still alive */
+  struct buffer_s * next;
+  } buffer_t;
+
+int bgav_trace_active = 0;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  trace_once  = PTHREAD_ONCE_INIT;
+static pthread_key_t   trace_key;
+
+static buffer_t * buffers = NULL;
+static char * trace_file = NULL;
+static struct timespec start_time;
+static int next_tid = 1;
+
+static void thread_exit(void * data)
+  {
+  buffer_t * buf = data;
+  pthread_mutex_lock(&trace_mutex);
+  buf->in_use = 0;
+  pthread_mutex_unlock(&trace_mutex);
+  }
+
+static void create_key(void)
+  {
+  pthread_key_create(&trace_key, thread_exit);
+  }
+
+static buffer_t * register_thread(void)
+  {
+  buffer_t * buf;
+
+  pthread_mutex_lock(&trace_mutex);
+
+  /* Reuse the buffer of a finished thread if it was written already */
+  buf = buffers;
+  while(buf)
+    {
+    if(!buf->in_use && !buf->num_events)
+      break;
+    buf = buf->next;
+    }
+
+  if(!buf)
+    {
+    buf = calloc(1, sizeof(*buf));
+    buf->events = malloc(RING_SIZE * sizeof(*buf->events));
+    buf->next = buffers;
+    buffers = buf;
+    }
+
+  buf->tid = next_tid++;
+  buf->in_use = 1;
+  pthread_mutex_unlock(&trace_mutex);
+
+  pthread_setspecific(trace_key, buf);
+  return buf;
+  }
+
+void bgav_trace_event(const char * name, char phase)
+  {
+  buffer_t * buf;
+  event_t * e;
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  if(!(buf = pthread_getspecific(trace_key)))
+    buf = register_thread();
+
+  e = buf->events + (buf->num_events & (RING_SIZE-1));
+
+  e->name  = name;
+  e->phase = phase;
+  e->time  = (int64_t)(t.tv_sec - start_time.tv_sec) * 1000000000 +
+    (t.tv_nsec - start_time.tv_nsec);
+
+  buf->num_events++;
+  }
+
+static int start_trace(const char * filename)
+  {
+  pthread_mutex_lock(&trace_mutex);
+
+  if(trace_file)
+    {
+    pthread_mutex_unlock(&trace_mutex);
+    return 0;
+    }
+
+  pthread_once(&trace_once, create_key);
+
+  trace_file = gavl_strdup(filename);
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  /* Release: threads seeing the flag also see the key and start time */
+  __atomic_store_n(&bgav_trace_active, 1, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&trace_mutex);
+
+  gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Tracing to %s", filename);
+  return 1;
+  }
+
+static void write_buffer(FILE * out, const buffer_t * buf, int * first)
+  {
+  int64_t i, start;
+  const event_t * e;
+
+  if(!buf->num_events)
+    return;
+
+  fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+          "\"args\":{\"name\":\"Thread %d\"}}",
+          (*first ? "" : ","), buf->tid, buf->tid);
+  *first = 0;
+
+  start = buf->num_events - RING_SIZE;
+  if(start < 0)
+    start = 0;
+  else
+    gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+             "Thread %d: Dropped %"PRId64" events", buf->tid, start);
+
+  for(i = start; i < buf->num_events; i++)
+    {
+    e = buf->events + (i & (RING_SIZE-1));
+    fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRId64".%03d,\"pid\":1,\"tid\":%d}",
+            e->name, e->phase, e->time / 1000, (int)(e->time % 1000), buf->tid);
+    }
+  }
+
+static void stop_trace(void)
+  {
+  FILE * out;
+  buffer_t * buf;
+  buffer_t ** prev;
+  int first = 1;
+
+  /* Threads still running might add a last event while we write the file */
+  __atomic_store_n(&bgav_trace_active, 0, __ATOMIC_RELEASE);
+
+  pthread_mutex_lock(&trace_mutex);
+
+  if((out = fopen(trace_file, "w")))
+    {
+    fprintf(out, "{\"traceEvents\":[");
+
+    buf = buffers;
+    while(buf)
+      {
+      write_buffer(out, buf, &first);
+      buf = buf->next;
+      }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+    gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Wrote %s", trace_file);
+    }
+  else
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Cannot open %s: %s",
+             trace_file, strerror(errno));
+
+  /* Free buffers of finished threads, reset the others */
+  prev = &buffers;
+  while(*prev)
+    {
+    buf = *prev;
+    if(buf->in_use)
+      {
+      buf->num_events = 0;
+      prev = &buf->next;
+      }
+    else
+      {
+      *prev = buf->next;
+      free(buf->events);
+      free(buf);
+      }
+    }
+
+  free(trace_file);
+  trace_file = NULL;
+
+  pthread_mutex_unlock(&trace_mutex);
+  }
+
+#endif // HAVE_TRACE
+
+void bgav_trace_init(bgav_t * b)
+  {
+  const char * filename;
+
+  if(b->flags & BGAV_FLAG_TRACE)
+    return;
+
+  if(!(filename = gavl_dictionary_get_string(&b->opt, BGAV_OPT_TRACE_FILE)) ||
+     (*filename == '\0'))
+    return;
+
+#ifdef HAVE_TRACE
+  if(start_trace(filename))
+    b->flags |= BGAV_FLAG_TRACE;
+#else
+  gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+           "Not writing %s: Tracing is disabled (configure with --enable-trace)",
+           filename);
+  /* Warn only once */
+  b->flags |= BGAV_FLAG_TRACE;
+#endif
+  }
+
+void bgav_trace_close(bgav_t * b)
+  {
+#ifdef HAVE_TRACE
+  if(b->flags & BGAV_FLAG_TRACE)
+    stop_trace();
+#endif
+  b->flags &= ~BGAV_FLAG_TRACE;
+  }
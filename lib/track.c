@@ -501,6 +501,8 @@ void bgav_track_free(bgav_track_t * t)
       }
     free(t->streams);
     }
+  if(t->seek_points)
+    free(t->seek_points);
   }
 
 static void remove_stream_abs(bgav_track_t * t, int idx)
@@ -695,6 +697,9 @@ void bgav_track_resync(bgav_track_t * track)
   {
   int i;
   bgav_stream_t * s;
+
+  BGAV_TRACE_BEGIN("resync");
+  
   for(i = 0; i < track->num_audio_streams; i++)
     {
     s = bgav_track_get_audio_stream(track, i);
@@ -712,6 +717,7 @@ void bgav_track_resync(bgav_track_t * track)
       continue;
     bgav_video_resync(s);
     }
+  BGAV_TRACE_END("resync");
   }
 
 int bgav_track_skipto(bgav_track_t * track, int64_t * time, int scale)
@@ -837,6 +843,9 @@ int64_t bgav_track_sync_time(bgav_track_t * t, int scale)
     if(!check_sync_time(s, &ret))
       return GAVL_TIME_UNDEFINED;
     }
+  /* Subtitle only tracks have no sync time */
+  if(ret == GAVL_TIME_UNDEFINED)
+    return ret;
   return gavl_time_scale(scale, ret);
   }
 
@@ -454,3 +454,120 @@ uint32_t * bgav_get_vobsub_palette(const char * str)
   return pal;  
   }
 
+
+/*
+ *  Immutable fourcc lookup table. Built once from a flat list of
+ *  keys, each key maps to the indices (in insertion order) under
+ *  which it was added. After building, lookups only read the table
+ *  so they can be done from any thread without locking.
+ */
+
+static uint32_t fourcc_hash(uint32_t key)
+  {
+  key ^= key >> 16;
+  key *= 0x45d9f3bU;
+  key ^= key >> 16;
+  return key;
+  }
+
+static int fourcc_table_find_slot(const bgav_fourcc_table_t * t, uint32_t key)
+  {
+  uint32_t idx = fourcc_hash(key) & t->mask;
+
+  while(t->slots[idx].num && (t->slots[idx].key != key))
+    idx = (idx + 1) & t->mask;
+  return idx;
+  }
+
+void bgav_fourcc_table_init(bgav_fourcc_table_t * t,
+                            const uint32_t * keys, int num_keys)
+  {
+  int i;
+  int idx;
+  int size = 8;
+  int * fill;
+  
+  memset(t, 0, sizeof(*t));
+
+  /* Load factor <= 0.5 */
+  while(size < 2 * num_keys)
+    size <<= 1;
+
+  t->mask = size - 1;
+  t->slots = calloc(size, sizeof(*t->slots));
+  t->indices = calloc(num_keys + 1, sizeof(*t->indices));
+
+  /* Count */
+  for(i = 0; i < num_keys; i++)
+    {
+    idx = fourcc_table_find_slot(t, keys[i]);
+    t->slots[idx].key = keys[i];
+    t->slots[idx].num++;
+    }
+
+  /* Assign ranges */
+  idx = 0;
+  for(i = 0; i < size; i++)
+    {
+    if(!t->slots[i].num)
+      continue;
+    t->slots[i].first = idx;
+    idx += t->slots[i].num;
+    }
+
+  /* Fill in insertion order */
+  fill = calloc(size, sizeof(*fill));
+  
+  for(i = 0; i < num_keys; i++)
+    {
+    idx = fourcc_table_find_slot(t, keys[i]);
+    t->indices[t->slots[idx].first + fill[idx]] = i;
+    fill[idx]++;
+    }
+  free(fill);
+  }
+
+const int * bgav_fourcc_table_get(const bgav_fourcc_table_t * t,
+                                  uint32_t key, int * num)
+  {
+  int idx;
+  
+  if(!t->slots)
+    {
+    *num = 0;
+    return NULL;
+    }
+  
+  idx = fourcc_table_find_slot(t, key);
+  
+  if(!t->slots[idx].num)
+    {
+    *num = 0;
+    return NULL;
+    }
+  *num = t->slots[idx].num;
+  return t->indices + t->slots[idx].first;
+  }
+
+void bgav_fourcc_table_free(bgav_fourcc_table_t * t)
+  {
+  if(t->slots)
+    free(t->slots);
+  if(t->indices)
+    free(t->indices);
+  memset(t, 0, sizeof(*t));
+  }
+
+uint32_t bgav_string_hash(const char * str)
+  {
+  /* FNV-1a */
+  uint32_t ret = 2166136261U;
+
+  while(*str)
+    {
+    ret ^= (uint8_t)(*str);
+    ret *= 16777619U;
+    str++;
+    }
+  return ret;
+  }
@@ -250,6 +250,16 @@ int bgav_video_has_still(bgav_t * bgav, int stream)
   return check_still(s);
   }
 
+static gavl_source_status_t decode_video(bgav_stream_t * s,
+                                         gavl_video_frame_t * frame)
+  {
+  gavl_source_status_t st;
+  BGAV_TRACE_BEGIN("decode_video");
+  st = s->data.video.decoder->decode(s, frame);
+  BGAV_TRACE_END("decode_video");
+  return st;
+  }
+
 static gavl_source_status_t
 read_video_nocopy(void * sp,
                   gavl_video_frame_t ** frame)
@@ -259,7 +269,7 @@ read_video_nocopy(void * sp,
   //  fprintf(stderr, "Read video nocopy\n");
   if(!check_still(s))
     return GAVL_SOURCE_AGAIN;
-  if((st = s->data.video.decoder->decode(sp, NULL)) != GAVL_SOURCE_OK)
+  if((st = decode_video(s, NULL)) != GAVL_SOURCE_OK)
     {
     // fprintf(stderr, "EOF :)\n");
     if(st == GAVL_SOURCE_EOF)
@@ -286,7 +296,7 @@ static gavl_source_status_t read_video_copy(void * sp,
   
   if(frame)
     {
-    if((st = s->data.video.decoder->decode(sp, *frame)) != GAVL_SOURCE_OK)
+    if((st = decode_video(s, *frame)) != GAVL_SOURCE_OK)
       {
       if(st == GAVL_SOURCE_EOF)
         gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Detected EOF 2");
@@ -296,7 +306,7 @@ static gavl_source_status_t read_video_copy(void * sp,
     }
   else
     {
-    if((st = s->data.video.decoder->decode(sp, NULL)) != GAVL_SOURCE_OK)
+    if((st = decode_video(s, NULL)) != GAVL_SOURCE_OK)
       {
       if(st == GAVL_SOURCE_EOF)
         gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Detected EOF 3");
@@ -311,6 +321,49 @@ static gavl_source_status_t read_video_copy(void * sp,
   return GAVL_SOURCE_OK;
   }
 
+static gavl_source_status_t read_video_threads(void * sp,
+                                               gavl_video_frame_t ** frame)
+  {
+  gavl_source_status_t st;
+  gavl_video_frame_t * f = NULL;
+  bgav_stream_t * s = sp;
+  
+  if(!check_still(s))
+    return GAVL_SOURCE_AGAIN;
+
+  if((st = bgav_video_threads_read(s->data.video.threads, &f)) != GAVL_SOURCE_OK)
+    {
+    if(st == GAVL_SOURCE_EOF)
+      gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Detected EOF 4");
+    return st;
+    }
+  if(frame)
+    *frame = f;
+#ifdef DUMP_TIMESTAMPS
+  gavl_dprintf("Video timestamp: %"PRId64"\n", f->timestamp);
+#endif    
+  s->out_time = f->timestamp + f->duration;
+  s->flags &= ~STREAM_HAVE_FRAME;
+  return GAVL_SOURCE_OK;
+  }
+
+/* Check if we can decode frames in parallel */
+
+static int get_num_threads(bgav_stream_t * s)
+  {
+  int ret = 1;
+  
+  if(!s->data.video.decoder->worker_decode ||
+     s->data.video.vsrc ||   /* Decoder has its own source */
+     s->vframe ||            /* Decoder outputs packet memory directly */
+     STREAM_IS_STILL(s) ||
+     (s->ci->flags & (GAVL_COMPRESSION_HAS_P_FRAMES|GAVL_COMPRESSION_HAS_B_FRAMES)))
+    return 1;
+
+  gavl_dictionary_get_int(s->opt, BGAV_OPT_VIDEO_THREADS, &ret);
+  return ret;
+  }
+
 int bgav_video_init(bgav_stream_t * s)
   {
   bgav_set_video_compression_info(s);
@@ -420,7 +473,18 @@ int bgav_video_start(bgav_stream_t * s)
     if(s->vframe)
       src_flags |= GAVL_SOURCE_SRC_ALLOC;
 
-    if(!s->data.video.vsrc)
+    if((result = get_num_threads(s)) > 1)
+      s->data.video.threads = bgav_video_threads_create(s, result);
+    
+    if(s->data.video.threads)
+      {
+      s->data.video.vsrc_priv =
+        gavl_video_source_create(read_video_threads,
+                                 s, src_flags | GAVL_SOURCE_SRC_ALLOC,
+                                 s->data.video.format);
+      s->data.video.vsrc = s->data.video.vsrc_priv;
+      }
+    else if(!s->data.video.vsrc)
       {
       if(src_flags & GAVL_SOURCE_SRC_ALLOC)
         s->data.video.vsrc_priv =
@@ -506,7 +570,13 @@ void bgav_video_stop(bgav_stream_t * s)
     }
   s->data.video.vsrc = NULL;
 
-
+  /* Workers use the decoder, so stop them first */
+  if(s->data.video.threads)
+    {
+    bgav_video_threads_destroy(s->data.video.threads);
+    s->data.video.threads = NULL;
+    }
+  
   if(s->data.video.decoder)
     {
     s->data.video.decoder->close(s);
@@ -517,7 +587,7 @@ void bgav_video_stop(bgav_stream_t * s)
 
   if(s->data.video.frame_table)
     {
-    gavl_packet_index_destroy(s->data.video.frame_table);
+    gavl_frame_table_destroy(s->data.video.frame_table);
     s->data.video.frame_table = NULL;
     }
   }
@@ -531,6 +601,9 @@ void bgav_video_resync(bgav_stream_t * s)
   
   if(s->data.video.vsrc)
     gavl_video_source_reset(s->data.video.vsrc);
+
+  if(s->data.video.threads)
+    bgav_video_threads_reset(s->data.video.threads);
   
   /* If the stream has keyframes, skip until the next one */
 
@@ -611,6 +684,11 @@ int bgav_video_skipto(bgav_stream_t * s, int64_t * time, int scale)
   /* Easy case: Intra only streams */
   if(!(s->ci->flags & GAVL_COMPRESSION_HAS_P_FRAMES))
     {
+    /* Frames, which are already decoded ahead */
+    if(s->data.video.threads &&
+       bgav_video_threads_skipto(s->data.video.threads, time_scaled, &s->out_time))
+      return 1;
+    
     while(1)
       {
       p = NULL;
@@ -689,63 +767,165 @@ gavl_video_source_t * bgav_get_video_source(bgav_t * bgav, int stream)
   }
 
 
-/* Create frame table from superindex */
+/*
+ *  Create frame table from superindex. The presentation order is
+ *  restored with a sliding window over the packets in decoding order,
+ *  which must be at least as large as the reordering depth.
+ */
+
+#define FRAME_TABLE_WINDOW 32
+
+static int frame_table_append(gavl_frame_table_t * tab, int64_t * last_pts,
+                              int64_t pts)
+  {
+  if(*last_pts == GAVL_TIME_UNDEFINED)
+    tab->offset = pts;
+  else if(pts < *last_pts)
+    return 0;
+  else
+    gavl_frame_table_append_entry(tab, pts - *last_pts);
+  *last_pts = pts;
+  return 1;
+  }
+
+static int compare_pts(const void * p1, const void * p2)
+  {
+  const int64_t * pts1 = p1;
+  const int64_t * pts2 = p2;
+
+  if(*pts1 < *pts2)
+    return -1;
+  else if(*pts1 > *pts2)
+    return 1;
+  return 0;
+  }
+
+/* Fallback for pathological reordering */
 
 static gavl_frame_table_t *
-create_frame_table_si(bgav_stream_t * s, gavl_packet_index_t * si)
+create_frame_table_sorted(bgav_stream_t * s, const gavl_packet_index_t * si,
+                          int64_t last_duration)
   {
   int i;
+  int num = 0;
+  int64_t * pts;
+  int64_t last_pts = GAVL_TIME_UNDEFINED;
   gavl_frame_table_t * ret;
-  int last_non_b_index = -1;
-  
-  ret = gavl_frame_table_create();
+
+  pts = malloc(si->num_entries * sizeof(*pts));
 
   for(i = 0; i < si->num_entries; i++)
     {
     if(si->entries[i].stream_id == s->stream_id)
-      {
-      if((si->entries[i].flags & 0xff) == GAVL_PACKET_TYPE_B)
-        {
-        gavl_frame_table_append_entry(ret, si->entries[i].duration);
-        }
-      else
-        {
-        if(last_non_b_index >= 0)
-          gavl_frame_table_append_entry(ret, si->entries[last_non_b_index].duration);
-        last_non_b_index = i;
-        }
-      }
+      pts[num++] = si->entries[i].pts;
     }
 
-  if(last_non_b_index >= 0)
-    gavl_frame_table_append_entry(ret, si->entries[last_non_b_index].duration);
+  qsort(pts, num, sizeof(*pts), compare_pts);
 
-  /* Maybe we have timecodes in the timecode table */
+  ret = gavl_frame_table_create();
 
-  if(s->timecode_table)
+  for(i = 0; i < num; i++)
+    frame_table_append(ret, &last_pts, pts[i]);
+
+  if(num)
+    gavl_frame_table_append_entry(ret, last_duration);
+
+  free(pts);
+  return ret;
+  }
+
+static gavl_frame_table_t *
+create_frame_table_si(bgav_stream_t * s, const gavl_packet_index_t * si)
+  {
+  int i, j;
+  int num = 0;
+  int64_t window[FRAME_TABLE_WINDOW+1];
+  int64_t last_pts = GAVL_TIME_UNDEFINED;
+  int64_t max_pts = GAVL_TIME_UNDEFINED;
+  int64_t last_duration = 0;
+  gavl_frame_table_t * ret;
+  
+  ret = gavl_frame_table_create();
+
+  for(i = 0; i < si->num_entries; i++)
     {
-    for(i = 0; i < s->timecode_table->num_entries; i++)
+    if(si->entries[i].stream_id != s->stream_id)
+      continue;
+
+    /* Duration of the last frame in presentation order */
+    if((max_pts == GAVL_TIME_UNDEFINED) || (si->entries[i].pts >= max_pts))
       {
-      gavl_frame_table_append_timecode(ret,
-                                       s->timecode_table->entries[i].pts,
-                                       s->timecode_table->entries[i].timecode);
+      max_pts = si->entries[i].pts;
+      last_duration = si->entries[i].duration;
       }
+    
+    /* Insert sorted */
+    j = num;
+    while(j && (window[j-1] > si->entries[i].pts))
+      {
+      window[j] = window[j-1];
+      j--;
+      }
+    window[j] = si->entries[i].pts;
+    num++;
+    
+    if(num > FRAME_TABLE_WINDOW)
+      {
+      if(!frame_table_append(ret, &last_pts, window[0]))
+        goto fail;
+      num--;
+      memmove(window, window + 1, num * sizeof(*window));
+      }
+    }
+
+  for(i = 0; i < num; i++)
+    {
+    if(!frame_table_append(ret, &last_pts, window[i]))
+      goto fail;
     }
   
+  if(last_pts != GAVL_TIME_UNDEFINED)
+    gavl_frame_table_append_entry(ret, last_duration);
+  
   return ret;
+
+  fail:
+  
+  gavl_log(GAVL_LOG_WARNING, LOG_DOMAIN,
+           "Reordering deeper than %d frames, sorting timestamps", FRAME_TABLE_WINDOW);
+  gavl_frame_table_destroy(ret);
+  return create_frame_table_sorted(s, si, last_duration);
   }
 
 gavl_frame_table_t * bgav_get_frame_table(bgav_t * bgav, int stream)
   {
+  int i;
   bgav_stream_t * s;
+  gavl_frame_table_t * ret;
+  
   s = bgav_track_get_video_stream(bgav->tt->cur, stream);
 
-  if(bgav->demuxer->si)
+  if(!s->data.video.frame_table)
     {
-    return create_frame_table_si(s, bgav->demuxer->si);
+    if(!bgav->demuxer->si || (bgav->demuxer->flags & BGAV_DEMUXER_SI_WINDOW))
+      return NULL;
+    s->data.video.frame_table = create_frame_table_si(s, bgav->demuxer->si);
     }
-  else
-    return NULL;
+
+  ret = gavl_frame_table_copy(s->data.video.frame_table);
+  
+  /* Maybe we have timecodes in the timecode table */
+
+  if(s->timecode_table)
+    {
+    for(i = 0; i < s->timecode_table->num_entries; i++)
+      {
+      gavl_frame_table_append_timecode(ret,
+                                       s->timecode_table->entries[i].pts,
+                                       s->timecode_table->entries[i].timecode);
+      }
+    }
+  return ret;
   }
 
 
@@ -885,14 +1065,9 @@ int bgav_video_ensure_frame_table(bgav_t * b, int stream)
   
   if(!bgav_ensure_index(b))
     return 0;
-      
-  s->data.video.frame_table = gavl_packet_index_create(0);
-      
-  gavl_packet_index_extract_stream(b->demuxer->si,
-                                   s->data.video.frame_table,
-                                   s->stream_id);
-  gavl_packet_index_sort_by_pts(s->data.video.frame_table);
-  gavl_packet_index_set_stream_stats(s->data.video.frame_table,
+  
+  s->data.video.frame_table = create_frame_table_si(s, b->demuxer->si);
+  gavl_packet_index_set_stream_stats(b->demuxer->si,
                                      s->stream_id, &s->stats);
   return 1;
   }
@@ -109,6 +109,37 @@ static void resync_png(bgav_stream_t * s)
   priv->have_header = 0;
   }
 
+/* Workers for frame parallel decoding */
+
+static void * worker_create(bgav_stream_t * s)
+  {
+  return bgav_png_reader_create();
+  }
+
+static int worker_decode(void * data, bgav_packet_t * p, gavl_video_frame_t * frame)
+  {
+  gavl_video_format_t format;
+  bgav_png_reader_t * png_reader = data;
+
+  memset(&format, 0, sizeof(format));
+  
+  if(!bgav_png_reader_read_header(png_reader,
+                                  p->buf.buf, p->buf.len,
+                                  &format) ||
+     !bgav_png_reader_read_image(png_reader, frame))
+    return 0;
+  
+  bgav_set_video_frame_from_packet(p, frame);
+  frame->src_rect.w = format.image_width;
+  frame->src_rect.h = format.image_height;
+  return 1;
+  }
+
+static void worker_destroy(void * data)
+  {
+  bgav_png_reader_destroy(data);
+  }
+
 static bgav_video_decoder_t decoder =
   {
     .name =   "PNG video decoder",
@@ -118,6 +149,9 @@ static bgav_video_decoder_t decoder =
     .resync = resync_png,
     .close =  close_png,
     .resync = NULL,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 void bgav_init_video_decoders_png()
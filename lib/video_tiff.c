@@ -43,7 +43,11 @@ typedef struct
   uint16_t SampleSperPixel;
   uint16_t Orientation;
   uint32_t * raster;
+  uint32_t raster_alloc; /* Pixels */
   bgav_packet_t * packet;
+
+  /* Stream format (for the workers) */
+  const gavl_video_format_t * format;
   } tiff_t;
 
 /* libtiff read callbacks */
@@ -178,18 +182,21 @@ read_header_tiff(bgav_stream_t * s,
   fp += 3;
 
 
-static int read_image_tiff(bgav_stream_t * s, gavl_video_frame_t * frame)
+static int convert_image(tiff_t * p, gavl_video_frame_t * frame)
   {
   uint32_t * raster_ptr;
   uint8_t * frame_ptr;
   uint8_t * frame_ptr_start;
   int i, j;
   
-  tiff_t *p = s->decoder_priv;
-
-  if(!p->raster)
+  if(p->raster_alloc < p->Height * p->Width)
+    {
+    if(p->raster)
+      _TIFFfree(p->raster);
+    p->raster_alloc = p->Height * p->Width;
     p->raster =
-      (uint32_t*)_TIFFmalloc(p->Height * p->Width * sizeof(uint32_t));
+      (uint32_t*)_TIFFmalloc(p->raster_alloc * sizeof(uint32_t));
+    }
   
   if(!TIFFReadRGBAImage(p->tiff, p->Width, p->Height, (uint32_t*)p->raster, 0))
     return 0;
@@ -230,7 +237,16 @@ static int read_image_tiff(bgav_stream_t * s, gavl_video_frame_t * frame)
       frame_ptr_start += frame->strides[0];
       }
     }
+  return 1;
+  }
+
+static int read_image_tiff(bgav_stream_t * s, gavl_video_frame_t * frame)
+  {
+  tiff_t *p = s->decoder_priv;
 
+  if(!convert_image(p, frame))
+    return 0;
+  
   bgav_set_video_frame_from_packet(p->packet, frame);
   
   TIFFClose( p->tiff );
@@ -253,10 +269,11 @@ static int init_tiff(bgav_stream_t * s)
 
   if(!read_header_tiff(s, s->data.video.format))
     return 0;
-    
+
+  /* Containers (quicktime) can tell the depth, otherwise the header decides */
   if(s->data.video.depth == 32)
     s->data.video.format->pixelformat = GAVL_RGBA_32;
-  else
+  else if(s->data.video.depth)
     s->data.video.format->pixelformat = GAVL_RGB_24;
 
   gavl_dictionary_set_string(s->m, GAVL_META_FORMAT, "TIFF");
@@ -311,6 +328,52 @@ static void resync_tiff(bgav_stream_t * s)
     }
   }
 
+/* Workers for frame parallel decoding */
+
+static void * worker_create(bgav_stream_t * s)
+  {
+  tiff_t * ret = calloc(1, sizeof(*ret));
+  ret->format = s->data.video.format;
+  return ret;
+  }
+
+static int worker_decode(void * data, bgav_packet_t * pkt, gavl_video_frame_t * frame)
+  {
+  int ret = 0;
+  tiff_t * p = data;
+
+  p->buffer = pkt->buf.buf;
+  p->buffer_size = pkt->buf.len;
+  p->buffer_position = 0;
+
+  if(!(p->tiff = open_tiff_mem("rm", p)))
+    return 0;
+
+  /* Frames are allocated for the stream format */
+  if(TIFFGetField(p->tiff, TIFFTAG_IMAGEWIDTH, &p->Width) &&
+     TIFFGetField(p->tiff, TIFFTAG_IMAGELENGTH, &p->Height) &&
+     TIFFGetField(p->tiff, TIFFTAG_SAMPLESPERPIXEL, &p->SampleSperPixel) &&
+     (p->Width == p->format->image_width) &&
+     (p->Height == p->format->image_height) &&
+     ((p->SampleSperPixel == 4) == (p->format->pixelformat == GAVL_RGBA_32)))
+    ret = convert_image(p, frame);
+
+  TIFFClose(p->tiff);
+  p->tiff = NULL;
+
+  if(ret)
+    bgav_set_video_frame_from_packet(pkt, frame);
+  return ret;
+  }
+
+static void worker_destroy(void * data)
+  {
+  tiff_t * p = data;
+  if(p->raster)
+    _TIFFfree(p->raster);
+  free(p);
+  }
+
 static bgav_video_decoder_t decoder =
   {
     .name =   "TIFF video decoder",
@@ -320,6 +383,9 @@ static bgav_video_decoder_t decoder =
     .decode = decode_tiff,
     .close =  close_tiff,
     .resync = resync_tiff,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 void bgav_init_video_decoders_tiff()
@@ -35,7 +35,8 @@ typedef struct
   {
   gavl_video_frame_t * frame;
   bgav_packet_t * p;
-  void (*decode_func)(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f);
+  void (*decode_func)(bgav_stream_t * s, gavl_video_frame_t * in,
+                      bgav_packet_t * p, gavl_video_frame_t * f);
   } yuv_priv_t;
 
 /* Common initialization */
@@ -52,18 +53,17 @@ static void init_common(bgav_stream_t * s)
 
 /* yuv2: It's yuyv with signedness swapped and JPEG scaled */
 
-static void decode_yuv2(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_yuv2(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   
   for(i = 0; i < s->data.video.format->image_height; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
     dst_y = f->planes[0]         + i * f->strides[0];
     dst_u = f->planes[1]         + i * f->strides[1];
     dst_v = f->planes[2]         + i * f->strides[2];
@@ -138,18 +138,17 @@ static const uint8_t decode_alpha_v408[256] =
 };
 
 
-static void decode_v408(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_v408(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src, *dst;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   
   for(i = 0; i < s->data.video.format->image_height; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
     dst = f->planes[0]         + i * f->strides[0];
     
     for(j = 0; j < s->data.video.format->image_width; j++)
@@ -188,11 +187,10 @@ static int init_v408(bgav_stream_t * s)
  *   packing order uyvy
  */
 
-static void decode_2vuy(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_2vuy(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   }
 
 static int init_2vuy(bgav_stream_t * s)
@@ -218,11 +216,10 @@ static int init_2vuy(bgav_stream_t * s)
  *  Wow, that was hard to reverse engineer ;-)
  */
 
-static void decode_VYUY(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_VYUY(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   }
 
 static int init_VYUY(bgav_stream_t * s)
@@ -245,14 +242,12 @@ static int init_VYUY(bgav_stream_t * s)
 
 /* The following 2 have just the chroma planed swapped */
 
-static void decode_yv12(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_yv12(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->buf.buf;
-  priv->frame->planes[1] = priv->frame->planes[0] + s->data.video.format->image_height * priv->frame->strides[0];
-  priv->frame->planes[2] = priv->frame->planes[1] + s->data.video.format->image_height/2 * priv->frame->strides[1];
+  in->planes[0] = p->buf.buf;
+  in->planes[1] = in->planes[0] + s->data.video.format->image_height * in->strides[0];
+  in->planes[2] = in->planes[1] + s->data.video.format->image_height/2 * in->strides[1];
   }
 
 static int init_yv12(bgav_stream_t * s)
@@ -277,15 +272,13 @@ static int init_yv12(bgav_stream_t * s)
   return 1;
   }
 
-static void decode_YV12(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_YV12(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->buf.buf;
-  priv->frame->planes[2] = priv->frame->planes[0] + s->data.video.format->image_height * priv->frame->strides[0];
-  priv->frame->planes[1] = priv->frame->planes[2] + s->data.video.format->image_height/2 * priv->frame->strides[1];
-  gavl_video_frame_copy(s->data.video.format, f, priv->frame);
+  in->planes[0] = p->buf.buf;
+  in->planes[2] = in->planes[0] + s->data.video.format->image_height * in->strides[0];
+  in->planes[1] = in->planes[2] + s->data.video.format->image_height/2 * in->strides[1];
+  gavl_video_frame_copy(s->data.video.format, f, in);
   }
 
 static int init_YV12(bgav_stream_t * s)
@@ -312,14 +305,12 @@ static int init_YV12(bgav_stream_t * s)
  *  YVU9 is yuv410 with swapped chroma planes
  */
 
-static void decode_YVU9(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_YVU9(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->buf.buf;
-  priv->frame->planes[2] = priv->frame->planes[0] + s->data.video.format->image_height * priv->frame->strides[0];
-  priv->frame->planes[1] = priv->frame->planes[2] + (s->data.video.format->image_height)/4 * priv->frame->strides[1];
+  in->planes[0] = p->buf.buf;
+  in->planes[2] = in->planes[0] + s->data.video.format->image_height * in->strides[0];
+  in->planes[1] = in->planes[2] + (s->data.video.format->image_height)/4 * in->strides[1];
   }
 
 static int init_YVU9(bgav_stream_t * s)
@@ -346,18 +337,17 @@ static int init_YVU9(bgav_stream_t * s)
 
 /* v308: Packed YUV 4:4:4, we make this planar */
 
-static void decode_v308(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_v308(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   
   for(i = 0; i < s->data.video.format->image_height; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
 
     dst_y = f->planes[0] + i * f->strides[0];
     dst_u = f->planes[1] + i * f->strides[1];
@@ -400,20 +390,19 @@ static int init_v308(bgav_stream_t * s)
  *  we make this planar
  */
 
-static void decode_v410(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_v410(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src;
   uint16_t *dst_y, *dst_u, *dst_v;
   uint32_t src_i;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   
   for(i = 0; i < s->data.video.format->image_height; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
 
     dst_y = (uint16_t*)(f->planes[0] + i * f->strides[0]);
     dst_u = (uint16_t*)(f->planes[1] + i * f->strides[1]);
@@ -454,20 +443,19 @@ static int init_v410(bgav_stream_t * s)
  *  we make this planar
  */
 
-static void decode_v210(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_v210(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src;
   uint16_t *dst_y, *dst_u, *dst_v;
   uint32_t i1, i2, i3, i4;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
   
   for(i = 0; i < s->data.video.format->image_height; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
 
     dst_y = (uint16_t*)(f->planes[0] + i * f->strides[0]);
     dst_u = (uint16_t*)(f->planes[1] + i * f->strides[1]);
@@ -546,20 +534,19 @@ static int init_v210(bgav_stream_t * s)
  *  qt4l/lqt universe :-)
  */
 
-static void decode_yuv4(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void decode_yuv4(bgav_stream_t * s, gavl_video_frame_t * in,
+                        bgav_packet_t * p, gavl_video_frame_t * f)
   {
   int i, j;
   uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
 
-  priv->frame->planes[0] = p->buf.buf;
+  in->planes[0] = p->buf.buf;
 
   /* Packing order for one macropixel is U0V0Y0Y1Y2Y3 */
 
   for(i = 0; i < s->data.video.format->image_height/2; i++)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
+    src = in->planes[0] + i * in->strides[0];
     dst_y = f->planes[0] + 2 * i * f->strides[0];
     dst_u = f->planes[1] + i * f->strides[1];
     dst_v = f->planes[2] + i * f->strides[2];
@@ -623,7 +610,7 @@ static gavl_source_status_t decode(bgav_stream_t * s, gavl_video_frame_t * f)
   if(!priv->p->buf.len)
     return GAVL_SOURCE_OK; /* Libquicktime/qt4l bug */
   
-  priv->decode_func(s, priv->p, f);
+  priv->decode_func(s, priv->frame, priv->p, f);
   bgav_set_video_frame_from_packet(priv->p, priv->frame);
 
   if(f)
@@ -657,6 +644,45 @@ static void close(bgav_stream_t * s)
   free(priv);
   }
 
+/* Workers for frame parallel decoding */
+
+typedef struct
+  {
+  bgav_stream_t * s;
+  gavl_video_frame_t * frame;
+  } yuv_worker_t;
+
+static void * worker_create(bgav_stream_t * s)
+  {
+  yuv_worker_t * ret;
+  yuv_priv_t * priv = s->decoder_priv;
+  
+  ret = calloc(1, sizeof(*ret));
+  ret->s = s;
+  ret->frame = gavl_video_frame_create(NULL);
+  memcpy(ret->frame->strides, priv->frame->strides, sizeof(ret->frame->strides));
+  return ret;
+  }
+
+static int worker_decode(void * data, bgav_packet_t * p, gavl_video_frame_t * f)
+  {
+  yuv_worker_t * w = data;
+  yuv_priv_t * priv = w->s->decoder_priv;
+  
+  if(p->buf.len) /* Libquicktime/qt4l bug */
+    priv->decode_func(w->s, w->frame, p, f);
+  bgav_set_video_frame_from_packet(p, f);
+  return 1;
+  }
+
+static void worker_destroy(void * data)
+  {
+  yuv_worker_t * w = data;
+  gavl_video_frame_null(w->frame);
+  gavl_video_frame_destroy(w->frame);
+  free(w);
+  }
+
 /* Decoders */
 
 static bgav_video_decoder_t yuv2_decoder =
@@ -667,6 +693,9 @@ static bgav_video_decoder_t yuv2_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 #if 1
@@ -699,6 +728,9 @@ static bgav_video_decoder_t YV12_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 static bgav_video_decoder_t VYUY_decoder =
@@ -731,6 +763,9 @@ static bgav_video_decoder_t v308_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 static bgav_video_decoder_t v408_decoder =
@@ -741,6 +776,9 @@ static bgav_video_decoder_t v408_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 static bgav_video_decoder_t v410_decoder =
@@ -751,6 +789,9 @@ static bgav_video_decoder_t v410_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 static bgav_video_decoder_t v210_decoder =
@@ -761,6 +802,9 @@ static bgav_video_decoder_t v210_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 
@@ -772,6 +816,9 @@ static bgav_video_decoder_t yuv4_decoder =
     .decode = decode,
     .resync = resync,
     .close =  close,
+    .worker_create =  worker_create,
+    .worker_decode =  worker_decode,
+    .worker_destroy = worker_destroy,
   };
 
 void bgav_init_video_decoders_yuv()
@@ -0,0 +1,369 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Frame parallel decoding for intra-only codecs.
+ *
+ *  Packets are read ahead into a ring of jobs, worker threads decode
+ *  them with private decoder instances into preallocated frames.
+ *  Frames are delivered in the order the packets were read, which is
+ *  the presentation order for intra-only streams.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "videothreads"
+
+/* Jobs per thread */
+#define JOBS_PER_THREAD 2
+
+#define JOB_EMPTY  0
+#define JOB_QUEUED 1
+#define JOB_BUSY   2
+#define JOB_DONE   3
+
+typedef struct
+  {
+  gavl_packet_t p;
+  gavl_video_frame_t * frame;
+  int state;
+  int result;
+  } job_t;
+
+typedef struct
+  {
+  bgav_video_threads_t * t;
+  void * worker;
+  pthread_t thread;
+  } thread_t;
+
+struct bgav_video_threads_s
+  {
+  bgav_stream_t * s;
+
+  int num_threads;
+  thread_t * threads;
+
+  int num_jobs;
+  job_t * jobs;
+
+  int read_idx;   /* Next job to deliver */
+  int write_idx;  /* Next job to fill    */
+  int num_queued; /* Jobs filled but not delivered yet */
+  int last_idx;   /* Job delivered last (-1 if none) */
+
+  int eof;
+  int quit;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  };
+
+static job_t * next_job(bgav_video_threads_t * t)
+  {
+  int i, idx;
+  for(i = 0; i < t->num_queued; i++)
+    {
+    idx = (t->read_idx + i) % t->num_jobs;
+    if(t->jobs[idx].state == JOB_QUEUED)
+      return &t->jobs[idx];
+    }
+  return NULL;
+  }
+
+static void * thread_func(void * data)
+  {
+  job_t * job;
+  thread_t * th = data;
+  bgav_video_threads_t * t = th->t;
+
+  pthread_mutex_lock(&t->mutex);
+
+  while(1)
+    {
+    while(!t->quit && !(job = next_job(t)))
+      pthread_cond_wait(&t->work_cond, &t->mutex);
+
+    if(t->quit)
+      break;
+
+    job->state = JOB_BUSY;
+    pthread_mutex_unlock(&t->mutex);
+
+    BGAV_TRACE_BEGIN("decode_video");
+    job->result = t->s->data.video.decoder->worker_decode(th->worker,
+                                                          &job->p, job->frame);
+    BGAV_TRACE_END("decode_video");
+
+    pthread_mutex_lock(&t->mutex);
+    job->state = JOB_DONE;
+    pthread_cond_broadcast(&t->done_cond);
+    }
+
+  pthread_mutex_unlock(&t->mutex);
+  return NULL;
+  }
+
+/* Wait until no job is decoded anymore. Must be called with mutex locked */
+static void wait_idle(bgav_video_threads_t * t)
+  {
+  int i;
+
+  i = 0;
+  while(i < t->num_jobs)
+    {
+    if(t->jobs[i].state == JOB_BUSY)
+      {
+      pthread_cond_wait(&t->done_cond, &t->mutex);
+      i = 0;
+      }
+    else
+      i++;
+    }
+  }
+
+bgav_video_threads_t * bgav_video_threads_create(bgav_stream_t * s, int num_threads)
+  {
+  int i;
+  bgav_video_threads_t * ret;
+  const bgav_video_decoder_t * dec = s->data.video.decoder;
+
+  ret = calloc(1, sizeof(*ret));
+  ret->s = s;
+  ret->num_threads = num_threads;
+  ret->last_idx = -1;
+
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->work_cond, NULL);
+  pthread_cond_init(&ret->done_cond, NULL);
+
+  ret->num_jobs = num_threads * JOBS_PER_THREAD;
+  ret->jobs = calloc(ret->num_jobs, sizeof(*ret->jobs));
+
+  for(i = 0; i < ret->num_jobs; i++)
+    {
+    gavl_packet_init(&ret->jobs[i].p);
+    ret->jobs[i].frame = gavl_video_frame_create(s->data.video.format);
+    }
+
+  ret->threads = calloc(num_threads, sizeof(*ret->threads));
+
+  for(i = 0; i < num_threads; i++)
+    {
+    ret->threads[i].t = ret;
+    if(!(ret->threads[i].worker = dec->worker_create(s)))
+      {
+      gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Creating decoder instance failed");
+      ret->num_threads = i;
+      bgav_video_threads_destroy(ret);
+      return NULL;
+      }
+    }
+
+  for(i = 0; i < num_threads; i++)
+    pthread_create(&ret->threads[i].thread, NULL, thread_func, &ret->threads[i]);
+
+  gavl_log(GAVL_LOG_INFO, LOG_DOMAIN, "Decoding %s with %d threads",
+           dec->name, num_threads);
+
+  return ret;
+  }
+
+void bgav_video_threads_destroy(bgav_video_threads_t * t)
+  {
+  int i;
+
+  pthread_mutex_lock(&t->mutex);
+  t->quit = 1;
+  pthread_cond_broadcast(&t->work_cond);
+  pthread_mutex_unlock(&t->mutex);
+
+  for(i = 0; i < t->num_threads; i++)
+    pthread_join(t->threads[i].thread, NULL);
+
+  for(i = 0; i < t->num_threads; i++)
+    t->s->data.video.decoder->worker_destroy(t->threads[i].worker);
+
+  for(i = 0; i < t->num_jobs; i++)
+    {
+    gavl_packet_free(&t->jobs[i].p);
+    gavl_video_frame_destroy(t->jobs[i].frame);
+    }
+
+  pthread_mutex_destroy(&t->mutex);
+  pthread_cond_destroy(&t->work_cond);
+  pthread_cond_destroy(&t->done_cond);
+
+  free(t->threads);
+  free(t->jobs);
+  free(t);
+  }
+
+/* Release the frame delivered last. Must be called with mutex locked */
+static void release_last(bgav_video_threads_t * t)
+  {
+  if(t->last_idx >= 0)
+    {
+    t->jobs[t->last_idx].state = JOB_EMPTY;
+    t->last_idx = -1;
+    }
+  }
+
+/* Drop the oldest job. Must be called with mutex locked */
+static void drop_first(bgav_video_threads_t * t)
+  {
+  while(t->jobs[t->read_idx].state == JOB_BUSY)
+    pthread_cond_wait(&t->done_cond, &t->mutex);
+
+  t->jobs[t->read_idx].state = JOB_EMPTY;
+  t->read_idx = (t->read_idx + 1) % t->num_jobs;
+  t->num_queued--;
+  }
+
+static void fill(bgav_video_threads_t * t)
+  {
+  bgav_packet_t * p;
+  gavl_source_status_t st;
+  job_t * job;
+
+  while(!t->eof && (t->num_queued < t->num_jobs))
+    {
+    p = NULL;
+
+    if((st = bgav_stream_get_packet_read(t->s, &p)) != GAVL_SOURCE_OK)
+      {
+      if(st == GAVL_SOURCE_EOF)
+        t->eof = 1;
+      break;
+      }
+
+    job = &t->jobs[t->write_idx];
+
+    gavl_packet_copy(&job->p, p);
+    bgav_stream_done_packet_read(t->s, p);
+
+    pthread_mutex_lock(&t->mutex);
+    job->state = JOB_QUEUED;
+    t->write_idx = (t->write_idx + 1) % t->num_jobs;
+    t->num_queued++;
+    pthread_cond_signal(&t->work_cond);
+    pthread_mutex_unlock(&t->mutex);
+    }
+  }
+
+gavl_source_status_t
+bgav_video_threads_read(bgav_video_threads_t * t, gavl_video_frame_t ** frame)
+  {
+  job_t * job;
+
+  pthread_mutex_lock(&t->mutex);
+  release_last(t);
+  pthread_mutex_unlock(&t->mutex);
+
+  fill(t);
+
+  pthread_mutex_lock(&t->mutex);
+
+  if(!t->num_queued)
+    {
+    pthread_mutex_unlock(&t->mutex);
+    return t->eof ? GAVL_SOURCE_EOF : GAVL_SOURCE_AGAIN;
+    }
+
+  job = &t->jobs[t->read_idx];
+
+  while(job->state != JOB_DONE)
+    pthread_cond_wait(&t->done_cond, &t->mutex);
+
+  if(!job->result)
+    {
+    gavl_log(GAVL_LOG_ERROR, LOG_DOMAIN, "Decoding frame failed");
+    drop_first(t);
+    pthread_mutex_unlock(&t->mutex);
+    return GAVL_SOURCE_EOF;
+    }
+
+  t->last_idx = t->read_idx;
+  t->read_idx = (t->read_idx + 1) % t->num_jobs;
+  t->num_queued--;
+
+  pthread_mutex_unlock(&t->mutex);
+
+  if(frame)
+    *frame = job->frame;
+
+  return GAVL_SOURCE_OK;
+  }
+
+void bgav_video_threads_reset(bgav_video_threads_t * t)
+  {
+  int i;
+
+  pthread_mutex_lock(&t->mutex);
+
+  /* Queued jobs are not picked up anymore after this */
+  for(i = 0; i < t->num_jobs; i++)
+    {
+    if(t->jobs[i].state == JOB_QUEUED)
+      t->jobs[i].state = JOB_EMPTY;
+    }
+
+  wait_idle(t);
+
+  for(i = 0; i < t->num_jobs; i++)
+    t->jobs[i].state = JOB_EMPTY;
+
+  t->read_idx = 0;
+  t->write_idx = 0;
+  t->num_queued = 0;
+  t->last_idx = -1;
+  t->eof = 0;
+
+  pthread_mutex_unlock(&t->mutex);
+  }
+
+int bgav_video_threads_skipto(bgav_video_threads_t * t, int64_t time, int64_t * out_time)
+  {
+  job_t * job;
+  int ret = 0;
+
+  pthread_mutex_lock(&t->mutex);
+
+  while(t->num_queued)
+    {
+    job = &t->jobs[t->read_idx];
+
+    if(job->p.pts + job->p.duration > time)
+      {
+      *out_time = job->p.pts;
+      ret = 1;
+      break;
+      }
+    drop_first(t);
+    }
+
+  pthread_mutex_unlock(&t->mutex);
+  return ret;
+  }
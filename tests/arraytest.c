@@ -0,0 +1,525 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Check the bulk array readers and the index table parsers, which use
+ *  them, against readers doing one call per value (the way the tables
+ *  were read before). Returns 0 on success.
+ */
+
+#include <avdec_private.h>
+#include <qt.h>
+#include <avi.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define NUM_VALUES 67 /* Not a multiple of any vector size */
+
+/* Maximum entries in the generated index tables */
+#define MAX_TABLE_ENTRIES 5000
+
+static uint8_t data[NUM_VALUES * 8];
+
+static int check_32(int num,
+                    int (*read_single)(bgav_input_context_t*, uint32_t*),
+                    int (*read_array)(bgav_input_context_t*, uint32_t*, int),
+                    const char * name)
+  {
+  int i;
+  bgav_input_context_t * in1;
+  bgav_input_context_t * in2;
+  uint32_t single[NUM_VALUES];
+  uint32_t array[NUM_VALUES];
+  int ret = 1;
+
+  in1 = bgav_input_open_memory(data, num * 4);
+  in2 = bgav_input_open_memory(data, num * 4);
+
+  for(i = 0; i < num; i++)
+    {
+    if(!read_single(in1, &single[i]))
+      ret = 0;
+    }
+
+  if(!read_array(in2, array, num) ||
+     memcmp(single, array, num * sizeof(*array)) ||
+     (in1->position != in2->position))
+    ret = 0;
+
+  /* Reading past the end must fail */
+  if(read_array(in2, array, 1))
+    ret = 0;
+
+  if(!ret)
+    fprintf(stderr, "%s failed for %d values\n", name, num);
+
+  bgav_input_close(in1);
+  bgav_input_destroy(in1);
+  bgav_input_close(in2);
+  bgav_input_destroy(in2);
+  return ret;
+  }
+
+static int check_64(int num,
+                    int (*read_single)(bgav_input_context_t*, uint64_t*),
+                    int (*read_array)(bgav_input_context_t*, uint64_t*, int),
+                    const char * name)
+  {
+  int i;
+  bgav_input_context_t * in1;
+  bgav_input_context_t * in2;
+  uint64_t single[NUM_VALUES];
+  uint64_t array[NUM_VALUES];
+  int ret = 1;
+
+  in1 = bgav_input_open_memory(data, num * 8);
+  in2 = bgav_input_open_memory(data, num * 8);
+
+  for(i = 0; i < num; i++)
+    {
+    if(!read_single(in1, &single[i]))
+      ret = 0;
+    }
+
+  if(!read_array(in2, array, num) ||
+     memcmp(single, array, num * sizeof(*array)) ||
+     (in1->position != in2->position))
+    ret = 0;
+
+  if(read_array(in2, array, 1))
+    ret = 0;
+
+  if(!ret)
+    fprintf(stderr, "%s failed for %d values\n", name, num);
+
+  bgav_input_close(in1);
+  bgav_input_destroy(in1);
+  bgav_input_close(in2);
+  bgav_input_destroy(in2);
+  return ret;
+  }
+
+/*
+ *  Index tables: Reference readers with one call per value
+ */
+
+static int ref_version_and_flags(bgav_input_context_t * input,
+                                 int * version, uint32_t * flags)
+  {
+  uint8_t v;
+  if(!bgav_input_read_8(input, &v) ||
+     !bgav_input_read_24_be(input, flags))
+    return 0;
+  *version = v;
+  return 1;
+  }
+
+static int ref_stsc_read(bgav_input_context_t * input, qt_stsc_t * ret)
+  {
+  uint32_t i;
+  if(!ref_version_and_flags(input, &ret->version, &ret->flags) ||
+     !bgav_input_read_32_be(input, &ret->num_entries))
+    return 0;
+  
+  ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
+  for(i = 0; i < ret->num_entries; i++)
+    {
+    if(!bgav_input_read_32_be(input, &ret->entries[i].first_chunk) ||
+       !bgav_input_read_32_be(input, &ret->entries[i].samples_per_chunk) ||
+       !bgav_input_read_32_be(input, &ret->entries[i].sample_description_id))
+      return 0;
+    }
+  return 1;
+  }
+
+static int ref_stts_read(bgav_input_context_t * input, qt_stts_t * ret)
+  {
+  uint32_t i;
+  if(!ref_version_and_flags(input, &ret->version, &ret->flags) ||
+     !bgav_input_read_32_be(input, &ret->num_entries))
+    return 0;
+
+  ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
+  for(i = 0; i < ret->num_entries; i++)
+    {
+    if(!bgav_input_read_32_be(input, &ret->entries[i].count) ||
+       !bgav_input_read_32_be(input, &ret->entries[i].duration))
+      return 0;
+    }
+  return 1;
+  }
+
+static int ref_stss_read(bgav_input_context_t * input, qt_stss_t * ret)
+  {
+  uint32_t i;
+  if(!ref_version_and_flags(input, &ret->version, &ret->flags) ||
+     !bgav_input_read_32_be(input, &ret->num_entries))
+    return 0;
+
+  ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
+  for(i = 0; i < ret->num_entries; i++)
+    {
+    if(!bgav_input_read_32_be(input, &ret->entries[i]))
+      return 0;
+    }
+  return 1;
+  }
+
+static int ref_stsz_read(bgav_input_context_t * input, qt_stsz_t * ret)
+  {
+  uint32_t i;
+  if(!ref_version_and_flags(input, &ret->version, &ret->flags) ||
+     !bgav_input_read_32_be(input, &ret->sample_size) ||
+     !bgav_input_read_32_be(input, &ret->num_entries))
+    return 0;
+
+  if(!ret->sample_size)
+    {
+    ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
+    for(i = 0; i < ret->num_entries; i++)
+      {
+      if(!bgav_input_read_32_be(input, &ret->entries[i]))
+        return 0;
+      }
+    }
+  return 1;
+  }
+
+static int ref_stco_read(bgav_input_context_t * input, qt_stco_t * ret, int co64)
+  {
+  uint32_t i;
+  uint32_t tmp;
+  
+  if(!ref_version_and_flags(input, &ret->version, &ret->flags) ||
+     !bgav_input_read_32_be(input, &ret->num_entries))
+    return 0;
+
+  ret->entries = calloc(ret->num_entries, sizeof(*(ret->entries)));
+  for(i = 0; i < ret->num_entries; i++)
+    {
+    if(co64)
+      {
+      if(!bgav_input_read_64_be(input, &ret->entries[i]))
+        return 0;
+      }
+    else
+      {
+      if(!bgav_input_read_32_be(input, &tmp))
+        return 0;
+      ret->entries[i] = tmp;
+      }
+    }
+  return 1;
+  }
+
+static int ref_idx1_read(bgav_input_context_t * input, avi_idx1_t * ret)
+  {
+  uint32_t i;
+  uint32_t fourcc;
+  uint32_t size;
+  
+  if(!bgav_input_read_fourcc(input, &fourcc) ||
+     !bgav_input_read_32_le(input, &size))
+    return 0;
+  ret->num_entries = size / 16;
+  
+  ret->entries = calloc(ret->num_entries, sizeof(*ret->entries));
+  for(i = 0; i < ret->num_entries; i++)
+    {
+    if(!bgav_input_read_fourcc(input, &ret->entries[i].ckid) ||
+       !bgav_input_read_32_le(input, &ret->entries[i].dwFlags) ||
+       !bgav_input_read_32_le(input, &ret->entries[i].dwChunkOffset) ||
+       !bgav_input_read_32_le(input, &ret->entries[i].dwChunkLength))
+      return 0;
+    }
+  return 1;
+  }
+
+/* Generated tables */
+
+typedef enum
+  {
+  TABLE_STSC,
+  TABLE_STTS,
+  TABLE_STSS,
+  TABLE_STSZ,
+  TABLE_STCO,
+  TABLE_CO64,
+  TABLE_IDX1,
+  NUM_TABLES,
+  } table_type_t;
+
+static const struct
+  {
+  const char * name;
+  int entry_size;
+  }
+tables[NUM_TABLES] =
+  {
+    { "stsc", 12 },
+    { "stts",  8 },
+    { "stss",  4 },
+    { "stsz",  4 },
+    { "stco",  4 },
+    { "co64",  8 },
+    { "idx1", 16 },
+  };
+
+static void put_32_be(uint8_t * ptr, uint32_t v)
+  {
+  ptr[0] = v >> 24;
+  ptr[1] = (v >> 16) & 0xff;
+  ptr[2] = (v >> 8) & 0xff;
+  ptr[3] = v & 0xff;
+  }
+
+static void put_32_le(uint8_t * ptr, uint32_t v)
+  {
+  ptr[0] = v & 0xff;
+  ptr[1] = (v >> 8) & 0xff;
+  ptr[2] = (v >> 16) & 0xff;
+  ptr[3] = v >> 24;
+  }
+
+/* Random table with num entries, returns the number of bytes */
+
+static int make_table(uint8_t * buf, table_type_t type, int num)
+  {
+  int i;
+  int len;
+  int header_len;
+
+  if(type == TABLE_IDX1)
+    {
+    memcpy(buf, "idx1", 4);
+    put_32_le(buf + 4, num * 16);
+    header_len = 8;
+    }
+  else
+    {
+    /* Version, flags, (sample size), number of entries */
+    put_32_be(buf, rand());
+    if(type == TABLE_STSZ)
+      {
+      put_32_be(buf + 4, 0);
+      header_len = 12;
+      }
+    else
+      header_len = 8;
+    put_32_be(buf + header_len - 4, num);
+    }
+
+  len = header_len + num * tables[type].entry_size;
+  
+  for(i = header_len; i < len; i++)
+    buf[i] = rand() & 0xff;
+  
+  return len;
+  }
+
+#define CMP_TABLE(t1, t2, entry_size) \
+  (((t1).num_entries == (t2).num_entries) &&                            \
+   ((t1).version == (t2).version) && ((t1).flags == (t2).flags) &&       \
+   !memcmp((t1).entries, (t2).entries, (t1).num_entries * (entry_size)))
+
+#define FREE_TABLE(t) if((t).entries) free((t).entries)
+
+static int check_table(table_type_t type, int num, int truncate)
+  {
+  uint8_t * buf;
+  int len;
+  int ret1 = 0, ret2 = 0;
+  int ok;
+  qt_atom_header_t h;
+  bgav_input_context_t * in1;
+  bgav_input_context_t * in2;
+
+  union
+    {
+    qt_stsc_t stsc;
+    qt_stts_t stts;
+    qt_stss_t stss;
+    qt_stsz_t stsz;
+    qt_stco_t stco;
+    avi_idx1_t idx1;
+    } t1, t2;
+  
+  memset(&h, 0, sizeof(h));
+  memset(&t1, 0, sizeof(t1));
+  memset(&t2, 0, sizeof(t2));
+  
+  buf = malloc(16 + num * tables[type].entry_size);
+  len = make_table(buf, type, num);
+
+  /* Truncated tables must fail with both readers */
+  if(truncate)
+    len -= truncate;
+  
+  in1 = bgav_input_open_memory(buf, len);
+  in2 = bgav_input_open_memory(buf, len);
+  
+  switch(type)
+    {
+    case TABLE_STSC:
+      ret1 = ref_stsc_read(in1, &t1.stsc);
+      ret2 = bgav_qt_stsc_read(&h, in2, &t2.stsc);
+      break;
+    case TABLE_STTS:
+      ret1 = ref_stts_read(in1, &t1.stts);
+      ret2 = bgav_qt_stts_read(&h, in2, &t2.stts);
+      break;
+    case TABLE_STSS:
+      ret1 = ref_stss_read(in1, &t1.stss);
+      ret2 = bgav_qt_stss_read(&h, in2, &t2.stss);
+      break;
+    case TABLE_STSZ:
+      ret1 = ref_stsz_read(in1, &t1.stsz);
+      ret2 = bgav_qt_stsz_read(&h, in2, &t2.stsz);
+      break;
+    case TABLE_STCO:
+      ret1 = ref_stco_read(in1, &t1.stco, 0);
+      ret2 = bgav_qt_stco_read(&h, in2, &t2.stco);
+      break;
+    case TABLE_CO64:
+      ret1 = ref_stco_read(in1, &t1.stco, 1);
+      ret2 = bgav_qt_stco_read_64(&h, in2, &t2.stco);
+      break;
+    case TABLE_IDX1:
+      ret1 = ref_idx1_read(in1, &t1.idx1);
+      ret2 = bgav_avi_idx1_read(in2, &t2.idx1);
+      break;
+    case NUM_TABLES:
+      break;
+    }
+
+  ok = (ret1 == ret2);
+  
+  if(ok && ret1)
+    {
+    if(in1->position != in2->position)
+      ok = 0;
+    
+    switch(type)
+      {
+      case TABLE_STSC:
+        ok = ok && CMP_TABLE(t1.stsc, t2.stsc, sizeof(*t1.stsc.entries));
+        break;
+      case TABLE_STTS:
+        ok = ok && CMP_TABLE(t1.stts, t2.stts, sizeof(*t1.stts.entries));
+        break;
+      case TABLE_STSS:
+        ok = ok && CMP_TABLE(t1.stss, t2.stss, sizeof(*t1.stss.entries));
+        break;
+      case TABLE_STSZ:
+        ok = ok && (t1.stsz.sample_size == t2.stsz.sample_size) &&
+          CMP_TABLE(t1.stsz, t2.stsz, sizeof(*t1.stsz.entries));
+        break;
+      case TABLE_STCO:
+      case TABLE_CO64:
+        ok = ok && CMP_TABLE(t1.stco, t2.stco, sizeof(*t1.stco.entries));
+        break;
+      case TABLE_IDX1:
+        ok = ok && (t1.idx1.num_entries == t2.idx1.num_entries) &&
+          !memcmp(t1.idx1.entries, t2.idx1.entries,
+                  t1.idx1.num_entries * sizeof(*t1.idx1.entries));
+        break;
+      case NUM_TABLES:
+        break;
+      }
+    }
+
+  if(!ok)
+    fprintf(stderr, "%s differs for %d entries%s\n", tables[type].name, num,
+            truncate ? " (truncated)" : "");
+  
+  switch(type)
+    {
+    case TABLE_STSC: FREE_TABLE(t1.stsc); FREE_TABLE(t2.stsc); break;
+    case TABLE_STTS: FREE_TABLE(t1.stts); FREE_TABLE(t2.stts); break;
+    case TABLE_STSS: FREE_TABLE(t1.stss); FREE_TABLE(t2.stss); break;
+    case TABLE_STSZ: FREE_TABLE(t1.stsz); FREE_TABLE(t2.stsz); break;
+    case TABLE_STCO:
+    case TABLE_CO64: FREE_TABLE(t1.stco); FREE_TABLE(t2.stco); break;
+    case TABLE_IDX1: FREE_TABLE(t1.idx1); FREE_TABLE(t2.idx1); break;
+    case NUM_TABLES: break;
+    }
+  
+  bgav_input_close(in1);
+  bgav_input_destroy(in1);
+  bgav_input_close(in2);
+  bgav_input_destroy(in2);
+  free(buf);
+  return ok;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, j;
+  int ret = 0;
+  uint32_t dummy;
+  bgav_input_context_t * in;
+
+  srand(0);
+  for(i = 0; i < sizeof(data); i++)
+    data[i] = rand() & 0xff;
+
+  for(i = 0; i <= NUM_VALUES; i++)
+    {
+    if(!check_32(i, bgav_input_read_32_be, bgav_input_read_array_32_be, "32 bit BE") ||
+       !check_32(i, bgav_input_read_32_le, bgav_input_read_array_32_le, "32 bit LE") ||
+       !check_64(i, bgav_input_read_64_be, bgav_input_read_array_64_be, "64 bit BE") ||
+       !check_64(i, bgav_input_read_64_le, bgav_input_read_array_64_le, "64 bit LE"))
+      ret = 1;
+    }
+
+  /* Invalid counts must be rejected without reading */
+  in = bgav_input_open_memory(data, sizeof(data));
+  if(bgav_input_read_array_32_be(in, &dummy, -1) ||
+     bgav_input_read_array_32_be(in, &dummy, INT_MAX / 2) ||
+     (in->position != 0))
+    {
+    fprintf(stderr, "Invalid count accepted\n");
+    ret = 1;
+    }
+  bgav_input_close(in);
+  bgav_input_destroy(in);
+
+  /* Index tables */
+  for(i = 0; i < NUM_TABLES; i++)
+    {
+    for(j = 0; j < 100; j++)
+      {
+      /* Empty, small and large tables */
+      int num = (j < 2) ? j : rand() % MAX_TABLE_ENTRIES;
+      
+      if(!check_table(i, num, 0))
+        ret = 1;
+      if(num && !check_table(i, num, 1 + rand() % tables[i].entry_size))
+        ret = 1;
+      }
+    }
+  
+  if(!ret)
+    fprintf(stderr, "All array reads OK\n");
+  return ret;
+  }
@@ -0,0 +1,355 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Write a WMV file with raw RGB video, fixed size packets and a
+ *  Simple Index Object. Decode it linearly, then seek to random frames
+ *  through the index and check that the same frames come out.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define FILENAME "asftest.wmv"
+
+#define WIDTH        16
+#define HEIGHT       16
+#define FRAME_SIZE   (WIDTH * HEIGHT * 3)
+#define PACKET_SIZE  1024
+#define NUM_FRAMES   250
+#define FRAME_MS     40
+#define PREROLL_MS   2000
+#define INTERVAL_MS  1000
+#define NUM_SEEKS    200
+
+/* Packet and payload headers written by write_packet() */
+#define PACKET_HEADER_SIZE  13
+#define PAYLOAD_HEADER_SIZE 15
+
+#define FRAME_PTS(k) (PREROLL_MS + (k) * FRAME_MS)
+
+static const uint8_t guid_header[16] =
+  { 0x30, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11,
+    0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c };
+
+static const uint8_t guid_file_properties[16] =
+  { 0xa1, 0xdc, 0xab, 0x8c, 0x47, 0xa9, 0xcf, 0x11,
+    0x8e, 0xe4, 0x00, 0xc0, 0x0c, 0x20, 0x53, 0x65 };
+
+static const uint8_t guid_stream_header[16] =
+  { 0x91, 0x07, 0xdc, 0xb7, 0xb7, 0xa9, 0xcf, 0x11,
+    0x8e, 0xe6, 0x00, 0xc0, 0x0c, 0x20, 0x53, 0x65 };
+
+static const uint8_t guid_video_media[16] =
+  { 0xc0, 0xef, 0x19, 0xbc, 0x4d, 0x5b, 0xcf, 0x11,
+    0xa8, 0xfd, 0x00, 0x80, 0x5f, 0x5c, 0x44, 0x2b };
+
+static const uint8_t guid_data[16] =
+  { 0x36, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11,
+    0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c };
+
+static const uint8_t guid_simple_index[16] =
+  { 0x90, 0x08, 0x00, 0x33, 0xb1, 0xe5, 0xcf, 0x11,
+    0x89, 0xf4, 0x00, 0xa0, 0xc9, 0x03, 0x49, 0xcb };
+
+static const uint8_t guid_zero[16] = { 0 };
+
+static void put_16(FILE * f, uint16_t v)
+  {
+  fputc(v & 0xff, f);
+  fputc(v >> 8, f);
+  }
+
+static void put_32(FILE * f, uint32_t v)
+  {
+  put_16(f, v & 0xffff);
+  put_16(f, v >> 16);
+  }
+
+static void put_64(FILE * f, uint64_t v)
+  {
+  put_32(f, v & 0xffffffff);
+  put_32(f, v >> 32);
+  }
+
+static void put_guid(FILE * f, const uint8_t * guid)
+  {
+  fwrite(guid, 1, 16, f);
+  }
+
+static void write_packet(FILE * f, int k)
+  {
+  int i;
+  int padding = PACKET_SIZE - PACKET_HEADER_SIZE -
+    PAYLOAD_HEADER_SIZE - FRAME_SIZE;
+  
+  /* Packet header */
+  fputc(0x82, f);          /* 2 bytes error correction data */
+  put_16(f, 0);
+  fputc(0x10, f);          /* Single payload, 16 bit padding length */
+  fputc(0x1d, f);          /* 8 bit object number, 32 bit offset,
+                              8 bit replicated data length */
+  put_16(f, padding);
+  put_32(f, FRAME_PTS(k)); /* Send time */
+  put_16(f, FRAME_MS);     /* Duration */
+
+  /* Payload header */
+  fputc(0x81, f);          /* Stream 1, keyframe */
+  fputc(k & 0xff, f);      /* Object number */
+  put_32(f, 0);            /* Offset into object */
+  fputc(8, f);             /* Replicated data length */
+  put_32(f, FRAME_SIZE);   /* Object size */
+  put_32(f, FRAME_PTS(k)); /* Presentation time */
+  
+  for(i = 0; i < FRAME_SIZE; i++)
+    fputc((k * 7 + i) & 0xff, f);
+
+  for(i = 0; i < padding; i++)
+    fputc(0, f);
+  }
+
+/* Packet to start from for presenting the time of index entry i */
+
+static uint32_t index_packet(int i)
+  {
+  int k;
+  
+  if(i * INTERVAL_MS < PREROLL_MS)
+    return 0;
+
+  k = (i * INTERVAL_MS - PREROLL_MS) / FRAME_MS;
+  if(k >= NUM_FRAMES)
+    k = NUM_FRAMES - 1;
+  return k;
+  }
+
+static int write_file(void)
+  {
+  int i;
+  int num_entries;
+  uint64_t duration = (uint64_t)(PREROLL_MS + NUM_FRAMES * FRAME_MS) * 10000;
+  FILE * f = fopen(FILENAME, "wb");
+
+  if(!f)
+    return 0;
+
+  /* Header object */
+  put_guid(f, guid_header);
+  put_64(f, 30 + 104 + 129);
+  put_32(f, 2);
+  put_16(f, 0x0201);
+
+  /* File properties object */
+  put_guid(f, guid_file_properties);
+  put_64(f, 104);
+  put_guid(f, guid_zero);   /* File ID */
+  put_64(f, 0);             /* File size */
+  put_64(f, 0);             /* Creation date */
+  put_64(f, NUM_FRAMES);    /* Data packets count */
+  put_64(f, duration);      /* Play duration */
+  put_64(f, duration);      /* Send duration */
+  put_64(f, PREROLL_MS);    /* Preroll */
+  put_32(f, 0x02);          /* Flags: seekable */
+  put_32(f, PACKET_SIZE);   /* Minimum packet size */
+  put_32(f, PACKET_SIZE);   /* Maximum packet size */
+  put_32(f, 8 * PACKET_SIZE * 1000 / FRAME_MS); /* Maximum bitrate */
+
+  /* Stream properties object */
+  put_guid(f, guid_stream_header);
+  put_64(f, 129);
+  put_guid(f, guid_video_media);
+  put_guid(f, guid_zero);   /* Error correction type */
+  put_64(f, 0);             /* Time offset */
+  put_32(f, 51);            /* Type specific data length */
+  put_32(f, 0);             /* Error correction data length */
+  put_16(f, 1);             /* Stream number */
+  put_32(f, 0);             /* Reserved */
+
+  put_32(f, WIDTH);
+  put_32(f, HEIGHT);
+  fputc(2, f);              /* Reserved */
+  put_16(f, 40);            /* Format data size */
+  
+  put_32(f, 40);            /* BITMAPINFOHEADER */
+  put_32(f, WIDTH);
+  put_32(f, HEIGHT);
+  put_16(f, 1);
+  put_16(f, 24);
+  put_32(f, 0);             /* BI_RGB */
+  put_32(f, FRAME_SIZE);
+  put_32(f, 0);
+  put_32(f, 0);
+  put_32(f, 0);
+  put_32(f, 0);
+  
+  /* Data object */
+  put_guid(f, guid_data);
+  put_64(f, 50 + (uint64_t)NUM_FRAMES * PACKET_SIZE);
+  put_guid(f, guid_zero);   /* File ID */
+  put_64(f, NUM_FRAMES);
+  put_16(f, 0x0101);        /* Reserved */
+
+  for(i = 0; i < NUM_FRAMES; i++)
+    write_packet(f, i);
+
+  /* Simple index object. The last entry points behind the data
+     like in some broken files, and the entry count claims more
+     entries than the object holds. */
+
+  num_entries = (PREROLL_MS + NUM_FRAMES * FRAME_MS) / INTERVAL_MS;
+  
+  put_guid(f, guid_simple_index);
+  put_64(f, 56 + num_entries * 6);
+  put_guid(f, guid_zero);   /* File ID */
+  put_64(f, (uint64_t)INTERVAL_MS * 10000);
+  put_32(f, 1);             /* Maximum packet count */
+  put_32(f, num_entries + 1000000);
+
+  for(i = 0; i < num_entries; i++)
+    {
+    if(i == num_entries - 1)
+      put_32(f, NUM_FRAMES + 10);
+    else
+      put_32(f, index_packet(i));
+    put_16(f, 1);
+    }
+  
+  fclose(f);
+  return 1;
+  }
+
+static bgav_t * open_file(void)
+  {
+  bgav_t * b = bgav_create();
+
+  if(!bgav_open(b, FILENAME))
+    goto fail;
+
+  bgav_select_track(b, 0);
+  bgav_set_video_stream(b, 0, BGAV_STREAM_DECODE);
+
+  if(!bgav_start(b))
+    goto fail;
+
+  return b;
+  
+  fail:
+  bgav_close(b);
+  return NULL;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, k;
+  int ret = 1;
+  int num_frames = 0;
+  int64_t time;
+  bgav_t * b = NULL;
+  gavl_video_format_t format;
+  gavl_video_frame_t * frame = NULL;
+  gavl_video_frame_t * frames[NUM_FRAMES];
+  int64_t timestamps[NUM_FRAMES];
+  uint32_t seed = 1;
+  
+  memset(frames, 0, sizeof(frames));
+  
+  if(!write_file())
+    {
+    fprintf(stderr, "Writing %s failed\n", FILENAME);
+    return 1;
+    }
+
+  /* Linear decode */
+  if(!(b = open_file()))
+    {
+    fprintf(stderr, "Opening %s failed\n", FILENAME);
+    goto end;
+    }
+
+  gavl_video_format_copy(&format, bgav_get_video_format(b, 0));
+  frame = gavl_video_frame_create(&format);
+  
+  while(num_frames < NUM_FRAMES)
+    {
+    frames[num_frames] = gavl_video_frame_create(&format);
+    if(!bgav_read_video(b, frames[num_frames], 0))
+      break;
+    timestamps[num_frames] = frames[num_frames]->timestamp;
+    num_frames++;
+    }
+
+  if(num_frames != NUM_FRAMES)
+    {
+    fprintf(stderr, "Decoded %d frames, expected %d\n", num_frames, NUM_FRAMES);
+    goto end;
+    }
+
+  if(!bgav_can_seek(b))
+    {
+    fprintf(stderr, "File is not seekable\n");
+    goto end;
+    }
+  
+  /* Random seeks, including the ones resolved by the broken last
+     index entry */
+  for(i = 0; i < NUM_SEEKS; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    k = (seed >> 8) % NUM_FRAMES;
+
+    time = timestamps[k];
+    if(!bgav_seek_scaled(b, &time, format.timescale) ||
+       !bgav_read_video(b, frame, 0))
+      {
+      fprintf(stderr, "Seeking to frame %d failed\n", k);
+      goto end;
+      }
+
+    if((frame->timestamp != timestamps[k]) ||
+       !gavl_video_frames_equal(&format, frame, frames[k]))
+      {
+      fprintf(stderr, "Seeking to frame %d (pts %"PRId64") gave pts %"PRId64"\n",
+              k, timestamps[k], frame->timestamp);
+      goto end;
+      }
+    }
+
+  fprintf(stderr, "All ASF seeks OK\n");
+  ret = 0;
+  
+  end:
+
+  if(b)
+    bgav_close(b);
+  if(frame)
+    gavl_video_frame_destroy(frame);
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    if(frames[i])
+      gavl_video_frame_destroy(frames[i]);
+    }
+  remove(FILENAME);
+  return ret;
+  }
@@ -117,6 +117,7 @@ static void print_usage()
   fprintf(stderr, "-L                    List all demultiplexers and codecs\n");
   fprintf(stderr, "-follow               Follow redirections (e.g. in m3u files)\n");
   fprintf(stderr, "-t <num>              Dump track <num> (default: Dump all)\n");
+  fprintf(stderr, "-trace <file>         Write a trace of the decoding pipeline (chrome trace event json)\n");
 
   }
 
@@ -436,6 +437,7 @@ int main(int argc, char ** argv)
   int num_tracks;
   int track = -1;
   int arg_index;
+  const char * trace_file = NULL;
   
   bgav_t * file;
 
@@ -540,6 +542,12 @@ int main(int argc, char ** argv)
       follow_redir = 1;
       arg_index++;
       }
+    else if(!strcmp(argv[arg_index], "-trace"))
+      {
+      trace_file = argv[arg_index+1];
+      bgav_options_set_trace_file(opt, trace_file);
+      arg_index+=2;
+      }
     else
       arg_index++;
     }
@@ -639,6 +647,9 @@ int main(int argc, char ** argv)
           str = gavl_strrep(str, var);
           bgav_close(file);
           file = bgav_create();
+
+          if(trace_file)
+            bgav_options_set_trace_file(bgav_get_options(file), trace_file);
           }
         else
           {
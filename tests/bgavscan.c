@@ -0,0 +1,228 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Scan media files with the batch API and print the throughput.
+ *  Locations are taken from the commandline or, if there are none,
+ *  from stdin (one per line).
+ */
+
+#include <avdec.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+static int verbose = 0;
+
+static void scan_callback(void * data, const char * location,
+                          const gavl_dictionary_t * media_info)
+  {
+  if(!media_info)
+    fprintf(stderr, "Failed: %s\n", location);
+  else if(verbose)
+    {
+    printf("%s\n", location);
+    gavl_dictionary_dump(media_info, 2);
+    printf("\n");
+    }
+  }
+
+static double files_per_sec(int num, gavl_time_t t)
+  {
+  return t > 0 ? (double)num / gavl_time_to_seconds(t) : 0.0;
+  }
+
+/* Comparison: One decoder per file, same number of threads */
+
+static char ** cmp_locations;
+static int cmp_num_locations;
+static int cmp_next_location;
+static int cmp_num_opened;
+static pthread_mutex_t cmp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void * cmp_thread(void * data)
+  {
+  int i;
+  bgav_t * b;
+
+  while(1)
+    {
+    pthread_mutex_lock(&cmp_mutex);
+    i = cmp_next_location++;
+    pthread_mutex_unlock(&cmp_mutex);
+
+    if(i >= cmp_num_locations)
+      break;
+    
+    b = bgav_create();
+    if(bgav_open_scan(b, cmp_locations[i]))
+      {
+      bgav_get_media_info(b);
+      pthread_mutex_lock(&cmp_mutex);
+      cmp_num_opened++;
+      pthread_mutex_unlock(&cmp_mutex);
+      }
+    bgav_close(b);
+    }
+  return NULL;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int num_threads = 0;
+  int compare = 0;
+  int arg_index;
+  int num_locations = 0;
+  int locations_alloc = 0;
+  int num_opened;
+  char ** locations = NULL;
+  char line[4096];
+  char * pos;
+  bgav_scan_t * s;
+  pthread_t * threads;
+  gavl_timer_t * timer;
+  gavl_time_t t;
+
+  arg_index = 1;
+
+  while(arg_index < argc)
+    {
+    if(!strcmp(argv[arg_index], "-t") && (arg_index < argc - 1))
+      {
+      num_threads = strtol(argv[arg_index+1], NULL, 10);
+      arg_index+=2;
+      }
+    else if(!strcmp(argv[arg_index], "-v"))
+      {
+      verbose = 1;
+      arg_index++;
+      }
+    else if(!strcmp(argv[arg_index], "-cmp"))
+      {
+      compare = 1;
+      arg_index++;
+      }
+    else if(!strcmp(argv[arg_index], "-h"))
+      {
+      fprintf(stderr,
+              "Usage: bgavscan [-t threads] [-v] [-cmp] [location ...]\n"
+              "  Locations are read from stdin if none are given\n"
+              "  -t:   Number of threads (default: number of CPUs)\n"
+              "  -v:   Dump the media infos\n"
+              "  -cmp: Compare with bgav_open_scan()/bgav_close() for each file\n"
+              "        using the same number of threads\n");
+      return 0;
+      }
+    else
+      break;
+    }
+
+  if(arg_index < argc)
+    {
+    locations = argv + arg_index;
+    num_locations = argc - arg_index;
+    }
+  else
+    {
+    while(fgets(line, sizeof(line), stdin))
+      {
+      if((pos = strchr(line, '\n')))
+        *pos = '\0';
+      if(line[0] == '\0')
+        continue;
+
+      if(num_locations == locations_alloc)
+        {
+        locations_alloc += 1024;
+        locations = realloc(locations, locations_alloc * sizeof(*locations));
+        }
+      locations[num_locations++] = strdup(line);
+      }
+    }
+
+  if(!num_locations)
+    {
+    fprintf(stderr, "No locations given\n");
+    return -1;
+    }
+
+  if(num_threads <= 0)
+    num_threads = gavl_num_cpus();
+  if(num_threads <= 0)
+    num_threads = 1;
+  if(num_threads > num_locations)
+    num_threads = num_locations;
+  
+  timer = gavl_timer_create();
+
+  /* Batch API */
+  s = bgav_scan_create(NULL, num_threads, scan_callback, NULL);
+
+  gavl_timer_start(timer);
+  num_opened = bgav_scan_files(s, (const char * const *)locations, num_locations);
+  t = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  bgav_scan_destroy(s);
+
+  fprintf(stderr, "bgav_scan_files: %d/%d files in %.3f seconds (%.1f files/sec, %d threads)\n",
+          num_opened, num_locations, gavl_time_to_seconds(t),
+          files_per_sec(num_locations, t), num_threads);
+
+  /* One decoder per file */
+  if(compare)
+    {
+    cmp_locations = locations;
+    cmp_num_locations = num_locations;
+    
+    threads = calloc(num_threads, sizeof(*threads));
+    
+    gavl_timer_destroy(timer);
+    timer = gavl_timer_create();
+    gavl_timer_start(timer);
+
+    for(i = 0; i < num_threads; i++)
+      pthread_create(&threads[i], NULL, cmp_thread, NULL);
+    for(i = 0; i < num_threads; i++)
+      pthread_join(threads[i], NULL);
+    
+    t = gavl_timer_get(timer);
+    gavl_timer_stop(timer);
+
+    free(threads);
+    
+    fprintf(stderr, "bgav_open_scan:  %d/%d files in %.3f seconds (%.1f files/sec, %d threads)\n",
+            cmp_num_opened, num_locations, gavl_time_to_seconds(t),
+            files_per_sec(num_locations, t), num_threads);
+    }
+
+  gavl_timer_destroy(timer);
+
+  if(arg_index >= argc)
+    {
+    for(i = 0; i < num_locations; i++)
+      free(locations[i]);
+    free(locations);
+    }
+
+  return 0;
+  }
@@ -0,0 +1,262 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Write a WAV file and a .cue sheet for it. Play each track of the
+ *  EDL from the cue sheet with bgav_edl_dec_t and check that the
+ *  samples are identical to the ones of a direct decode of the WAV
+ *  file. Seeking within a track is checked as well.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define WAV_FILE "edltest.wav"
+#define CUE_FILE "edltest.cue"
+
+#define SAMPLERATE  44100
+#define CHANNELS    2
+#define NUM_SAMPLES (10 * SAMPLERATE)
+
+#define CD_FRAME 588 /* Samples per CD frame (1/75 sec) */
+
+#define NUM_TRACKS 3
+
+/* Start (INDEX 01) and end of the tracks in CD frames. Track 2 has a
+   pregap (INDEX 00) which isn't part of any track. */
+
+static const int track_start[NUM_TRACKS] = { 0,   235, 565 };
+static const int track_end[NUM_TRACKS]   = { 225, 565, NUM_SAMPLES / CD_FRAME };
+
+static const char * cue_sheet =
+  "REM GENRE Test\n"
+  "PERFORMER \"bgav\"\n"
+  "TITLE \"EDL test\"\n"
+  "FILE \"" WAV_FILE "\" WAVE\n"
+  "  TRACK 01 AUDIO\n"
+  "    TITLE \"One\"\n"
+  "    INDEX 01 00:00:00\n"
+  "  TRACK 02 AUDIO\n"
+  "    TITLE \"Two\"\n"
+  "    INDEX 00 00:03:00\n"
+  "    INDEX 01 00:03:10\n"
+  "  TRACK 03 AUDIO\n"
+  "    TITLE \"Three\"\n"
+  "    INDEX 01 00:07:40\n";
+
+static void put_16(FILE * f, uint16_t v)
+  {
+  fputc(v & 0xff, f);
+  fputc(v >> 8, f);
+  }
+
+static void put_32(FILE * f, uint32_t v)
+  {
+  put_16(f, v & 0xffff);
+  put_16(f, v >> 16);
+  }
+
+static int write_files(void)
+  {
+  int i;
+  uint32_t seed = 1;
+  uint32_t data_size = NUM_SAMPLES * CHANNELS * 2;
+  FILE * f;
+
+  if(!(f = fopen(WAV_FILE, "wb")))
+    return 0;
+
+  fwrite("RIFF", 1, 4, f);
+  put_32(f, 36 + data_size);
+  fwrite("WAVE", 1, 4, f);
+
+  fwrite("fmt ", 1, 4, f);
+  put_32(f, 16);
+  put_16(f, 1); /* PCM */
+  put_16(f, CHANNELS);
+  put_32(f, SAMPLERATE);
+  put_32(f, SAMPLERATE * CHANNELS * 2);
+  put_16(f, CHANNELS * 2);
+  put_16(f, 16);
+
+  fwrite("data", 1, 4, f);
+  put_32(f, data_size);
+
+  /* Noise, so misplaced samples are detected */
+  for(i = 0; i < NUM_SAMPLES * CHANNELS; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    put_16(f, seed >> 16);
+    }
+  fclose(f);
+
+  if(!(f = fopen(CUE_FILE, "w")))
+    return 0;
+  fputs(cue_sheet, f);
+  fclose(f);
+  return 1;
+  }
+
+/* Read up to num samples into frame, which has room for them */
+
+static int read_samples(gavl_audio_source_t * src,
+                        gavl_audio_format_t * fmt,
+                        gavl_audio_frame_t * frame, int num)
+  {
+  gavl_audio_source_set_dst(src, 0, fmt);
+  return gavl_audio_source_read_samples(src, frame, num);
+  }
+
+static int compare_samples(gavl_audio_format_t * fmt,
+                           gavl_audio_frame_t * ref, int ref_offset,
+                           gavl_audio_frame_t * frame, int num)
+  {
+  int bytes = fmt->num_channels * gavl_bytes_per_sample(fmt->sample_format);
+  return !memcmp(ref->samples.u_8 + ref_offset * bytes, frame->samples.u_8,
+                 num * bytes);
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int ret = 1;
+  int result;
+  int start, len;
+  int64_t time;
+  bgav_t * b = NULL;
+  bgav_t * cue = NULL;
+  bgav_edl_dec_t * dec = NULL;
+  const gavl_dictionary_t * edl;
+  gavl_audio_source_t * src;
+  gavl_audio_format_t fmt;
+  gavl_audio_frame_t * ref = NULL;
+  gavl_audio_frame_t * frame = NULL;
+  
+  if(!write_files())
+    {
+    fprintf(stderr, "Writing test files failed\n");
+    return 1;
+    }
+
+  /* Direct decode */
+  b = bgav_create();
+  if(!bgav_open(b, WAV_FILE) ||
+     !bgav_select_track(b, 0) ||
+     !bgav_set_audio_stream(b, 0, BGAV_STREAM_DECODE) ||
+     !bgav_start(b))
+    {
+    fprintf(stderr, "Opening %s failed\n", WAV_FILE);
+    goto end;
+    }
+
+  src = bgav_get_audio_source(b, 0);
+
+  /* Everything in one interleaved frame */
+  gavl_audio_format_copy(&fmt, gavl_audio_source_get_src_format(src));
+  fmt.interleave_mode = GAVL_INTERLEAVE_ALL;
+  fmt.samples_per_frame = NUM_SAMPLES + CD_FRAME;
+
+  ref = gavl_audio_frame_create(&fmt);
+  frame = gavl_audio_frame_create(&fmt);
+
+  if((result = read_samples(src, &fmt, ref, NUM_SAMPLES + CD_FRAME)) != NUM_SAMPLES)
+    {
+    fprintf(stderr, "Direct decode gave %d samples, expected %d\n", result, NUM_SAMPLES);
+    goto end;
+    }
+
+  /* EDL from the cue sheet */
+  cue = bgav_create();
+  if(!bgav_open(cue, CUE_FILE) || !(edl = bgav_get_edl(cue)))
+    {
+    fprintf(stderr, "Got no EDL from %s\n", CUE_FILE);
+    goto end;
+    }
+
+  dec = bgav_edl_dec_create(edl, NULL);
+
+  if(bgav_edl_dec_num_tracks(dec) != NUM_TRACKS)
+    {
+    fprintf(stderr, "EDL has %d tracks, expected %d\n",
+            bgav_edl_dec_num_tracks(dec), NUM_TRACKS);
+    goto end;
+    }
+
+  for(i = 0; i < NUM_TRACKS; i++)
+    {
+    start = track_start[i] * CD_FRAME;
+    len = (track_end[i] - track_start[i]) * CD_FRAME;
+
+    if(!bgav_edl_dec_select_track(dec, i) ||
+       !(src = bgav_edl_dec_get_audio_source(dec, 0)))
+      {
+      fprintf(stderr, "Selecting track %d failed\n", i+1);
+      goto end;
+      }
+
+    /* Whole track */
+    result = read_samples(src, &fmt, frame, len + CD_FRAME);
+    
+    if((result != len) || !compare_samples(&fmt, ref, start, frame, len))
+      {
+      fprintf(stderr, "Track %d: got %d samples, expected %d from %d\n",
+              i+1, result, len, start);
+      goto end;
+      }
+
+    /* Seek to the middle */
+    time = len / 2 + 1;
+    bgav_edl_dec_seek(dec, &time, SAMPLERATE);
+
+    result = read_samples(src, &fmt, frame, len - (len / 2 + 1));
+    
+    if((result != len - (len / 2 + 1)) ||
+       !compare_samples(&fmt, ref, start + len / 2 + 1, frame, result))
+      {
+      fprintf(stderr, "Track %d: samples after seeking differ\n", i+1);
+      goto end;
+      }
+    }
+
+  fprintf(stderr, "All EDL tracks sample identical\n");
+  ret = 0;
+  
+  end:
+
+  if(dec)
+    bgav_edl_dec_destroy(dec);
+  if(cue)
+    bgav_close(cue);
+  if(b)
+    bgav_close(b);
+  if(ref)
+    gavl_audio_frame_destroy(ref);
+  if(frame)
+    gavl_audio_frame_destroy(frame);
+  
+  remove(WAV_FILE);
+  remove(CUE_FILE);
+  return ret;
+  }
@@ -0,0 +1,333 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Serve a generated file from a minimal http server on loopback,
+ *  which supports range requests. Read it with the http input at
+ *  random positions and compare the data with what the file input
+ *  returns. This is done with a small block cache (so blocks get
+ *  evicted) and with the block cache switched off.
+ *  Returns 0 on success.
+ */
+
+#include <avdec_private.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define FILENAME "httptest.bin"
+
+/* Not a multiple of the block size */
+#define FILE_SIZE  (3 * 1024 * 1024 + 12345)
+#define NUM_READS  500
+#define MAX_READ   (300 * 1024)
+
+#define CHUNK_SIZE 1000 /* Responses are sent in small pieces */
+
+static uint8_t * file_data;
+static int server_fd = -1;
+
+/* Server */
+
+static int send_all(int fd, const uint8_t * data, int len)
+  {
+  int result;
+  while(len > 0)
+    {
+    if((result = send(fd, data, len, MSG_NOSIGNAL)) <= 0)
+      return 0;
+    data += result;
+    len -= result;
+    }
+  return 1;
+  }
+
+/* Read the request header up to the empty line */
+
+static int read_request(int fd, char * buf, int size)
+  {
+  int len = 0;
+  
+  while(len < size - 1)
+    {
+    if(recv(fd, buf + len, 1, 0) != 1)
+      return 0;
+    len++;
+    buf[len] = '\0';
+    if((len >= 4) && !strcmp(buf + len - 4, "\r\n\r\n"))
+      return 1;
+    }
+  return 0;
+  }
+
+static void * connection_thread(void * data)
+  {
+  int fd = (int)(intptr_t)data;
+  char request[4096];
+  char header[512];
+  const char * range;
+  int64_t start, end;
+  int64_t pos;
+  int len;
+  int head;
+  
+  while(read_request(fd, request, sizeof(request)))
+    {
+    head = !strncmp(request, "HEAD ", 5);
+    
+    start = 0;
+    end = FILE_SIZE - 1;
+    
+    if((range = strstr(request, "Range: bytes=")) ||
+       (range = strstr(request, "range: bytes=")))
+      {
+      range += 13;
+      start = strtoll(range, (char**)&range, 10);
+      if((*range == '-') && (range[1] >= '0') && (range[1] <= '9'))
+        end = strtoll(range + 1, NULL, 10);
+      if(end > FILE_SIZE - 1)
+        end = FILE_SIZE - 1;
+
+      if(start >= FILE_SIZE)
+        {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                 "Content-Range: bytes */%d\r\n"
+                 "Content-Length: 0\r\n\r\n", FILE_SIZE);
+        if(!send_all(fd, (uint8_t*)header, strlen(header)))
+          break;
+        continue;
+        }
+      
+      snprintf(header, sizeof(header),
+               "HTTP/1.1 206 Partial Content\r\n"
+               "Content-Type: application/octet-stream\r\n"
+               "Accept-Ranges: bytes\r\n"
+               "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n"
+               "Content-Length: %"PRId64"\r\n\r\n",
+               start, end, FILE_SIZE, end - start + 1);
+      }
+    else
+      snprintf(header, sizeof(header),
+               "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/octet-stream\r\n"
+               "Accept-Ranges: bytes\r\n"
+               "Content-Length: %d\r\n\r\n", FILE_SIZE);
+    
+    if(!send_all(fd, (uint8_t*)header, strlen(header)))
+      break;
+
+    if(head)
+      continue;
+
+    /* The client closes the connection if it doesn't want the rest */
+    for(pos = start; pos <= end; pos += len)
+      {
+      len = CHUNK_SIZE;
+      if(len > end + 1 - pos)
+        len = end + 1 - pos;
+      if(!send_all(fd, file_data + pos, len))
+        break;
+      }
+    if(pos <= end)
+      break;
+    }
+  
+  close(fd);
+  return NULL;
+  }
+
+static void * server_thread(void * data)
+  {
+  int fd;
+  pthread_t t;
+
+  while((fd = accept(server_fd, NULL, NULL)) >= 0)
+    {
+    pthread_create(&t, NULL, connection_thread, (void*)(intptr_t)fd);
+    pthread_detach(t);
+    }
+  return NULL;
+  }
+
+static int start_server(void)
+  {
+  pthread_t t;
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if(((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+     bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+     listen(server_fd, 16) ||
+     getsockname(server_fd, (struct sockaddr*)&addr, &addr_len))
+    return 0;
+
+  pthread_create(&t, NULL, server_thread, NULL);
+  pthread_detach(t);
+  return ntohs(addr.sin_port);
+  }
+
+/* Client */
+
+static bgav_input_context_t * open_input(const char * url, int cache_size)
+  {
+  bgav_options_t * opt = bgav_options_create();
+  bgav_input_context_t * ret;
+  
+  bgav_options_set_http_cache_size(opt, cache_size);
+  ret = bgav_input_create(NULL, opt);
+  bgav_options_destroy(opt);
+  
+  if(!bgav_input_open(ret, url))
+    {
+    fprintf(stderr, "Opening %s failed\n", url);
+    bgav_input_destroy(ret);
+    return NULL;
+    }
+  return ret;
+  }
+
+static int compare_reads(const char * url, int cache_size)
+  {
+  int i;
+  int ret = 0;
+  int len;
+  int result_http;
+  int result_file;
+  int64_t pos;
+  uint8_t * buf_http = malloc(MAX_READ);
+  uint8_t * buf_file = malloc(MAX_READ);
+  bgav_input_context_t * http = NULL;
+  bgav_input_context_t * file = NULL;
+  
+  if(!(http = open_input(url, cache_size)) ||
+     !(file = open_input(FILENAME, cache_size)))
+    goto end;
+
+  if(http->total_bytes != file->total_bytes)
+    {
+    fprintf(stderr, "Size mismatch: %"PRId64" != %"PRId64"\n",
+            http->total_bytes, file->total_bytes);
+    goto end;
+    }
+
+  if(!(http->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+    {
+    fprintf(stderr, "http input is not seekable\n");
+    goto end;
+    }
+  
+  srand(cache_size + 1);
+  
+  for(i = 0; i < NUM_READS; i++)
+    {
+    /* Every 10th read continues sequentially, some reach the end */
+    if(i % 10)
+      {
+      pos = rand() % FILE_SIZE;
+      bgav_input_seek(http, pos, SEEK_SET);
+      bgav_input_seek(file, pos, SEEK_SET);
+      }
+    else
+      pos = file->position;
+    
+    len = 1 + rand() % MAX_READ;
+    
+    result_http = bgav_input_read_data(http, buf_http, len);
+    result_file = bgav_input_read_data(file, buf_file, len);
+    
+    if((result_http != result_file) ||
+       memcmp(buf_http, buf_file, result_file))
+      {
+      fprintf(stderr, "Read %d: %d bytes at %"PRId64" differ (got %d and %d)\n",
+              i, len, pos, result_http, result_file);
+      goto end;
+      }
+    }
+  ret = 1;
+  end:
+
+  if(http)
+    bgav_input_destroy(http);
+  if(file)
+    bgav_input_destroy(file);
+  free(buf_http);
+  free(buf_file);
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int port;
+  int ret = 1;
+  char url[128];
+  FILE * f;
+  uint32_t seed = 1;
+  
+  file_data = malloc(FILE_SIZE);
+  for(i = 0; i < FILE_SIZE; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    file_data[i] = seed >> 24;
+    }
+
+  if(!(f = fopen(FILENAME, "wb")) ||
+     (fwrite(file_data, 1, FILE_SIZE, f) < FILE_SIZE))
+    {
+    fprintf(stderr, "Writing %s failed\n", FILENAME);
+    goto end;
+    }
+  fclose(f);
+
+  if(!(port = start_server()))
+    {
+    fprintf(stderr, "Starting http server failed\n");
+    goto end;
+    }
+  
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/" FILENAME, port);
+
+  /* 1 MB cache (4 blocks) and no cache */
+  if(!compare_reads(url, 1) ||
+     !compare_reads(url, 0))
+    goto end;
+  
+  fprintf(stderr, "All http reads OK\n");
+  ret = 0;
+  
+  end:
+  remove(FILENAME);
+  free(file_data);
+  return ret;
+  }
@@ -0,0 +1,396 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Write a directory of numbered PNG images and open it as an image
+ *  sequence. Check the number of frames and the duration, decode it
+ *  linearly, seek to random frames and compare the results. Then decode
+ *  with several video threads and check that the frames are the same.
+ *  The decoding times are printed for each number of threads.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DIRNAME   "imageseqtest_dir"
+#define PATTERN   DIRNAME"/frame_%04d.png"
+
+#define WIDTH      256
+#define HEIGHT     192
+#define ROW_SIZE   (1 + WIDTH * 3) /* Filter byte + RGB */
+#define FIRST      1
+#define NUM_FRAMES 48
+#define NUM_SEEKS  100
+
+#define MAX_THREADS 4
+
+/* PNG writer with stored (uncompressed) deflate blocks */
+
+static uint32_t crc_table[256];
+
+static void init_crc(void)
+  {
+  uint32_t c;
+  int i, j;
+  for(i = 0; i < 256; i++)
+    {
+    c = i;
+    for(j = 0; j < 8; j++)
+      c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+    crc_table[i] = c;
+    }
+  }
+
+static uint32_t crc(uint32_t c, const uint8_t * data, int len)
+  {
+  int i;
+  for(i = 0; i < len; i++)
+    c = crc_table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+  return c;
+  }
+
+static void put_32(uint8_t * ptr, uint32_t val)
+  {
+  ptr[0] = val >> 24;
+  ptr[1] = val >> 16;
+  ptr[2] = val >> 8;
+  ptr[3] = val;
+  }
+
+static void write_chunk(FILE * f, const char * type,
+                        const uint8_t * data, int len)
+  {
+  uint8_t buf[4];
+  uint32_t c;
+  
+  put_32(buf, len);
+  fwrite(buf, 1, 4, f);
+  fwrite(type, 1, 4, f);
+  fwrite(data, 1, len, f);
+
+  c = crc(0xffffffff, (const uint8_t*)type, 4);
+  c = crc(c, data, len);
+  put_32(buf, c ^ 0xffffffff);
+  fwrite(buf, 1, 4, f);
+  }
+
+static int write_png(const char * filename, int frame)
+  {
+  static const uint8_t sig[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+  static uint8_t raw[ROW_SIZE * HEIGHT];
+  static uint8_t idat[2 + ROW_SIZE * HEIGHT + 5 * (ROW_SIZE * HEIGHT / 65535 + 1) + 4];
+  uint8_t ihdr[13];
+  uint8_t * ptr;
+  uint32_t a = 1, b = 0;
+  int x, y, pos, len;
+  FILE * f;
+  
+  /* Image data */
+  ptr = raw;
+  for(y = 0; y < HEIGHT; y++)
+    {
+    *(ptr++) = 0; /* No filter */
+    for(x = 0; x < WIDTH; x++)
+      {
+      *(ptr++) = x + frame;
+      *(ptr++) = y * 3 + frame;
+      *(ptr++) = frame * 5 + x * y;
+      }
+    }
+
+  /* zlib stream */
+  ptr = idat;
+  *(ptr++) = 0x78;
+  *(ptr++) = 0x01;
+
+  for(pos = 0; pos < sizeof(raw); pos += len)
+    {
+    len = sizeof(raw) - pos;
+    if(len > 65535)
+      len = 65535;
+
+    *(ptr++) = (pos + len == sizeof(raw)) ? 1 : 0;
+    *(ptr++) = len & 0xff;
+    *(ptr++) = len >> 8;
+    *(ptr++) = ~len & 0xff;
+    *(ptr++) = (~len >> 8) & 0xff;
+    memcpy(ptr, raw + pos, len);
+    ptr += len;
+    }
+
+  for(pos = 0; pos < sizeof(raw); pos++)
+    {
+    a = (a + raw[pos]) % 65521;
+    b = (b + a) % 65521;
+    }
+  put_32(ptr, (b << 16) | a);
+  ptr += 4;
+  
+  if(!(f = fopen(filename, "wb")))
+    return 0;
+
+  put_32(ihdr, WIDTH);
+  put_32(ihdr + 4, HEIGHT);
+  ihdr[8]  = 8; /* Bit depth  */
+  ihdr[9]  = 2; /* RGB        */
+  ihdr[10] = 0; /* Deflate    */
+  ihdr[11] = 0; /* Filter     */
+  ihdr[12] = 0; /* Interlace  */
+  
+  fwrite(sig, 1, 8, f);
+  write_chunk(f, "IHDR", ihdr, 13);
+  write_chunk(f, "IDAT", idat, ptr - idat);
+  write_chunk(f, "IEND", NULL, 0);
+  fclose(f);
+  return 1;
+  }
+
+/* Files, which must not become part of the sequence */
+
+static const char * other_files[] =
+  {
+    DIRNAME"/frame_12.png",
+    DIRNAME"/frame_0012.jpg",
+    DIRNAME"/other_0012.png",
+    NULL
+  };
+
+static int write_files(void)
+  {
+  int i;
+  char * filename;
+  
+  if(mkdir(DIRNAME, 0755) && (access(DIRNAME, F_OK)))
+    return 0;
+  
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    filename = gavl_sprintf(PATTERN, i + FIRST);
+    if(!write_png(filename, i))
+      {
+      free(filename);
+      return 0;
+      }
+    free(filename);
+    }
+  for(i = 0; other_files[i]; i++)
+    {
+    if(!write_png(other_files[i], 255))
+      return 0;
+    }
+  return 1;
+  }
+
+static void remove_files(void)
+  {
+  int i;
+  char * filename;
+
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    filename = gavl_sprintf(PATTERN, i + FIRST);
+    remove(filename);
+    free(filename);
+    }
+  for(i = 0; other_files[i]; i++)
+    remove(other_files[i]);
+  rmdir(DIRNAME);
+  }
+
+static bgav_t * open_sequence(int threads)
+  {
+  bgav_t * b = bgav_create();
+
+  bgav_options_set_video_threads(bgav_get_options(b), threads);
+  
+  if(!bgav_open(b, PATTERN) ||
+     !bgav_select_track(b, 0) ||
+     !bgav_set_video_stream(b, 0, BGAV_STREAM_DECODE) ||
+     !bgav_start(b))
+    {
+    fprintf(stderr, "Opening %s failed\n", PATTERN);
+    bgav_close(b);
+    return NULL;
+    }
+  return b;
+  }
+
+/* Format of the decoded frames, set by the first linear decode */
+
+static gavl_video_format_t format;
+
+/* Decode all frames and compare them to the reference if given */
+
+static int decode_linear(int threads, gavl_video_frame_t ** frames,
+                         gavl_video_frame_t ** ref)
+  {
+  int num = 0;
+  int ret = 0;
+  gavl_time_t t;
+  gavl_timer_t * timer = NULL;
+  gavl_video_frame_t * frame = NULL;
+  bgav_t * b;
+
+  if(!(b = open_sequence(threads)))
+    return 0;
+
+  gavl_video_format_copy(&format, bgav_get_video_format(b, 0));
+  
+  if(bgav_video_duration(b, 0) != NUM_FRAMES * format.frame_duration)
+    {
+    fprintf(stderr, "Duration is %"PRId64", expected %"PRId64"\n",
+            bgav_video_duration(b, 0), (int64_t)NUM_FRAMES * format.frame_duration);
+    goto end;
+    }
+
+  for(num = 0; num < NUM_FRAMES; num++)
+    {
+    if(!frames[num])
+      frames[num] = gavl_video_frame_create(&format);
+    }
+  frame = gavl_video_frame_create(&format);
+  
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(num = 0; num < NUM_FRAMES; num++)
+    {
+    if(!bgav_read_video(b, frames[num], 0))
+      break;
+    
+    if((frames[num]->timestamp != num * format.frame_duration) ||
+       (ref && !gavl_video_frames_equal(&format, frames[num], ref[num])))
+      {
+      fprintf(stderr, "Frame %d differs with %d threads\n", num, threads);
+      goto end;
+      }
+    }
+
+  t = gavl_timer_get(timer);
+  
+  if((num != NUM_FRAMES) || bgav_read_video(b, frame, 0))
+    {
+    fprintf(stderr, "Decoded %d frames, expected %d\n",
+            num, NUM_FRAMES);
+    goto end;
+    }
+
+  fprintf(stderr, "Decoded %d frames with %d threads in %.3f seconds\n",
+          num, threads, gavl_time_to_seconds(t));
+  
+  ret = 1;
+  end:
+  if(timer)
+    gavl_timer_destroy(timer);
+  if(frame)
+    gavl_video_frame_destroy(frame);
+  bgav_close(b);
+  return ret;
+  }
+
+static int test_seeks(gavl_video_frame_t ** ref)
+  {
+  int i, k;
+  int ret = 0;
+  uint32_t seed = 1;
+  gavl_video_frame_t * frame;
+  bgav_t * b;
+
+  if(!(b = open_sequence(1)))
+    return 0;
+
+  frame = gavl_video_frame_create(&format);
+  
+  for(i = 0; i < NUM_SEEKS; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    k = (seed >> 8) % NUM_FRAMES;
+
+    if(!bgav_seek_to_video_frame(b, 0, k) ||
+       !bgav_read_video(b, frame, 0))
+      {
+      fprintf(stderr, "Seeking to frame %d failed\n", k);
+      goto end;
+      }
+    
+    if((frame->timestamp != ref[k]->timestamp) ||
+       !gavl_video_frames_equal(&format, frame, ref[k]))
+      {
+      fprintf(stderr, "Seeking to frame %d (pts %"PRId64") gave pts %"PRId64"\n",
+              k, ref[k]->timestamp, frame->timestamp);
+      goto end;
+      }
+    }
+  ret = 1;
+  end:
+  gavl_video_frame_destroy(frame);
+  bgav_close(b);
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, threads;
+  int ret = 1;
+  gavl_video_frame_t * ref[NUM_FRAMES];
+  gavl_video_frame_t * frames[NUM_FRAMES];
+
+  memset(ref, 0, sizeof(ref));
+  memset(frames, 0, sizeof(frames));
+  
+  init_crc();
+  
+  if(!write_files())
+    {
+    fprintf(stderr, "Writing the images failed\n");
+    goto end;
+    }
+  
+  if(!decode_linear(1, ref, NULL) ||
+     !test_seeks(ref))
+    goto end;
+
+  for(threads = 2; threads <= MAX_THREADS; threads *= 2)
+    {
+    if(!decode_linear(threads, frames, ref))
+      goto end;
+    }
+  
+  fprintf(stderr, "Image sequence OK\n");
+  ret = 0;
+  
+  end:
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    if(ref[i])
+      gavl_video_frame_destroy(ref[i]);
+    if(frames[i])
+      gavl_video_frame_destroy(frames[i]);
+    }
+  remove_files();
+  return ret;
+  }
@@ -0,0 +1,217 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Save a generated packet index in the compact format, load it back
+ *  and check lookups in the file against a linear search.
+ *  Returns 0 on success.
+ */
+
+#include <avdec_private.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_STREAMS  3
+#define NUM_ENTRIES  100000
+#define NUM_LOOKUPS  1000
+
+static gavl_packet_index_t * make_index()
+  {
+  int i;
+  int stream;
+  int64_t position = 0;
+  int64_t pts[NUM_STREAMS] = { 0, 1000, -500 };
+  int64_t duration;
+  uint32_t size;
+  gavl_packet_index_t * ret = gavl_packet_index_create(NUM_ENTRIES);
+  
+  for(i = 0; i < NUM_ENTRIES; i++)
+    {
+    stream = rand() % NUM_STREAMS;
+    /* No empty packets: Their order at the same position isn't kept */
+    size = 1 + rand() % 10000;
+    duration = 1 + rand() % 3000;
+    
+    gavl_packet_index_add(ret, position, size, stream + 1, pts[stream],
+                          (rand() % 10) ? 0 : GAVL_PACKET_KEYFRAME, duration);
+
+    position += size;
+    pts[stream] += duration;
+    }
+  return ret;
+  }
+
+static int cmp_entry(const gavl_packet_index_t * idx, int i,
+                     const bgav_packet_index_file_entry_t * e)
+  {
+  return (idx->entries[i].position == e->position) &&
+    (idx->entries[i].size == e->size) &&
+    (idx->entries[i].pts == e->pts) &&
+    (idx->entries[i].duration == e->duration) &&
+    (idx->entries[i].flags == e->flags);
+  }
+
+/* Reference: Linear search for the last entry not after key */
+
+static int find_linear(const gavl_packet_index_t * idx, int stream_id,
+                       int64_t key, int use_pts, int * stream_idx)
+  {
+  int i;
+  int ret = -1;
+  int num = 0;
+
+  *stream_idx = -1;
+  
+  for(i = 0; i < idx->num_entries; i++)
+    {
+    if(idx->entries[i].stream_id != stream_id)
+      continue;
+
+    if((use_pts ? idx->entries[i].pts : idx->entries[i].position) <= key)
+      {
+      ret = i;
+      *stream_idx = num;
+      }
+    num++;
+    }
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, j;
+  int ret = 0;
+  int stream_id;
+  int use_pts;
+  int64_t key;
+  int idx_linear;
+  int idx_file;
+  char filename[] = "/tmp/bgav_indexfiletest_XXXXXX";
+  int fd;
+  
+  gavl_packet_index_t * idx;
+  gavl_packet_index_t * loaded;
+  bgav_packet_index_file_t * f;
+  bgav_packet_index_file_entry_t e;
+  
+  srand(0);
+
+  if((fd = mkstemp(filename)) < 0)
+    {
+    fprintf(stderr, "Cannot create temporary file\n");
+    return 1;
+    }
+  close(fd);
+  
+  idx = make_index();
+
+  if(!bgav_packet_index_save_compact(idx, filename))
+    {
+    fprintf(stderr, "Saving index failed\n");
+    ret = 1;
+    goto end;
+    }
+
+  /* Full load */
+  
+  if(!(loaded = bgav_packet_index_load_compact(filename)))
+    {
+    fprintf(stderr, "Loading index failed\n");
+    ret = 1;
+    goto end;
+    }
+
+  if(loaded->num_entries != idx->num_entries)
+    {
+    fprintf(stderr, "Loaded %d entries, expected %d\n",
+            loaded->num_entries, idx->num_entries);
+    ret = 1;
+    }
+  else
+    {
+    for(i = 0; i < idx->num_entries; i++)
+      {
+      if((idx->entries[i].position  != loaded->entries[i].position) ||
+         (idx->entries[i].size      != loaded->entries[i].size) ||
+         (idx->entries[i].stream_id != loaded->entries[i].stream_id) ||
+         (idx->entries[i].pts       != loaded->entries[i].pts) ||
+         (idx->entries[i].duration  != loaded->entries[i].duration) ||
+         (idx->entries[i].flags     != loaded->entries[i].flags))
+        {
+        fprintf(stderr, "Loaded entry %d differs\n", i);
+        ret = 1;
+        break;
+        }
+      }
+    }
+  gavl_packet_index_destroy(loaded);
+
+  /* Lookups */
+
+  if(!(f = bgav_packet_index_file_open(filename)))
+    {
+    fprintf(stderr, "Opening index failed\n");
+    ret = 1;
+    goto end;
+    }
+  
+  for(i = 0; i < NUM_LOOKUPS; i++)
+    {
+    /* Include a nonexisting stream */
+    stream_id = rand() % (NUM_STREAMS + 1) + 1;
+    use_pts = rand() % 2;
+
+    /* Also before the first and after the last entries */
+    if(use_pts)
+      {
+      key = (int64_t)(rand() % (NUM_ENTRIES / NUM_STREAMS * 1600)) - 2000;
+      idx_file = bgav_packet_index_file_find_pts(f, stream_id, key, &e);
+      }
+    else
+      {
+      key = rand() % (NUM_ENTRIES * 5100);
+      idx_file = bgav_packet_index_file_find_position(f, stream_id, key, &e);
+      }
+    
+    j = find_linear(idx, stream_id, key, use_pts, &idx_linear);
+    
+    if((idx_file != idx_linear) || ((j >= 0) && !cmp_entry(idx, j, &e)))
+      {
+      fprintf(stderr, "Lookup of %s %"PRId64" in stream %d: got %d, expected %d\n",
+              use_pts ? "pts" : "position", key,
+              stream_id, idx_file, idx_linear);
+      ret = 1;
+      }
+    }
+
+  bgav_packet_index_file_close(f);
+
+  end:
+  
+  gavl_packet_index_destroy(idx);
+  remove(filename);
+
+  if(!ret)
+    fprintf(stderr, "All index lookups OK\n");
+  return ret;
+  }
@@ -0,0 +1,190 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Send an RTP encapsulated transport stream over loopback with
+ *  known losses, reordering and duplicates. Open it with the rtp://
+ *  input and check the statistics returned by bgav_get_rtp_stats().
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tsgen.h"
+
+#define NUM_DATAGRAMS 1000
+#define FIRST_SEQ     65000 /* Sequence numbers wrap around */
+
+#define RTP_HEADER_SIZE 12
+#define SEND_INTERVAL   1000 /* Microseconds */
+#define START_DELAY     500000 /* Wait until the receiver is open */
+
+/* Impairments */
+#define IS_LOST(i)       (((i) % 50) == 25)
+#define IS_SWAPPED(i)    (((i) % 100) == 60) /* Sent after the next one */
+#define IS_DUPLICATE(i)  (((i) % 200) == 150)
+
+static int port;
+
+static void send_datagram(int fd, struct sockaddr_in * addr, int i)
+  {
+  uint8_t buf[RTP_HEADER_SIZE + TSGEN_DATAGRAM_SIZE];
+  uint16_t seq = FIRST_SEQ + i;
+  uint32_t timestamp = i * (SEND_INTERVAL * 9 / 100);
+  
+  buf[0] = 0x80;  /* Version 2 */
+  buf[1] = 33;    /* MP2T */
+  buf[2] = seq >> 8;
+  buf[3] = seq & 0xff;
+  buf[4] = timestamp >> 24;
+  buf[5] = (timestamp >> 16) & 0xff;
+  buf[6] = (timestamp >> 8) & 0xff;
+  buf[7] = timestamp & 0xff;
+  memcpy(buf + 8, "bgav", 4); /* SSRC */
+
+  tsgen_make_datagram(buf + RTP_HEADER_SIZE, i);
+  
+  sendto(fd, buf, sizeof(buf), 0, (struct sockaddr*)addr, sizeof(*addr));
+  }
+
+static void * sender_thread(void * data)
+  {
+  int i;
+  int fd;
+  struct sockaddr_in addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  usleep(START_DELAY);
+  
+  for(i = 0; i < NUM_DATAGRAMS; i++)
+    {
+    if(IS_LOST(i))
+      continue;
+
+    if(IS_SWAPPED(i))
+      {
+      send_datagram(fd, &addr, i+1);
+      send_datagram(fd, &addr, i);
+      i++;
+      }
+    else
+      send_datagram(fd, &addr, i);
+    
+    if(IS_DUPLICATE(i))
+      send_datagram(fd, &addr, i);
+
+    usleep(SEND_INTERVAL);
+    }
+
+  close(fd);
+  return NULL;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int ret = 1;
+  char url[64];
+  bgav_t * b;
+  bgav_rtp_stats_t stats;
+  pthread_t sender;
+  
+  int64_t received = 0;
+  int64_t lost = 0;
+
+  /* Expected results */
+  for(i = 0; i < NUM_DATAGRAMS; i++)
+    {
+    if(IS_LOST(i))
+      lost++;
+    else
+      received++;
+    if(IS_DUPLICATE(i))
+      {
+      received++;
+      lost--;
+      }
+    }
+  
+  port = 20000 + getpid() % 20000;
+  snprintf(url, sizeof(url), "rtp://127.0.0.1:%d", port);
+  
+  b = bgav_create();
+
+  pthread_create(&sender, NULL, sender_thread, NULL);
+  
+  if(!bgav_open(b, url))
+    {
+    fprintf(stderr, "Opening %s failed\n", url);
+    pthread_join(sender, NULL);
+    goto end;
+    }
+
+  pthread_join(sender, NULL);
+
+  /* Let the receiver thread catch up */
+  usleep(200000);
+
+  if(!bgav_get_rtp_stats(b, &stats))
+    {
+    fprintf(stderr, "Got no RTP statistics\n");
+    goto end;
+    }
+
+  fprintf(stderr, "Received: %"PRId64", expected: %"PRId64", lost: %"PRId64", jitter: %"PRId64" us\n",
+          stats.packets_received, stats.packets_expected, stats.packets_lost,
+          stats.jitter);
+  
+  if((stats.packets_received != received) ||
+     (stats.packets_expected != NUM_DATAGRAMS) ||
+     (stats.packets_lost != lost) ||
+     (stats.highest_seq != FIRST_SEQ + NUM_DATAGRAMS - 1) ||
+     (stats.jitter < 0))
+    {
+    fprintf(stderr, "Expected received: %"PRId64", lost: %"PRId64"\n",
+            received, lost);
+    goto end;
+    }
+
+  fprintf(stderr, "RTP statistics OK\n");
+  ret = 0;
+  
+  end:
+  
+  bgav_close(b);
+  return ret;
+  }
@@ -0,0 +1,245 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Write an SRT file with many cues, some of them unsorted or
+ *  overlapping and with an @OFF line in the middle. Read it linearly,
+ *  then seek to random times and check that reading continues with
+ *  the first cue (in file order) which ends at or after the seek time.
+ *  This is done with the cue index built on demand and at open time.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define FILENAME "srttest.srt"
+
+#define NUM_CUES       50000
+#define NUM_SEEKS      1000
+#define CUES_PER_SEEK  3
+#define OFFSET_CUE     25000 /* @OFF=2.5 before this one */
+
+typedef struct
+  {
+  int64_t start;
+  int64_t duration;
+  char * text;
+  } cue_t;
+
+static cue_t cues[NUM_CUES];
+
+static void write_time(FILE * f, int64_t t)
+  {
+  fprintf(f, "%02d:%02d:%02d,%03d",
+          (int)(t / 3600000), (int)((t / 60000) % 60),
+          (int)((t / 1000) % 60), (int)(t % 1000));
+  }
+
+static int write_file(void)
+  {
+  int i;
+  int64_t start, duration;
+  FILE * f;
+
+  if(!(f = fopen(FILENAME, "w")))
+    return 0;
+
+  /* The probe wants a timing or command line at the start */
+  fprintf(f, "@OFF=0\n");
+  
+  for(i = 0; i < NUM_CUES; i++)
+    {
+    start = (int64_t)i * 100 + (i % 7) * 10;
+    duration = 80;
+
+    if(!(i % 1000))
+      start -= 5000; /* Unsorted */
+    if(start < 0)
+      start = 0;
+    if(!(i % 500))
+      duration = 20000; /* Overlapping */
+
+    if(i == OFFSET_CUE)
+      fprintf(f, "@OFF=2.5\n");
+
+    fprintf(f, "%d\n", i + 1);
+    write_time(f, start);
+    fprintf(f, " --> ");
+    write_time(f, start + duration);
+    fprintf(f, "\nCue %d\nSecond line %d\n\n", i + 1, i + 1);
+    }
+  fclose(f);
+  return 1;
+  }
+
+static bgav_t * open_file(int index)
+  {
+  bgav_t * b = bgav_create();
+
+  bgav_options_set_subtitle_index(bgav_get_options(b), index);
+  
+  if(!bgav_open(b, FILENAME) ||
+     !bgav_num_text_streams(b, 0) ||
+     !bgav_select_track(b, 0) ||
+     !bgav_set_text_stream(b, 0, BGAV_STREAM_DECODE) ||
+     !bgav_start(b))
+    {
+    fprintf(stderr, "Opening %s failed\n", FILENAME);
+    bgav_close(b);
+    return NULL;
+    }
+  return b;
+  }
+
+static int read_linear(void)
+  {
+  int num = 0;
+  char * text = NULL;
+  int text_alloc = 0;
+  bgav_t * b;
+
+  if(!(b = open_file(0)))
+    return 0;
+
+  while((num < NUM_CUES) &&
+        bgav_read_subtitle_text(b, &text, &text_alloc,
+                                &cues[num].start, &cues[num].duration, 0))
+    {
+    cues[num].text = strdup(text);
+    num++;
+    }
+
+  bgav_close(b);
+  if(text)
+    free(text);
+
+  if(num != NUM_CUES)
+    {
+    fprintf(stderr, "Read %d cues, expected %d\n", num, NUM_CUES);
+    return 0;
+    }
+  return 1;
+  }
+
+static int test_seeks(int index)
+  {
+  int i, j, k;
+  int ret = 0;
+  int64_t time;
+  int64_t max_time = 0;
+  int64_t start, duration;
+  char * text = NULL;
+  int text_alloc = 0;
+  bgav_t * b;
+  
+  if(!(b = open_file(index)))
+    return 0;
+
+  for(i = 0; i < NUM_CUES; i++)
+    {
+    if(max_time < cues[i].start + cues[i].duration)
+      max_time = cues[i].start + cues[i].duration;
+    }
+  
+  srand(index + 1);
+  
+  for(i = 0; i < NUM_SEEKS; i++)
+    {
+    /* Some seeks go behind the last cue */
+    time = (int64_t)(((double)rand() / RAND_MAX) * (max_time + 1000));
+
+    /* First cue, which is still visible */
+    for(k = 0; k < NUM_CUES; k++)
+      {
+      if(cues[k].start + cues[k].duration >= time)
+        break;
+      }
+    
+    if(!bgav_seek_scaled(b, &time, 1000))
+      {
+      fprintf(stderr, "Seeking to %"PRId64" failed\n", time);
+      goto end;
+      }
+    
+    for(j = 0; j < CUES_PER_SEEK; j++, k++)
+      {
+      if(!bgav_read_subtitle_text(b, &text, &text_alloc, &start, &duration, 0))
+        {
+        if(k < NUM_CUES)
+          {
+          fprintf(stderr, "Got no cue after seeking to %"PRId64", expected cue %d\n",
+                  time, k + 1);
+          goto end;
+          }
+        break;
+        }
+      
+      if((k >= NUM_CUES) ||
+         (start != cues[k].start) ||
+         (duration != cues[k].duration) ||
+         strcmp(text, cues[k].text))
+        {
+        fprintf(stderr, "Wrong cue after seeking to %"PRId64": %s (expected cue %d)\n",
+                time, text, k + 1);
+        goto end;
+        }
+      }
+    }
+  ret = 1;
+  end:
+  bgav_close(b);
+  if(text)
+    free(text);
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int ret = 1;
+
+  if(!write_file())
+    {
+    fprintf(stderr, "Writing %s failed\n", FILENAME);
+    return 1;
+    }
+
+  if(!read_linear() ||
+     !test_seeks(0) ||
+     !test_seeks(1))
+    goto end;
+
+  fprintf(stderr, "All SRT seeks OK\n");
+  ret = 0;
+
+  end:
+  for(i = 0; i < NUM_CUES; i++)
+    {
+    if(cues[i].text)
+      free(cues[i].text);
+    }
+  remove(FILENAME);
+  return ret;
+  }
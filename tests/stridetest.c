@@ -0,0 +1,261 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Write Y4M and DV files, read all video packets linearly, then seek
+ *  to random frames and check that the same packets come out. The
+ *  Y4M and DV files have fixed size frames, so the duration must be
+ *  known at open time. A second Y4M file has a longer frame header in
+ *  the middle, which makes the demuxer fall back to index based
+ *  seeking. Packets are compared instead of decoded frames, because
+ *  there is no builtin DV video decoder.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define Y4M_FILENAME "stridetest.y4m"
+#define DV_FILENAME  "stridetest.dv"
+
+#define Y4M_WIDTH      64
+#define Y4M_HEIGHT     48
+#define Y4M_FRAME_SIZE (Y4M_WIDTH * Y4M_HEIGHT * 3 / 2)
+#define Y4M_FRAMES     100
+
+#define DV_FRAME_SIZE  144000 /* 625/50 (PAL) */
+#define DV_FRAMES      50
+
+#define NUM_SEEKS      200
+
+static uint32_t seed = 1;
+
+static void fill_noise(uint8_t * data, int len)
+  {
+  int i;
+  for(i = 0; i < len; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    data[i] = seed >> 24;
+    }
+  }
+
+/* If variable is nonzero, one frame header carries a parameter */
+
+static int write_y4m(int variable)
+  {
+  int i;
+  uint8_t frame[Y4M_FRAME_SIZE];
+  FILE * f;
+
+  if(!(f = fopen(Y4M_FILENAME, "wb")))
+    return 0;
+
+  fprintf(f, "YUV4MPEG2 W%d H%d F25:1 Ip A1:1 C420jpeg\n",
+          Y4M_WIDTH, Y4M_HEIGHT);
+
+  for(i = 0; i < Y4M_FRAMES; i++)
+    {
+    if(variable && (i == Y4M_FRAMES / 2))
+      fprintf(f, "FRAME Ip\n");
+    else
+      fprintf(f, "FRAME\n");
+    
+    fill_noise(frame, Y4M_FRAME_SIZE);
+    fwrite(frame, 1, Y4M_FRAME_SIZE, f);
+    }
+  fclose(f);
+  return 1;
+  }
+
+/* Noise with the few header bytes the demuxer looks at */
+
+static int write_dv(void)
+  {
+  int i;
+  uint8_t * frame;
+  FILE * f;
+
+  if(!(f = fopen(DV_FILENAME, "wb")))
+    return 0;
+
+  frame = malloc(DV_FRAME_SIZE);
+  
+  for(i = 0; i < DV_FRAMES; i++)
+    {
+    fill_noise(frame, DV_FRAME_SIZE);
+
+    /* Header DIF block, 625/50 */
+    frame[0] = 0x1f;
+    frame[1] = 0x07;
+    frame[2] = 0x00;
+    frame[3] = 0x80;
+    frame[4] = 0x00;
+    frame[5] = 0x00;
+
+    /* Video source type (25 Mbps) */
+    frame[80*5 + 48 + 3] = 0x00;
+    
+    /* Audio source pack: 48 kHz, 16 bit, 2 channels */
+    frame[80*6 + 80*16*3 + 3] = 0x50;
+    frame[80*6 + 80*16*3 + 4] = 0x18;
+    frame[80*6 + 80*16*3 + 5] = 0x00;
+    frame[80*6 + 80*16*3 + 6] = 0x00;
+    frame[80*6 + 80*16*3 + 7] = 0x00;
+    
+    fwrite(frame, 1, DV_FRAME_SIZE, f);
+    }
+  free(frame);
+  fclose(f);
+  return 1;
+  }
+
+static int test_file(const char * filename, int num_frames, int frame_size,
+                     int fixed_stride)
+  {
+  int i, k;
+  int ret = 0;
+  int64_t duration;
+  int64_t * timestamps;
+  uint8_t * frames;
+  const gavl_video_format_t * format;
+  gavl_packet_t p;
+  bgav_t * b = bgav_create();
+  
+  memset(&p, 0, sizeof(p));
+
+  timestamps = calloc(num_frames, sizeof(*timestamps));
+  frames = malloc((int64_t)num_frames * frame_size);
+  
+  if(!bgav_open(b, filename) ||
+     !bgav_select_track(b, 0) ||
+     !bgav_set_video_stream(b, 0, BGAV_STREAM_READRAW) ||
+     !bgav_start(b))
+    {
+    fprintf(stderr, "Opening %s failed\n", filename);
+    goto end;
+    }
+
+  format = bgav_get_video_format(b, 0);
+
+  if(fixed_stride)
+    {
+    duration = bgav_video_duration(b, 0);
+    if(duration != (int64_t)num_frames * format->frame_duration)
+      {
+      fprintf(stderr, "%s: Duration is %"PRId64", expected %"PRId64"\n",
+              filename, duration, (int64_t)num_frames * format->frame_duration);
+      goto end;
+      }
+    }
+  
+  /* Linear read */
+  for(i = 0; i < num_frames; i++)
+    {
+    if(!bgav_read_video_packet(b, 0, &p) || (p.buf.len != frame_size))
+      {
+      fprintf(stderr, "%s: Reading frame %d failed\n", filename, i);
+      goto end;
+      }
+    timestamps[i] = p.pts;
+    memcpy(frames + (int64_t)i * frame_size, p.buf.buf, frame_size);
+    }
+
+  if(bgav_read_video_packet(b, 0, &p))
+    {
+    fprintf(stderr, "%s: Got more than %d frames\n", filename, num_frames);
+    goto end;
+    }
+
+  if(!bgav_can_seek(b))
+    {
+    fprintf(stderr, "%s: File is not seekable\n", filename);
+    goto end;
+    }
+  
+  /* Random seeks, always including the first and last frame */
+  for(i = 0; i < NUM_SEEKS; i++)
+    {
+    if(i == 0)
+      k = num_frames - 1;
+    else if(i == 1)
+      k = 0;
+    else
+      {
+      seed = seed * 1103515245 + 12345;
+      k = (seed >> 8) % num_frames;
+      }
+    
+    if(!bgav_seek_to_video_frame(b, 0, k) ||
+       !bgav_read_video_packet(b, 0, &p))
+      {
+      fprintf(stderr, "%s: Seeking to frame %d failed\n", filename, k);
+      goto end;
+      }
+
+    if((p.pts != timestamps[k]) ||
+       (p.buf.len != frame_size) ||
+       memcmp(p.buf.buf, frames + (int64_t)k * frame_size, frame_size))
+      {
+      fprintf(stderr, "%s: Seeking to frame %d (pts %"PRId64") gave pts %"PRId64"\n",
+              filename, k, timestamps[k], p.pts);
+      goto end;
+      }
+    }
+  
+  ret = 1;
+  end:
+  gavl_packet_free(&p);
+  bgav_close(b);
+  free(timestamps);
+  free(frames);
+  remove(filename);
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  if(!write_y4m(0) || !write_dv())
+    {
+    fprintf(stderr, "Writing test files failed\n");
+    return 1;
+    }
+  
+  if(!test_file(Y4M_FILENAME, Y4M_FRAMES, Y4M_FRAME_SIZE, 1) ||
+     !test_file(DV_FILENAME, DV_FRAMES, DV_FRAME_SIZE, 1))
+    return 1;
+
+  /* Y4M with variable frame headers */
+  if(!write_y4m(1))
+    {
+    fprintf(stderr, "Writing %s failed\n", Y4M_FILENAME);
+    return 1;
+    }
+
+  if(!test_file(Y4M_FILENAME, Y4M_FRAMES, Y4M_FRAME_SIZE, 0))
+    return 1;
+  
+  fprintf(stderr, "All Y4M and DV seeks OK\n");
+  return 0;
+  }
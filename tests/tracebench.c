@@ -0,0 +1,165 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Measure the cost of the pipeline tracer: the check done by
+ *  BGAV_TRACE_BEGIN/END when no trace is running, and the events
+ *  recorded while a trace is running, with one and several threads.
+ *  The CPU time per event is printed together with the decoding time
+ *  per frame, above which the tracer stays below the overhead limit.
+ */
+
+#include <avdec_private.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_TRACE
+#include <time.h>
+#include <pthread.h>
+#endif
+
+#define TRACE_FILE "tracebench.json"
+
+#define NUM_EVENTS  (1<<24)
+#define MAX_THREADS 4
+
+/*
+ *  Rough number of events for one decoded frame:
+ *  next_packet, input_read, parse_frame and decode_video, all with
+ *  begin and end.
+ */
+
+#define EVENTS_PER_FRAME 8
+
+/* Maximum tracing overhead in percent */
+#define MAX_OVERHEAD 2.0
+
+#ifdef HAVE_TRACE
+
+/* Keeps the compiler from removing the loops */
+static volatile int sink;
+
+/* CPU time of the calling thread in nanoseconds */
+static int64_t thread_time(void)
+  {
+  struct timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+  }
+
+static void * run_events(void * data)
+  {
+  int i;
+  int64_t * ns = data;
+
+  *ns = thread_time();
+  for(i = 0; i < NUM_EVENTS / 2; i++)
+    {
+    BGAV_TRACE_BEGIN("bench");
+    sink = i;
+    BGAV_TRACE_END("bench");
+    }
+  *ns = thread_time() - *ns;
+  return NULL;
+  }
+
+static void * run_empty(void * data)
+  {
+  int i;
+  int64_t * ns = data;
+
+  *ns = thread_time();
+  for(i = 0; i < NUM_EVENTS / 2; i++)
+    sink = i;
+  *ns = thread_time() - *ns;
+  return NULL;
+  }
+
+/* CPU nanoseconds per event, averaged over num_threads threads */
+
+static double measure(void * (*func)(void*), int num_threads)
+  {
+  int i;
+  int64_t total = 0;
+  int64_t ns[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  
+  for(i = 0; i < num_threads; i++)
+    pthread_create(&threads[i], NULL, func, &ns[i]);
+  for(i = 0; i < num_threads; i++)
+    {
+    pthread_join(threads[i], NULL);
+    total += ns[i];
+    }
+  return (double)total / ((double)NUM_EVENTS * num_threads);
+  }
+
+static void report(const char * label, double ns)
+  {
+  fprintf(stderr, "%-28s %6.2f ns per event, below %.0f %% for frames longer than %.2f us\n",
+          label, ns, MAX_OVERHEAD, ns * EVENTS_PER_FRAME * (100.0 / MAX_OVERHEAD) / 1000.0);
+  }
+
+int main(int argc, char ** argv)
+  {
+  double empty, ns;
+  char label[64];
+  bgav_t * b;
+  
+  empty = measure(run_empty, 1);
+  
+  /* Disabled tracer */
+  ns = measure(run_events, 1) - empty;
+  report("Inactive:", ns);
+  
+  /* Active tracer */
+  b = bgav_create();
+  bgav_options_set_trace_file(bgav_get_options(b), TRACE_FILE);
+  bgav_trace_init(b);
+
+  if(!(b->flags & BGAV_FLAG_TRACE))
+    {
+    fprintf(stderr, "Starting the trace failed\n");
+    bgav_close(b);
+    return 1;
+    }
+
+  ns = measure(run_events, 1) - empty;
+  report("Active, 1 thread:", ns);
+
+  ns = measure(run_events, MAX_THREADS) - measure(run_empty, MAX_THREADS);
+  snprintf(label, sizeof(label), "Active, %d threads:", MAX_THREADS);
+  report(label, ns);
+  
+  bgav_close(b);
+  remove(TRACE_FILE);
+  return 0;
+  }
+
+#else
+
+int main(int argc, char ** argv)
+  {
+  fprintf(stderr, "Tracing is disabled (configure with --enable-trace)\n");
+  return 0;
+  }
+
+#endif
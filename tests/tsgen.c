@@ -0,0 +1,170 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <string.h>
+
+#include "tsgen.h"
+
+#define PMT_PID   0x100
+#define AUDIO_PID 0x101
+
+/* PAT and PMT are repeated every PSI_INTERVAL datagrams */
+#define PSI_INTERVAL 20
+
+/* MPEG-1 layer II, 128 kbps, 48 kHz, 1152 samples per frame */
+#define FRAME_BYTES    384
+#define FRAME_DURATION 2160
+
+#define PES_HEADER_SIZE 14
+#define PES_PAYLOAD     (TSGEN_PACKET_SIZE - 4 - PES_HEADER_SIZE)
+
+static uint32_t crc32_mpeg(const uint8_t * data, int len)
+  {
+  int i, j;
+  uint32_t crc = 0xffffffff;
+
+  for(i = 0; i < len; i++)
+    {
+    crc ^= (uint32_t)data[i] << 24;
+    for(j = 0; j < 8; j++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+    }
+  return crc;
+  }
+
+static uint8_t * packet_header(uint8_t * ptr, int pid, int start, int cc)
+  {
+  memset(ptr, 0xff, TSGEN_PACKET_SIZE);
+  ptr[0] = 0x47;
+  ptr[1] = (start ? 0x40 : 0x00) | (pid >> 8);
+  ptr[2] = pid & 0xff;
+  ptr[3] = 0x10 | (cc & 0x0f); /* Payload only */
+  return ptr + 4;
+  }
+
+/* Pointer field, section and CRC */
+
+static void write_section(uint8_t * ptr, const uint8_t * section, int len)
+  {
+  uint32_t crc;
+  
+  ptr[0] = 0x00;
+  memcpy(ptr + 1, section, len);
+  crc = crc32_mpeg(section, len);
+  ptr[len + 1] = crc >> 24;
+  ptr[len + 2] = (crc >> 16) & 0xff;
+  ptr[len + 3] = (crc >> 8) & 0xff;
+  ptr[len + 4] = crc & 0xff;
+  }
+
+static void make_pat(uint8_t * ptr, int cc)
+  {
+  static const uint8_t pat[] =
+    {
+      0x00,                     /* table_id */
+      0xb0, 13,                 /* section_length */
+      0x00, 0x01,               /* transport_stream_id */
+      0xc1, 0x00, 0x00,         /* version, section numbers */
+      0x00, 0x01,               /* program_number */
+      0xe0 | (PMT_PID >> 8), PMT_PID & 0xff,
+    };
+  write_section(packet_header(ptr, 0x0000, 1, cc), pat, sizeof(pat));
+  }
+
+static void make_pmt(uint8_t * ptr, int cc)
+  {
+  static const uint8_t pmt[] =
+    {
+      0x02,                     /* table_id */
+      0xb0, 18,                 /* section_length */
+      0x00, 0x01,               /* program_number */
+      0xc1, 0x00, 0x00,         /* version, section numbers */
+      0xff, 0xff,               /* No PCR */
+      0xf0, 0x00,               /* program_info_length */
+      0x03,                     /* MPEG-1 audio */
+      0xe0 | (AUDIO_PID >> 8), AUDIO_PID & 0xff,
+      0xf0, 0x00,               /* ES_info_length */
+    };
+  write_section(packet_header(ptr, PMT_PID, 1, cc), pmt, sizeof(pmt));
+  }
+
+/* Every audio packet starts a PES packet */
+
+static void make_audio(uint8_t * ptr, int64_t count)
+  {
+  int i;
+  int64_t offset = count * PES_PAYLOAD;
+  int64_t pts = offset * FRAME_DURATION / FRAME_BYTES;
+
+  ptr = packet_header(ptr, AUDIO_PID, 1, count);
+
+  ptr[0] = 0x00;
+  ptr[1] = 0x00;
+  ptr[2] = 0x01;
+  ptr[3] = 0xc0;
+  ptr[4] = 0x00;
+  ptr[5] = PES_HEADER_SIZE - 6 + PES_PAYLOAD;
+  ptr[6] = 0x80;
+  ptr[7] = 0x80; /* PTS only */
+  ptr[8] = 0x05;
+  ptr[9]  = 0x21 | ((pts >> 29) & 0x0e);
+  ptr[10] = (pts >> 22) & 0xff;
+  ptr[11] = ((pts >> 14) & 0xfe) | 0x01;
+  ptr[12] = (pts >> 7) & 0xff;
+  ptr[13] = ((pts << 1) & 0xfe) | 0x01;
+  ptr += PES_HEADER_SIZE;
+
+  /* Silent frames: Header and zero bit allocation */
+  for(i = 0; i < PES_PAYLOAD; i++)
+    {
+    switch((offset + i) % FRAME_BYTES)
+      {
+      case 0: ptr[i] = 0xff; break;
+      case 1: ptr[i] = 0xfd; break;
+      case 2: ptr[i] = 0x84; break;
+      default: ptr[i] = 0x00; break;
+      }
+    }
+  }
+
+void tsgen_make_datagram(uint8_t * buf, int index)
+  {
+  int i = 0;
+  int psi_count = (index + PSI_INTERVAL - 1) / PSI_INTERVAL;
+  
+  /* Audio packets in the datagrams before */
+  int64_t count = (int64_t)index * TSGEN_PACKETS - 2 * psi_count;
+
+  if(!(index % PSI_INTERVAL))
+    {
+    make_pat(buf, psi_count);
+    make_pmt(buf + TSGEN_PACKET_SIZE, psi_count);
+    i = 2;
+    }
+
+  for(; i < TSGEN_PACKETS; i++)
+    make_audio(buf + i * TSGEN_PACKET_SIZE, count++);
+  }
+
+int64_t tsgen_audio_bytes(int num)
+  {
+  int psi_count = (num + PSI_INTERVAL - 1) / PSI_INTERVAL;
+  return ((int64_t)num * TSGEN_PACKETS - 2 * psi_count) * PES_PAYLOAD;
+  }
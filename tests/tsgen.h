@@ -0,0 +1,36 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Generator for a small MPEG-2 transport stream with one MPEG audio
+ *  stream. It's sent as UDP datagrams by the network tests.
+ *  The content of each datagram depends only on its index.
+ */
+
+#include <inttypes.h>
+
+#define TSGEN_PACKET_SIZE   188
+#define TSGEN_PACKETS       7 /* Per datagram */
+#define TSGEN_DATAGRAM_SIZE (TSGEN_PACKETS * TSGEN_PACKET_SIZE)
+
+void tsgen_make_datagram(uint8_t * buf, int index);
+
+/* Audio payload bytes in the first num datagrams */
+int64_t tsgen_audio_bytes(int num);
@@ -0,0 +1,169 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2024 Members of the Gmerlin project
+ * http://github.com/bplaum
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Send a transport stream over loopback in short bursts, so the
+ *  reader sleeps for new data many times. Check that all audio data
+ *  arrives and that no wakeup of the reader got lost, which would stall
+ *  it until the read timeout of the udp input.
+ *  Returns 0 on success.
+ */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tsgen.h"
+
+#define NUM_BURSTS    200
+#define BURST_SIZE    5
+#define NUM_DATAGRAMS (NUM_BURSTS * BURST_SIZE)
+
+#define BURST_INTERVAL 10000  /* Microseconds */
+#define START_DELAY    500000 /* Wait until the receiver is open */
+
+#define MAX_GAP 1000 /* Milliseconds, the read timeout is much longer */
+
+#define FRAME_BYTES 384 /* MPEG audio frames from tsgen.c */
+
+static int port;
+
+static void * sender_thread(void * data)
+  {
+  int i, j;
+  int fd;
+  struct sockaddr_in addr;
+  uint8_t buf[TSGEN_DATAGRAM_SIZE];
+  
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  usleep(START_DELAY);
+  
+  for(i = 0; i < NUM_BURSTS; i++)
+    {
+    for(j = 0; j < BURST_SIZE; j++)
+      {
+      tsgen_make_datagram(buf, i * BURST_SIZE + j);
+      sendto(fd, buf, sizeof(buf), 0, (struct sockaddr*)&addr, sizeof(addr));
+      }
+    usleep(BURST_INTERVAL);
+    }
+
+  close(fd);
+  return NULL;
+  }
+
+static int64_t get_time_ms(void)
+  {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int ret = 1;
+  char url[64];
+  bgav_t * b;
+  pthread_t sender;
+  gavl_packet_t p;
+  int64_t bytes = 0;
+  int64_t expected;
+  int64_t now;
+  int64_t last = -1;
+  int64_t max_gap = 0;
+
+  expected = tsgen_audio_bytes(NUM_DATAGRAMS);
+  
+  memset(&p, 0, sizeof(p));
+  
+  port = 20000 + getpid() % 20000;
+  snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+  
+  b = bgav_create();
+
+  pthread_create(&sender, NULL, sender_thread, NULL);
+  
+  if(!bgav_open(b, url) || !bgav_num_audio_streams(b, 0))
+    {
+    fprintf(stderr, "Opening %s failed\n", url);
+    pthread_join(sender, NULL);
+    goto end;
+    }
+
+  bgav_select_track(b, 0);
+  bgav_set_audio_stream(b, 0, BGAV_STREAM_READRAW);
+
+  if(!bgav_start(b))
+    {
+    fprintf(stderr, "Starting %s failed\n", url);
+    pthread_join(sender, NULL);
+    goto end;
+    }
+
+  /* Ends with the read timeout after the last datagram */
+  while(bgav_read_audio_packet(b, 0, &p))
+    {
+    now = get_time_ms();
+    if((last >= 0) && (now - last > max_gap))
+      max_gap = now - last;
+    last = now;
+    bytes += p.buf.len;
+    }
+
+  pthread_join(sender, NULL);
+  
+  fprintf(stderr, "Got %"PRId64" audio bytes (expected %"PRId64"), longest gap: %"PRId64" ms\n",
+          bytes, expected, max_gap);
+
+  /* The parser might drop an incomplete last frame */
+  if((bytes <= expected - FRAME_BYTES) || (bytes > expected))
+    goto end;
+
+  if(max_gap > MAX_GAP)
+    {
+    fprintf(stderr, "Reader stalled\n");
+    goto end;
+    }
+  
+  fprintf(stderr, "UDP reception OK\n");
+  ret = 0;
+  
+  end:
+
+  gavl_packet_free(&p);
+  bgav_close(b);
+  return ret;
+  }